@@ -26,4 +26,6 @@ void main()
 
 	vec4 world_pos = vec4(cam.proj_view_mat_inv * screen_coord);
 	pixel_world_pos = world_pos.xyz / world_pos.w;
+	// screen coordinates for unprojecting the geometry depth in the fragment shaders.
+	frag_uv = screen_coord.xy;
 }
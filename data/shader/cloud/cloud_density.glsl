@@ -0,0 +1,147 @@
+// density of the clouds, shared by the raymarching (cloud_march.glsl) and cloud_shadow.comp.
+// The includer defines CLOUD_DATA_SET and WIND_SET, intersect.glsl (or functions.glsl) has to be included before.
+
+layout(set = CLOUD_DATA_SET, binding = 0) uniform cloud_data_t
+{
+	vec3 sky_size;
+	vec3 sky_pos;
+	float shape_scale;
+	float detail_threshold;
+	float detail_factor;
+	float detail_scale;
+	float height_gradient_min_val;
+	float height_gradient_max_val;
+	float g;
+	float ambient_gradient_min_val;
+	float ambient_gradient_max_val;
+	float jitter_strength;
+	float sigma_s;
+	float sigma_e;
+	int bounds_mode;
+} cloud_data;
+
+layout(set = CLOUD_DATA_SET, binding = 1) uniform sampler3D cloud_shape_tex;
+layout(set = CLOUD_DATA_SET, binding = 2) uniform sampler3D cloud_detail_tex;
+layout(set = CLOUD_DATA_SET, binding = 3) uniform sampler2D weather_tex;
+// per cell: maximum coverage, lowest cloud bottom and highest cloud top, relative to the sky box.
+layout(set = CLOUD_DATA_SET, binding = 4) uniform sampler2D weather_occupancy_tex;
+
+layout(set = WIND_SET, binding = 0) uniform wind_t
+{
+	vec2 offset;
+} wind;
+
+#define MIN_HEIGHT (cloud_data.sky_pos.y - (cloud_data.sky_size.y / 2))
+#define MAX_HEIGHT (MIN_HEIGHT + cloud_data.sky_size.y)
+
+// of this ray, for the statistics of the raymarching.
+uint density_samples = 0;
+
+// see box_intersect.
+vec2 sky_box_intersect(vec3 ro, vec3 rd)
+{
+	return box_intersect(ro, rd, cloud_data.sky_pos - cloud_data.sky_size / 2, cloud_data.sky_pos + cloud_data.sky_size / 2);
+}
+
+vec3 get_sky_uvw(vec3 pos)
+{
+	return ((pos - cloud_data.sky_pos) / cloud_data.sky_size) + vec3(0.5);
+}
+
+float get_cloud_shape(vec3 pos)
+{
+	vec3 tex_sample_pos = get_sky_uvw(pos);
+
+	vec4 shape = texture(cloud_shape_tex, tex_sample_pos * cloud_data.shape_scale);
+	float result = shape.x * (shape.y + shape.z + shape.w);
+	return result;
+}
+
+float get_cloud_detail(vec3 pos)
+{
+	vec3 tex_sample_pos = get_sky_uvw(pos);
+
+	vec3 detail = texture(cloud_shape_tex, tex_sample_pos * cloud_data.detail_scale).xyz;
+	float result = detail.x + detail.y + detail.z;
+	result /= 3.0;
+	return result;
+}
+
+vec3 get_weather(vec3 pos)
+{
+	return texture(weather_tex, get_sky_uvw(pos).xz + fract(wind.offset)).xyz;
+}
+
+float get_height_signal(float height, float altitude, vec3 pos)
+{
+	float real_altitude = pos.y;
+	
+	float r1 = real_altitude - altitude;
+	float r2 = real_altitude - altitude - height;
+	float s = -4.0 / (height * height);
+
+	float result = r1 * r2 * s;
+
+	return result;
+}
+
+float get_height_gradient(float height, float altitude, vec3 pos)
+{
+	float real_altitude = pos.y;
+	
+	float x = (real_altitude - altitude) / height;
+	x = clamp(x, 0.0, 1.0);
+	float result = cloud_data.height_gradient_min_val + (cloud_data.height_gradient_max_val - cloud_data.height_gradient_min_val) * x;
+
+	return result;
+}
+
+// distance along dir (normalized) from pos until clouds may begin, 0 if they may be at pos.
+// Clouds need coverage, and lie between the bottom and top of the layer.
+float get_empty_distance(vec3 pos, vec3 dir)
+{
+	const vec2 uv = get_sky_uvw(pos).xz + fract(wind.offset);
+	const vec3 occupancy = texture(weather_occupancy_tex, uv).rgb;
+	const float height = (pos.y - MIN_HEIGHT) / cloud_data.sky_size.y;
+	if (occupancy.r > 0.0 && height > occupancy.g && height < occupancy.b)
+		return 0.0;
+
+	// leave the cell, boundaries stay at the same place when mirrored.
+	const vec2 size = vec2(textureSize(weather_occupancy_tex, 0));
+	const vec2 cell_pos = uv * size;
+	const vec2 cell_dir = dir.xz / cloud_data.sky_size.xz * size;
+	float dist = INFINITY;
+	if (cell_dir.x != 0.0)
+		dist = min(dist, ((cell_dir.x > 0.0 ? floor(cell_pos.x) + 1.0 : floor(cell_pos.x)) - cell_pos.x) / cell_dir.x);
+	if (cell_dir.y != 0.0)
+		dist = min(dist, ((cell_dir.y > 0.0 ? floor(cell_pos.y) + 1.0 : floor(cell_pos.y)) - cell_pos.y) / cell_dir.y);
+
+	// or reach the layer inside it.
+	if (occupancy.r > 0.0)
+	{
+		if (height <= occupancy.g && dir.y > 0.0)
+			dist = min(dist, (occupancy.g - height) * cloud_data.sky_size.y / dir.y);
+		else if (height >= occupancy.b && dir.y < 0.0)
+			dist = min(dist, (occupancy.b - height) * cloud_data.sky_size.y / dir.y);
+	}
+
+	return dist;
+}
+
+float get_density(vec3 pos)
+{
+	density_samples++;
+
+	vec3 weather = get_weather(pos);
+	float density = weather.r;
+	float height = weather.g * cloud_data.sky_size.y;
+	float altitude = MIN_HEIGHT + weather.b * cloud_data.sky_size.y;
+
+	density *= get_height_signal(height, altitude, pos);
+	density *= get_cloud_shape(pos);
+	if (density < cloud_data.detail_threshold)
+		density -= get_cloud_detail(pos) * cloud_data.detail_factor;
+	density *= get_height_gradient(height, altitude, pos);
+
+	return clamp(density, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_debug_printf : enable
+
+#include "cloud_march.glsl"
+#include "cloud_temporal.glsl"
+
+// rendered before the geometry, cloud_upsample.frag tests front_dist against the geometry depth.
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out float out_front_dist;
+
+void main()
+{
+	// one texel per block of the accumulation, marched at a different pixel of the block each frame.
+	const ivec2 pixel = ivec2(gl_FragCoord.xy)*temporal.block_size + temporal.pixel_offset;
+	const vec2 screen_coord = (vec2(pixel) + 0.5)/vec2(temporal.target_size)*2.0 - 1.0;
+	// flipped in y, like in cloud.vert.
+	vec4 world_pos = vec4(cam.proj_view_mat_inv * vec4(screen_coord.x, -screen_coord.y, 0.0, 1.0));
+
+	jitter_seed = float(temporal.frame % 16);
+	cloud_result_t result = march_pixel(normalize(world_pos.xyz/world_pos.w - cam.pos), INFINITY);
+	out_color = vec4(result.light, 1.0 - result.transmittance);
+	out_front_dist = result.front_dist;
+}
@@ -0,0 +1,435 @@
+// raymarching shared by cloud.frag (full resolution, stops at the geometry), cloud_low_res.frag and
+// cloud_upsample.frag (again at full resolution where the geometry cuts the low-resolution clouds).
+
+#include "scattering.h"
+#include "transmittance.h"
+#include "functions.glsl"
+
+layout(location = 0) in vec3 pixel_world_pos;
+layout(location = 1) in vec2 frag_uv;
+
+layout(constant_id = 0) const int SAMPLE_COUNT = 16;
+layout(constant_id = 1) const int SECONDARY_SAMPLE_COUNT = 0;
+
+#include "cam_set.h"
+CAM_SET(0)
+
+layout(set = 1, binding = 0) uniform sun_t
+{
+	vec3 color;
+	float zenith;
+	vec3 dir;
+	float azimuth;
+} sun;
+
+#define CLOUD_DATA_SET 2
+#define WIND_SET 4
+#include "cloud_density.glsl"
+
+// set 3 is the geometry depth, only read at full resolution.
+
+layout (set = 5, binding = 0) uniform sampler3D scattering0;
+layout (set = 6, binding = 0) uniform sampler3D scattering1;
+layout (set = 7, binding = 0) uniform sampler2D transmittance0;
+layout (set = 8, binding = 0) uniform sampler2D transmittance1;
+
+#include "env_set.h"
+ENV_SET(9, env0)
+ENV_SET(10, env1)
+
+#include "ratio_set.h"
+RATIO_SET(11)
+
+// counts the samples into the statistics buffer. Only defined with fragmentStoresAndAtomics, without it
+// storage buffers in fragment shaders must not be writable.
+#ifdef SAMPLE_STATISTICS
+// reset every frame by CloudRenderer, only written if enabled.
+layout(set = 12, binding = 0) buffer cloud_statistics_t
+{
+	uint enabled;
+	uint rays;
+	uint density_samples;
+	uint skipped_samples;
+} statistics;
+#endif
+
+#include "cloud_shadow.h"
+CLOUD_SHADOW_SET(13)
+#include "cloud_shadow.glsl"
+
+#define PI 3.14159265359
+
+#define MAX_SECONDARY_SAMPLE_COUNT 8
+// only for the sphere traced bounds.
+#define MAX_RAY_DISTANCE 100000.0
+#define MIN_RAY_DISTANCE 0.125
+
+// cloud_data.bounds_mode.
+#define BOUNDS_ANALYTIC 0
+#define BOUNDS_SPHERE_TRACED 1
+#define BOUNDS_DIFFERENCE 2
+
+struct cloud_result_t
+{
+	vec3 light;
+	float transmittance;
+	// distance from the camera to the first sample inside a cloud.
+	float front_dist;
+};
+
+// set in main.
+float r_planet;
+float atmosphere_height;
+// varies the jitter between frames, the temporal accumulation averages it.
+float jitter_seed = 0.0;
+// of this ray, for the statistics.
+uint skipped_samples = 0;
+
+vec3 to_sky_model_vec(vec3 world_vec) {
+	// shift coordinate system r_planet units down
+	// <=> shift vector r_planet units up.
+	return world_vec + vec3(0, r_planet, 0);
+}
+
+// o+ret*u is intersection-point.
+// https://en.wikipedia.org/wiki/Line%E2%80%93sphere_intersection
+float sphere_intersect(vec3 o, vec3 u, vec3 c, float r) {
+	vec3 sphere_relative = o - c;
+	float a = dot(u, sphere_relative);
+	float center_dist = length(sphere_relative);
+	float under_root = a*a - center_dist*center_dist + r*r;
+	if (under_root < 0)
+		// no intersection.
+		return INFINITY;
+	else {
+		float res = -a-sqrt(under_root);
+		if (res < 0) return INFINITY;
+		return res;
+	}
+}
+
+vec3 mixed_transmittance(vec3 pos) {
+	pos = to_sky_model_vec(pos);
+	float height = height(pos, r_planet);
+	float view_cos = dot(normalize(pos), sun.dir);
+
+	bool earth_intersected = sphere_intersect(pos, sun.dir, vec3(0,0,0), r_planet) == INFINITY ? false : true;
+
+	if (earth_intersected)
+		return vec3(0,0,0);
+
+#ifdef TRANSMITTANCE_USE_ANALYTIC
+	vec3 transmittance = transmittance_analytic(
+		pos,
+		sun.dir,
+		env0.rayleigh_scale_height,
+		env0.mie_scale_height,
+		env0.rayleigh_scattering_coefficient,
+		env0.mie_scattering_coefficient/0.9f,
+		env0.ozone_extinction_coefficient,
+		r_planet,
+		env0.r_atmosphere);
+	if (!LUT_BLEND)
+		return transmittance;
+	return mix(
+		transmittance,
+		transmittance_analytic(
+			pos,
+			sun.dir,
+			env1.rayleigh_scale_height,
+			env1.mie_scale_height,
+			env1.rayleigh_scattering_coefficient,
+			env1.mie_scattering_coefficient/0.9f,
+			env1.ozone_extinction_coefficient,
+			r_planet,
+			env1.r_atmosphere),
+		ratio.ratio);
+#else
+	vec3 transmittance = _fetch_transmittance(
+		height,
+		view_cos,
+		r_planet,
+		atmosphere_height,
+		vec2(TRANSMITTANCE_RESOLUTION_HEIGHT, TRANSMITTANCE_RESOLUTION_VIEW),
+		transmittance0);
+	if (!LUT_BLEND)
+		return transmittance;
+	return mix(
+		transmittance,
+		_fetch_transmittance(
+			height,
+			view_cos,
+			r_planet,
+			atmosphere_height,
+			vec2(TRANSMITTANCE_RESOLUTION_HEIGHT, TRANSMITTANCE_RESOLUTION_VIEW),
+			transmittance1),
+		ratio.ratio);
+#endif
+}
+
+vec3 ambient(vec3 p, vec3 view) {
+	p = to_sky_model_vec(p);
+
+	float height = height(p, r_planet);
+	float tex_x = height_to_tex(height, atmosphere_height);
+	float tex_y = view_to_tex(dot(p, view), height, r_planet);
+	float tex_z = sun_to_tex(dot(normalize(p), sun.dir));
+
+	vec3 tex_coord = tex_address_shifted(vec3(tex_x, tex_y, tex_z), vec3(
+		SCATTERING_RESOLUTION_HEIGHT,
+		SCATTERING_RESOLUTION_VIEW,
+		SCATTERING_RESOLUTION_SUN));
+
+	vec4 r_rgb_m_r0 = texture(scattering0, tex_coord);
+	vec3 m_rgb0 = mie_from_rayleigh(r_rgb_m_r0, env0.rayleigh_scattering_coefficient, env0.mie_scattering_coefficient);
+	vec3 color0 = sun.color * (
+		phase_m(dot(view, sun.dir), env0.asymmetry_factor)*m_rgb0 +
+		phase_r(dot(view, sun.dir))*r_rgb_m_r0.rgb);
+
+	// second fetch only while blending.
+	if (!LUT_BLEND)
+		return color0;
+
+	vec4 r_rgb_m_r1 = texture(scattering1, tex_coord);
+	vec3 m_rgb1 = mie_from_rayleigh(r_rgb_m_r1, env1.rayleigh_scattering_coefficient, env1.mie_scattering_coefficient);
+	vec3 color1 = sun.color * (
+		phase_m(dot(view, sun.dir), env1.asymmetry_factor)*m_rgb1 +
+		phase_r(dot(view, sun.dir))*r_rgb_m_r1.rgb);
+
+	// debugPrintfEXT("%v3f", mix(color0, color1, ratio.ratio));
+
+	return mix(color0, color1, ratio.ratio);
+}
+
+float rand(vec2 co)
+{
+	return fract(sin(dot(co, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+float sky_sdf(vec3 pos)
+{
+	vec3 sky_size = cloud_data.sky_size;// * vec3(4.0, 1.0, 4.0); // TODO: make ubo parameter
+	vec3 d = abs(pos - cloud_data.sky_pos) - sky_size / 2;
+	return length(max(d, 0)) + min(max(d.x, max(d.y, d.z)), 0);
+}
+
+// sphere traced against sky_sdf, kept to compare against (BOUNDS_SPHERE_TRACED, BOUNDS_DIFFERENCE).
+vec3[2] find_entry_exit_sdf(vec3 ro, vec3 rd)
+{
+	// rd should be normalized
+
+	float dist;
+	do
+	{
+		dist = sky_sdf(ro);
+		ro  += dist * rd;
+	} while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
+	vec3 entry = ro;
+
+	ro += rd * length(2 * cloud_data.sky_size);//ro += rd * MAX_RAY_DISTANCE * 2;
+	rd *= -1.0;
+	do
+	{
+		dist = sky_sdf(ro);
+		ro += dist * rd;
+	} while (dist > MIN_RAY_DISTANCE && dist < MAX_RAY_DISTANCE);
+	vec3 exit = ro;
+	
+	return vec3[2]( entry, exit );
+}
+
+void gen_sample_points(vec3 start_pos, vec3 end_pos, out vec3 samples[SAMPLE_COUNT])
+{
+	vec3 dir = end_pos - start_pos;
+	for (int i = 0; i < SAMPLE_COUNT; i++)
+			samples[i] = start_pos + dir * (float(i) / float(SAMPLE_COUNT));
+}
+
+// Henyey-Greenstein
+float hg_phase_func(float cos_theta, float g)
+{
+	float g2 = g * g;
+	float result = 0.5 * (1 - g2) / pow(1 + g2 - (2 * g * cos_theta), 1.5);
+	return result;
+}
+
+float get_ambient_gradient(const float height)
+{
+	const float x = (height - MIN_HEIGHT) / (MAX_HEIGHT - MIN_HEIGHT);
+	return cloud_data.ambient_gradient_min_val + x * (cloud_data.ambient_gradient_max_val - cloud_data.ambient_gradient_min_val);
+}
+
+float get_self_shadowing(vec3 pos)
+{
+	// Exit if not used
+	if (SECONDARY_SAMPLE_COUNT == 0)
+		return 1.0;
+
+	// precomputed by cloud_shadow.comp.
+	if (cloud_shadow.use_in_clouds != 0)
+		return cloud_shadow_inside(pos);
+
+	// Find exit from current pos
+	const vec3 exit = cloud_data.bounds_mode == BOUNDS_SPHERE_TRACED ?
+		find_entry_exit_sdf(pos, normalize(sun.dir))[1] :
+		pos + normalize(sun.dir) * max(sky_box_intersect(pos, normalize(sun.dir)).y, 0.0); // inv dir
+
+	// Generate secondary sample points using lerp factors
+	const vec3 direction = exit - pos;
+	vec3 secondary_sample_points[MAX_SECONDARY_SAMPLE_COUNT];
+	for (int i = 0; i < SECONDARY_SAMPLE_COUNT; i++)
+		secondary_sample_points[i] = pos + direction * exp(float(i - SECONDARY_SAMPLE_COUNT));
+
+	// Calculate light reaching pos
+	float transmittance = 1.0;
+	const float sigma_e = cloud_data.sigma_e;
+	for (int i = 0; i < SECONDARY_SAMPLE_COUNT; i++)
+	{
+		const vec3 sample_point = secondary_sample_points[i];
+		// only the coarse occupancy, the points aren't evenly spaced.
+		const float density = get_empty_distance(sample_point, sun.dir) > 0.0 ? 0.0 : get_density(sample_point);
+		if (density > 0.0)
+		{
+			const float sample_sigma_e = sigma_e * density;
+			const float step_size = (i < SECONDARY_SAMPLE_COUNT - 1) ? 
+				length(secondary_sample_points[i + 1] - secondary_sample_points[i]) : 
+				1.0;
+			const float t_r = exp(-sample_sigma_e * step_size);
+			transmittance *= t_r;
+		}
+	}
+
+	return transmittance;
+}
+
+// stops at max_dist from ro, the geometry of the pixel.
+cloud_result_t render_cloud(vec3 sample_points[SAMPLE_COUNT], vec3 out_dir, vec3 ro, float max_dist)
+{
+	// out_dir should be normalized
+	
+	cloud_result_t result;
+	result.light = vec3(0.0);
+	result.transmittance = 1.0;
+	result.front_dist = INFINITY;
+	
+	const float sigma_s = cloud_data.sigma_s;
+	const float sigma_e = cloud_data.sigma_e;
+	const float step_size = length(sample_points[1] - sample_points[0]);
+	const vec3 step_offset = rand(vec2(out_dir.x * out_dir.y, out_dir.z + jitter_seed)) * out_dir * step_size * cloud_data.jitter_strength;
+
+	for (int i = 0; i < SAMPLE_COUNT; i++)
+	{
+		const vec3 sample_point = sample_points[i] + step_offset;
+		if (max_dist < distance(ro, sample_point))
+			break;
+
+		// skip the samples up to where clouds may begin, the density is zero before.
+		const float empty_dist = get_empty_distance(sample_point, -out_dir);
+		if (empty_dist > 0.0)
+		{
+			const int skip = int(min(empty_dist / step_size, float(SAMPLE_COUNT)));
+			skipped_samples += uint(min(skip + 1, SAMPLE_COUNT - i));
+			i += skip;
+			continue;
+		}
+
+		const float density = get_density(sample_point);
+
+		if (density > 0.0)
+		{
+			result.front_dist = min(result.front_dist, distance(ro, sample_point));
+
+			const float sample_sigma_s = sigma_s * density;
+			const float sample_sigma_e = sigma_e * density;
+
+			const vec3 ambient = get_ambient_gradient(sample_point.y) * ambient(sample_point, -out_dir);
+
+			// attenuate direct sunlight with transmittance.
+			const vec3 phase_result = mixed_transmittance(sample_point)*hg_phase_func(dot(-sun.dir, out_dir), cloud_data.g); // inv dir
+			const float self_shadowing = get_self_shadowing(sample_point);
+
+			const vec3 s = (vec3(self_shadowing * phase_result) + ambient) * sample_sigma_s;
+			const float t_r = exp(-sample_sigma_e * step_size);
+			const vec3 s_int = (s - (s * t_r)) / sample_sigma_e;
+
+			result.light += result.transmittance * s_int;
+			result.transmittance *= t_r;
+
+			// Early exit
+			if (result.transmittance < 0.01)
+				break;
+		}
+	}
+
+	return result;
+}
+
+// opaque, red: distance between the entry points of both bounds, green: between the exit points,
+// saturating at one unit. Blue where only one of them hits the box.
+cloud_result_t bounds_difference(vec3 ro, vec3 rd)
+{
+	const vec2 t = sky_box_intersect(ro, rd);
+	const vec3[2] entry_exit = find_entry_exit_sdf(ro, rd);
+	const bool hit = t.x <= t.y;
+	const bool sdf_hit = sky_sdf(entry_exit[0]) <= MAX_RAY_DISTANCE;
+
+	// in front of everything, so the upsample doesn't reject it.
+	if (!hit && !sdf_hit)
+		return cloud_result_t(vec3(0.0), 1.0, INFINITY);
+	if (hit != sdf_hit)
+		return cloud_result_t(vec3(0.0, 0.0, 1.0), 0.0, 0.0);
+	return cloud_result_t(
+		vec3(
+			min(distance(ro + rd * t.x, entry_exit[0]), 1.0),
+			min(distance(ro + rd * t.y, entry_exit[1]), 1.0),
+			0.0),
+		0.0,
+		0.0);
+}
+
+// marches the view ray rd (normalized) through the cloud box, up to max_dist.
+cloud_result_t march_pixel(vec3 rd, float max_dist)
+{
+	r_planet = mix(env0.r_planet, env1.r_planet, blend_ratio());
+	atmosphere_height = mix(env0.atmosphere_height, env1.atmosphere_height, blend_ratio());
+
+	const vec3 ro = cam.pos;
+
+	if (cloud_data.bounds_mode == BOUNDS_DIFFERENCE)
+		return bounds_difference(ro, rd);
+
+	vec3 entry;
+	vec3 exit;
+	if (cloud_data.bounds_mode == BOUNDS_SPHERE_TRACED)
+	{
+		const vec3[2] entry_exit = find_entry_exit_sdf(ro, rd);
+		entry = entry_exit[0];
+		exit = entry_exit[1];
+
+		if (sky_sdf(entry) > MAX_RAY_DISTANCE)
+			return cloud_result_t(vec3(0.0), 1.0, INFINITY);
+	}
+	else
+	{
+		const vec2 t = sky_box_intersect(ro, rd);
+		if (t.x > t.y)
+			return cloud_result_t(vec3(0.0), 1.0, INFINITY);
+
+		entry = ro + rd * t.x;
+		exit = ro + rd * t.y;
+	}
+
+	vec3 sample_points[SAMPLE_COUNT];
+	gen_sample_points(entry, exit, sample_points);
+	const cloud_result_t result = render_cloud(sample_points, -rd, ro, max_dist);
+
+#ifdef SAMPLE_STATISTICS
+	if (statistics.enabled != 0)
+	{
+		atomicAdd(statistics.rays, 1u);
+		atomicAdd(statistics.density_samples, density_samples);
+		atomicAdd(statistics.skipped_samples, skipped_samples);
+	}
+#endif
+	return result;
+}
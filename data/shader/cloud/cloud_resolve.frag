@@ -0,0 +1,93 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#include "cam_set.h"
+CAM_SET(0)
+
+#include "cloud_temporal.glsl"
+
+layout(location = 0) in vec3 pixel_world_pos;
+layout(location = 1) in vec2 frag_uv;
+
+// marched this frame by cloud_low_res.frag, one texel per block.
+layout(set = 1, binding = 0) uniform sampler2D fresh_color;
+layout(set = 1, binding = 1) uniform sampler2D fresh_front_dist;
+
+// the accumulation of the previous frame.
+layout(set = 2, binding = 0) uniform sampler2D history_color;
+layout(set = 2, binding = 1) uniform sampler2D history_front_dist;
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out float out_front_dist;
+
+// bilinear, the targets use a nearest sampler.
+vec4 sample_history(vec2 uv)
+{
+	const ivec2 size = textureSize(history_color, 0);
+	const vec2 pos = uv*vec2(size) - 0.5;
+	const ivec2 base = ivec2(floor(pos));
+	const vec2 f = pos - vec2(base);
+
+	vec4 result = vec4(0.0);
+	for (int y = 0; y != 2; ++y)
+	{
+		for (int x = 0; x != 2; ++x)
+		{
+			const ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), size - 1);
+			const float weight = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+			result += weight * texelFetch(history_color, texel, 0);
+		}
+	}
+	return result;
+}
+
+void main()
+{
+	const ivec2 pixel = ivec2(gl_FragCoord.xy);
+	const ivec2 block = pixel / temporal.block_size;
+	const ivec2 fresh_size = textureSize(fresh_color, 0);
+
+	const vec4 fresh = texelFetch(fresh_color, block, 0);
+	const float fresh_dist = texelFetch(fresh_front_dist, block, 0).r;
+	const bool marched = pixel - block*temporal.block_size == temporal.pixel_offset;
+
+	// without history the marched pixel stands for its whole block.
+	out_color = fresh;
+	out_front_dist = fresh_dist;
+	if (temporal.has_history == 0)
+		return;
+
+	// reproject the front of the cloud, directions only if there is none.
+	const vec3 rd = normalize(pixel_world_pos - cam.pos);
+	const vec4 prev_clip = isinf(fresh_dist) ?
+		temporal.prev_proj_view * vec4(rd, 0.0) :
+		temporal.prev_proj_view * vec4(rd*fresh_dist + temporal.wind_shift, 1.0);
+	// flipped in y, like in cloud.vert.
+	const vec2 prev_uv = vec2(prev_clip.x, -prev_clip.y)/prev_clip.w*0.5 + 0.5;
+	if (prev_clip.w <= 0.0 || any(lessThan(prev_uv, vec2(0.0))) || any(greaterThan(prev_uv, vec2(1.0))))
+		return;
+
+	// clamp to the pixels marched around this block, rejects history of clouds that changed
+	// or were disoccluded.
+	vec4 lo = fresh;
+	vec4 hi = fresh;
+	for (int y = -1; y != 2; ++y)
+	{
+		for (int x = -1; x != 2; ++x)
+		{
+			const vec4 neighbour = texelFetch(fresh_color, clamp(block + ivec2(x, y), ivec2(0), fresh_size - 1), 0);
+			lo = min(lo, neighbour);
+			hi = max(hi, neighbour);
+		}
+	}
+	const vec4 history = clamp(sample_history(prev_uv), lo, hi);
+
+	if (marched)
+		out_color = mix(fresh, history, temporal.history_weight);
+	else
+	{
+		out_color = history;
+		const ivec2 history_size = textureSize(history_front_dist, 0);
+		out_front_dist = texelFetch(history_front_dist, min(ivec2(prev_uv*vec2(history_size)), history_size - 1), 0).r;
+	}
+}
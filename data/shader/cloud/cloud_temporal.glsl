@@ -0,0 +1,16 @@
+// push constants of the low-resolution cloud passes, CloudTemporalParams.
+
+layout(push_constant) uniform temporal_t
+{
+	// from positions relative to the current camera to the clip space of the previous frame.
+	mat4 prev_proj_view;
+	// movement of the clouds since the previous frame, added to reach their previous position.
+	vec3 wind_shift;
+	float history_weight;
+	// pixel marched in each block this frame.
+	ivec2 pixel_offset;
+	ivec2 target_size;
+	int block_size;
+	int frame;
+	int has_history;
+} temporal;
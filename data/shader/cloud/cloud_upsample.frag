@@ -0,0 +1,62 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#include "cloud_march.glsl"
+
+layout(input_attachment_index = 0, set = 3, binding = 0) uniform subpassInput geometry_depth;
+
+// written by cloud_low_res.frag, set 14 is only bound for the upsample.
+layout(set = 14, binding = 0) uniform sampler2D cloud_color;
+layout(set = 14, binding = 1) uniform sampler2D cloud_front_dist;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+	const float geom_depth = subpassLoad(geometry_depth).r;
+	vec4 geom_world_pos4 = vec4(cam.proj_view_mat_inv * vec4(frag_uv, geom_depth, 1.0));
+	const float geom_dist = distance(cam.pos, geom_world_pos4.xyz / geom_world_pos4.w);
+
+	// frag_uv is flipped in y, like the screen coordinates in cloud.vert.
+	const vec2 low_res_size = vec2(textureSize(cloud_color, 0));
+	const vec2 pos = (vec2(frag_uv.x, -frag_uv.y)*0.5 + 0.5)*low_res_size - 0.5;
+	const ivec2 base = ivec2(floor(pos));
+	const vec2 f = pos - vec2(base);
+
+	// bilinear, but texels whose cloud starts behind the geometry of this pixel are left out,
+	// so clouds don't bleed over the silhouettes of closer geometry.
+	vec4 color_sum = vec4(0.0);
+	float weight_sum = 0.0;
+	// a texel's cloud starts in front of the geometry.
+	bool cut_by_geometry = false;
+	for (int y = 0; y != 2; ++y)
+	{
+		for (int x = 0; x != 2; ++x)
+		{
+			const ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), ivec2(low_res_size) - 1);
+			const vec4 color = texelFetch(cloud_color, texel, 0);
+			if (color.a > 0.0)
+			{
+				if (texelFetch(cloud_front_dist, texel, 0).r > geom_dist)
+					continue;
+				cut_by_geometry = true;
+			}
+
+			const float weight = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+			color_sum += weight * color;
+			weight_sum += weight;
+		}
+	}
+
+	// the low-resolution clouds are marched to infinity, a cloud in front of the geometry may continue
+	// behind it and would show as a halo around its silhouette. Those pixels are marched again, up to
+	// the geometry. The sky (cleared depth) bounds nothing.
+	if (geom_depth < 1.0 && cut_by_geometry)
+	{
+		cloud_result_t result = march_pixel(normalize(pixel_world_pos - cam.pos), geom_dist);
+		out_color = vec4(result.light, 1.0 - result.transmittance);
+		return;
+	}
+
+	out_color = weight_sum > 1e-4 ? color_sum / weight_sum : vec4(0.0);
+}
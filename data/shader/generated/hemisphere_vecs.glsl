@@ -1,329 +0,0 @@
-const int hemisphere_hor_sizes[GRL_ZENITH_ANGLES+2] = {
-	1,
-	1,
-	2,
-	4,
-	5,
-	6,
-	7,
-	9,
-	10,
-	11,
-	12,
-	12,
-	13,
-	14,
-	14,
-	15,
-	15,
-	15,
-	1
-};
-const int hemisphere_vec_count = 167;
-const vec3 hemisphere_vecs[19][15] = {
-	{
-		vec3(0.000000, 1.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(-0.000000, 0.996199, 0.087112),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.000000, 0.984823, -0.173561),
-		vec3(-0.000001, 0.984823, 0.173561),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.258691, 0.965960, 0.000000),
-		vec3(0.000001, 0.965960, -0.258691),
-		vec3(-0.258691, 0.965960, -0.000001),
-		vec3(-0.000001, 0.965960, 0.258691),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.325122, 0.939753, 0.105639),
-		vec3(0.200937, 0.939753, -0.276565),
-		vec3(-0.200936, 0.939753, -0.276566),
-		vec3(-0.325123, 0.939753, 0.105637),
-		vec3(-0.000002, 0.939753, 0.341854),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.365824, 0.906401, 0.211209),
-		vec3(0.365825, 0.906401, -0.211208),
-		vec3(0.000001, 0.906401, -0.422418),
-		vec3(-0.365824, 0.906401, -0.211210),
-		vec3(-0.365825, 0.906401, 0.211207),
-		vec3(-0.000002, 0.906401, 0.422418),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.390736, 0.866158, 0.311602),
-		vec3(0.487240, 0.866158, -0.111209),
-		vec3(0.216843, 0.866158, -0.450277),
-		vec3(-0.216841, 0.866158, -0.450278),
-		vec3(-0.487239, 0.866158, -0.111211),
-		vec3(-0.390737, 0.866158, 0.311600),
-		vec3(-0.000002, 0.866158, 0.499770),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.368524, 0.819330, 0.439191),
-		vec3(0.564612, 0.819330, 0.099557),
-		vec3(0.496512, 0.819330, -0.286660),
-		vec3(0.196089, 0.819330, -0.538747),
-		vec3(-0.196086, 0.819330, -0.538748),
-		vec3(-0.496511, 0.819330, -0.286663),
-		vec3(-0.564613, 0.819330, 0.099554),
-		vec3(-0.368527, 0.819330, 0.439189),
-		vec3(-0.000003, 0.819330, 0.573322),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.377661, 0.766272, 0.519807),
-		vec3(0.611069, 0.766272, 0.198549),
-		vec3(0.611070, 0.766272, -0.198548),
-		vec3(0.377663, 0.766272, -0.519806),
-		vec3(0.000002, 0.766272, -0.642516),
-		vec3(-0.377660, 0.766272, -0.519808),
-		vec3(-0.611069, 0.766272, -0.198551),
-		vec3(-0.611070, 0.766272, 0.198546),
-		vec3(-0.377664, 0.766272, 0.519805),
-		vec3(-0.000003, 0.766272, 0.642516),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.382138, 0.707388, 0.594619),
-		vec3(0.642951, 0.707388, 0.293626),
-		vec3(0.699631, 0.707388, -0.100591),
-		vec3(0.534184, 0.707388, -0.462871),
-		vec3(0.199137, 0.707388, -0.678193),
-		vec3(-0.199134, 0.707388, -0.678194),
-		vec3(-0.534181, 0.707388, -0.462874),
-		vec3(-0.699630, 0.707388, -0.100594),
-		vec3(-0.642952, 0.707388, 0.293623),
-		vec3(-0.382141, 0.707388, 0.594618),
-		vec3(-0.000003, 0.707388, 0.706825),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.382880, 0.643126, 0.663168),
-		vec3(0.663167, 0.643126, 0.382881),
-		vec3(0.765760, 0.643126, 0.000001),
-		vec3(0.663168, 0.643126, -0.382879),
-		vec3(0.382881, 0.643126, -0.663167),
-		vec3(0.000002, 0.643126, -0.765760),
-		vec3(-0.382878, 0.643126, -0.663169),
-		vec3(-0.663166, 0.643126, -0.382882),
-		vec3(-0.765760, 0.643126, -0.000003),
-		vec3(-0.663169, 0.643126, 0.382877),
-		vec3(-0.382883, 0.643126, 0.663166),
-		vec3(-0.000004, 0.643126, 0.765760),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.409436, 0.573975, 0.709165),
-		vec3(0.709164, 0.573975, 0.409437),
-		vec3(0.818873, 0.573975, 0.000001),
-		vec3(0.709165, 0.573975, -0.409435),
-		vec3(0.409438, 0.573975, -0.709164),
-		vec3(0.000002, 0.573975, -0.818873),
-		vec3(-0.409434, 0.573975, -0.709166),
-		vec3(-0.709163, 0.573975, -0.409439),
-		vec3(-0.818873, 0.573975, -0.000003),
-		vec3(-0.709167, 0.573975, 0.409433),
-		vec3(-0.409440, 0.573975, 0.709163),
-		vec3(-0.000004, 0.573975, 0.818873),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.402338, 0.500460, 0.766592),
-		vec3(0.712506, 0.500460, 0.491808),
-		vec3(0.859447, 0.500460, 0.104357),
-		vec3(0.809500, 0.500460, -0.307001),
-		vec3(0.574106, 0.500460, -0.648029),
-		vec3(0.207192, 0.500460, -0.840602),
-		vec3(-0.207187, 0.500460, -0.840603),
-		vec3(-0.574103, 0.500460, -0.648032),
-		vec3(-0.809498, 0.500460, -0.307006),
-		vec3(-0.859448, 0.500460, 0.104352),
-		vec3(-0.712508, 0.500460, 0.491804),
-		vec3(-0.402342, 0.500460, 0.766590),
-		vec3(-0.000005, 0.500460, 0.865760),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.393126, 0.423139, 0.816336),
-		vec3(0.708389, 0.423139, 0.564922),
-		vec3(0.883347, 0.423139, 0.201619),
-		vec3(0.883348, 0.423139, -0.201617),
-		vec3(0.708391, 0.423139, -0.564921),
-		vec3(0.393128, 0.423139, -0.816335),
-		vec3(0.000002, 0.423139, -0.906064),
-		vec3(-0.393124, 0.423139, -0.816337),
-		vec3(-0.708388, 0.423139, -0.564924),
-		vec3(-0.883347, 0.423139, -0.201621),
-		vec3(-0.883348, 0.423139, 0.201615),
-		vec3(-0.708392, 0.423139, 0.564919),
-		vec3(-0.393130, 0.423139, 0.816334),
-		vec3(-0.000004, 0.423139, 0.906064),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.407625, 0.342602, 0.846443),
-		vec3(0.734515, 0.342602, 0.585757),
-		vec3(0.915926, 0.342602, 0.209055),
-		vec3(0.915926, 0.342602, -0.209053),
-		vec3(0.734517, 0.342602, -0.585755),
-		vec3(0.407627, 0.342602, -0.846442),
-		vec3(0.000002, 0.342602, -0.939480),
-		vec3(-0.407623, 0.342602, -0.846444),
-		vec3(-0.734514, 0.342602, -0.585759),
-		vec3(-0.915925, 0.342602, -0.209057),
-		vec3(-0.915927, 0.342602, 0.209050),
-		vec3(-0.734518, 0.342602, 0.585753),
-		vec3(-0.407629, 0.342602, 0.846441),
-		vec3(-0.000005, 0.342602, 0.939481),
-		vec3(0.000000, 0.000000, 0.000000)
-	}, {
-		vec3(0.392807, 0.259460, 0.882260),
-		vec3(0.717694, 0.259460, 0.646216),
-		vec3(0.918486, 0.259460, 0.298435),
-		vec3(0.960463, 0.259460, -0.100947),
-		vec3(0.836368, 0.259460, -0.482875),
-		vec3(0.567657, 0.259460, -0.781310),
-		vec3(0.200794, 0.259460, -0.944649),
-		vec3(-0.200789, 0.259460, -0.944650),
-		vec3(-0.567653, 0.259460, -0.781313),
-		vec3(-0.836365, 0.259460, -0.482880),
-		vec3(-0.960463, 0.259460, -0.100953),
-		vec3(-0.918488, 0.259460, 0.298430),
-		vec3(-0.717698, 0.259460, 0.646212),
-		vec3(-0.392812, 0.259460, 0.882258),
-		vec3(-0.000005, 0.259460, 0.965754)
-	}, {
-		vec3(0.400507, 0.174345, 0.899554),
-		vec3(0.731763, 0.174345, 0.658883),
-		vec3(0.936490, 0.174345, 0.304285),
-		vec3(0.979290, 0.174345, -0.102926),
-		vec3(0.852763, 0.174345, -0.492341),
-		vec3(0.578785, 0.174345, -0.796625),
-		vec3(0.204730, 0.174345, -0.963166),
-		vec3(-0.204725, 0.174345, -0.963167),
-		vec3(-0.578780, 0.174345, -0.796628),
-		vec3(-0.852760, 0.174345, -0.492345),
-		vec3(-0.979290, 0.174345, -0.102931),
-		vec3(-0.936492, 0.174345, 0.304280),
-		vec3(-0.731766, 0.174345, 0.658879),
-		vec3(-0.400512, 0.174345, 0.899552),
-		vec3(-0.000005, 0.174345, 0.984684)
-	}, {
-		vec3(0.405162, 0.087905, 0.910009),
-		vec3(0.740267, 0.087905, 0.666541),
-		vec3(0.947374, 0.087905, 0.307822),
-		vec3(0.990672, 0.087905, -0.104122),
-		vec3(0.862674, 0.087905, -0.498063),
-		vec3(0.585511, 0.087905, -0.805884),
-		vec3(0.207109, 0.087905, -0.974360),
-		vec3(-0.207104, 0.087905, -0.974361),
-		vec3(-0.585507, 0.087905, -0.805887),
-		vec3(-0.862671, 0.087905, -0.498067),
-		vec3(-0.990671, 0.087905, -0.104128),
-		vec3(-0.947376, 0.087905, 0.307817),
-		vec3(-0.740271, 0.087905, 0.666537),
-		vec3(-0.405167, 0.087905, 0.910007),
-		vec3(-0.000005, 0.087905, 0.996129)
-	}, {
-		vec3(0.000000, -1.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000),
-		vec3(0.000000, 0.000000, 0.000000)
-	}
-};
\ No newline at end of file
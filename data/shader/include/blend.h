@@ -0,0 +1,6 @@
+// whether shaders sampling the sum targets mix both by the ratio (while blending) or only sample target 0.
+// Outside of blends, renderers bind the visible target in place of target 0 (en::Precomputer::GetSumTargetState, GetBoundSumTarget).
+#define LUT_BLEND_ID 20
+#ifndef __cplusplus
+layout (constant_id = LUT_BLEND_ID) const bool LUT_BLEND = true;
+#endif
@@ -0,0 +1,17 @@
+// sampling the volume of cloud_shadow.comp, needs intersect.glsl and CLOUD_SHADOW_SET.
+
+// transmittance from pos (inside the box) to the sun.
+float cloud_shadow_inside(vec3 pos) {
+	vec3 uvw = (pos - cloud_shadow.box_min) / cloud_shadow.box_size;
+	// the weather moved by wind_shift since the volume was computed.
+	uvw.xz += cloud_shadow.wind_shift;
+	return texture(cloud_shadow_volume, uvw).r;
+}
+
+// transmittance from pos (anywhere) to the sun, through the clouds only. 1 if the ray misses the box.
+float cloud_shadow_towards_sun(vec3 pos, vec3 sun_dir) {
+	vec2 t = box_intersect(pos, sun_dir, cloud_shadow.box_min, cloud_shadow.box_min + cloud_shadow.box_size);
+	if (t.x > t.y)
+		return 1.0;
+	return cloud_shadow_inside(pos + sun_dir * t.x);
+}
@@ -0,0 +1,32 @@
+// texels of the cloud shadow volume, aligned with the sky box of the clouds (x, y, z).
+#define CLOUD_SHADOW_X 128
+#define CLOUD_SHADOW_Y 32
+#define CLOUD_SHADOW_Z 128
+// density samples from each texel toward the sun.
+#define CLOUD_SHADOW_STEPS 32
+
+// the wind moves the weather every frame, the volume is only shifted to follow it until it moved this
+// many texels (in x or z), then computed again.
+#define CLOUD_SHADOW_MAX_WIND_SHIFT 2
+
+// local size of cloud_shadow.comp in x, y and z.
+#define CLOUD_SHADOW_GROUP_SIZE 4
+
+#define CS_SETS_IMAGE 0
+#define CS_SETS_SUN 1
+#define CS_SETS_CLOUD_DATA 2
+#define CS_SETS_WIND 3
+
+#ifndef __cplusplus
+// transmittance toward the sun in r, the box it was computed for (en::CloudShadowUniformData).
+#define CLOUD_SHADOW_SET(SET_INDEX)                                                       \
+layout (set = SET_INDEX, binding = 0) uniform sampler3D cloud_shadow_volume;             \
+layout (set = SET_INDEX, binding = 1) uniform cloud_shadow_uniform_t                     \
+{                                                                                         \
+	vec3 box_min;                                                                         \
+	float terrain_strength;                                                               \
+	vec3 box_size;                                                                        \
+	int use_in_clouds;                                                                    \
+	vec2 wind_shift;                                                                      \
+} cloud_shadow;
+#endif
@@ -1,8 +1,21 @@
 // higher steps removes slight artefacts in blue.
+#ifdef TRANSMITTANCE_TRAPEZOID_STEPS
+const float INTEGRATION_STEPS=TRANSMITTANCE_TRAPEZOID_STEPS;
+#else
 const float INTEGRATION_STEPS=50;
+#endif
 
-// no predifined constant, but this works.
-const float INFINITY = 1.0/0.0;
+// transmittance.h selects the integrator, it has to be included before this file.
+#ifdef TRANSMITTANCE_INTEGRATOR
+#if TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE
+#define TRANSMITTANCE_USE_GAUSS_LEGENDRE
+#elif TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_ANALYTIC
+#define TRANSMITTANCE_USE_ANALYTIC
+#endif
+#endif
+
+// INFINITY and box_intersect.
+#include "intersect.glsl"
 
 const float pi = 3.1415;
 
@@ -35,19 +48,88 @@ float height(vec3 p, float rad_e) {
 	return length(p)-rad_e;
 }
 
+// chapman function for zenith-cosine mu >= 0, x is the radius in scale heights.
+// sqrt(pi*x/2)*exp(y*y)*erfc(y) with y = sqrt(x/2)*mu, exp(y*y)*erfc(y) is approximated
+// by 1/(sqrt(pi)*((1-a)*y + a*sqrt(y*y + 1/(pi*a*a)))) with a = 0.344 (max. 0.35% error).
+float chapman(float x, float mu) {
+	float y = sqrt(0.5f*x)*mu;
+	return sqrt(0.5f*x)/(0.656f*y + sqrt(0.118336f*y*y + 1/pi));
+}
+
+// density-integral of an exponential layer along the ray from radius r with zenith-cosine mu to infinity.
+float optical_depth_to_infinity(float r, float mu, float rad_e, float scale_height) {
+	if (mu >= 0)
+		return scale_height*exp((rad_e-r)/scale_height)*chapman(r/scale_height, mu);
+
+	// below the horizon: twice the horizontal ray from the closest point, minus the ray in opposite direction.
+	float r0 = r*sqrt(1-mu*mu);
+	return scale_height*(
+		2*exp((rad_e-r0)/scale_height)*chapman(r0/scale_height, 0) -
+		exp((rad_e-r)/scale_height)*chapman(r/scale_height, -mu));
+}
+
+// density-integral of an exponential layer from radius r with zenith-cosine mu over distance t.
+float optical_depth_analytic(float r, float mu, float t, float rad_e, float scale_height) {
+	float r_t = sqrt(r*r + t*t + 2*r*t*mu);
+	float mu_t = (r*mu + t)/r_t;
+	// integrate descending rays backwards, otherwise the (huge) integral through the planet is subtracted.
+	float depth = mu_t < 0 ?
+		optical_depth_to_infinity(r_t, -mu_t, rad_e, scale_height) - optical_depth_to_infinity(r, -mu, rad_e, scale_height) :
+		optical_depth_to_infinity(r, mu, rad_e, scale_height) - optical_depth_to_infinity(r_t, mu_t, rad_e, scale_height);
+	return max(depth, 0);
+}
+
+// density-integrals vec3(mie, rayleigh, ozone) from p1 to p2, replaces summing up densities.
+vec3 optical_depth_analytic(vec3 p1, vec3 p2, float r_scale_height, float m_scale_height, float rad_e) {
+	float t = length(p2-p1);
+	if (t < 1)
+		return vec3(0);
+	float r = length(p1);
+	float mu = dot(p1, p2-p1)/(r*t);
+
+	float dens_r = optical_depth_analytic(r, mu, t, rad_e, r_scale_height);
+	return vec3(optical_depth_analytic(r, mu, t, rad_e, m_scale_height), dens_r, dens_r*6e-7);
+}
+
+vec3 optical_depth_analytic(vec2 p1, vec2 p2, float r_scale_height, float m_scale_height, float rad_e) {
+	return optical_depth_analytic(vec3(p1, 0), vec3(p2, 0), r_scale_height, m_scale_height, rad_e);
+}
+
 vec3 transmittance(vec2 p1, vec2 p2, float r_scale_height, float m_scale_height, vec3 extcoeff_r, vec3 extcoeff_m, vec3 extcoeff_o, float rad_e) {
 	// TODO: integrate using constant step_size, variate number of steps instead?
-	// also: try quadrature instead of trapezoidal integration (supposed to be better).
+	// quadrature instead of trapezoidal integration is selected by TRANSMITTANCE_INTEGRATOR.
 
 	// no attenuation for same position.
 	if (length(p2-p1) < 1)
 		return vec3(1,1,1);
-	float step_length = length(p2-p1)/INTEGRATION_STEPS;
 	vec2 dir = normalize(p2-p1);
 
 	float dens_m_sum = 0;
 	float dens_r_sum = 0;
 	float dens_o_sum = 0;
+
+#if defined(TRANSMITTANCE_USE_ANALYTIC)
+	vec3 dens_sum = optical_depth_analytic(p1, p2, r_scale_height, m_scale_height, rad_e);
+	dens_m_sum = dens_sum.x;
+	dens_r_sum = dens_sum.y;
+	dens_o_sum = dens_sum.z;
+#elif defined(TRANSMITTANCE_USE_GAUSS_LEGENDRE)
+	// nodes and weights on [-1, 1].
+	const float gauss_x[3] = float[3](-0.7745967, 0, 0.7745967);
+	const float gauss_w[3] = float[3](0.5555556, 0.8888889, 0.5555556);
+
+	float segment_length = length(p2-p1)/TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS;
+	for (int i = 0; i != TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS; ++i) {
+		for (int j = 0; j != 3; ++j) {
+			vec2 s = p1 + segment_length*(i + 0.5f + 0.5f*gauss_x[j])*dir;
+			float weight = 0.5f*segment_length*gauss_w[j];
+			dens_m_sum += density_m(height(s, rad_e), m_scale_height)*weight;
+			dens_r_sum += density_r(height(s, rad_e), r_scale_height)*weight;
+			dens_o_sum += density_o(height(s, rad_e), r_scale_height)*weight;
+		}
+	}
+#else
+	float step_length = length(p2-p1)/INTEGRATION_STEPS;
 	float dens_m_prev = density_m(height(p1, rad_e), m_scale_height);
 	float dens_r_prev = density_r(height(p1, rad_e), r_scale_height);
 	float dens_o_prev = density_o(height(p1, rad_e), r_scale_height);
@@ -67,6 +149,7 @@ vec3 transmittance(vec2 p1, vec2 p2, float r_scale_height, float m_scale_height,
 		dens_r_prev = dens_r;
 		dens_o_prev = dens_o;
 	}
+#endif
 
 	return exp(-(dens_m_sum*extcoeff_m + dens_r_sum*extcoeff_r + dens_o_sum*extcoeff_o));
 }
@@ -110,6 +193,39 @@ vec2 atmosphere_earth_intersect(vec2 p, vec2 dir, float rad_e, float rad_a) {
 		return p + ea_intsct*dir;
 }
 
+// float-only intersection of the ray o+ret*u (u unit vector) with the sphere of radius r around (0, -rad_e, 0),
+// o is relative to the world-origin on the planet surface (eg. cam.pos).
+// Never forms |o-c|^2 or r^2 (~4e13, more than 2^24 ulps), the constant term is expanded around the surface and
+// the root is taken in the form without cancellation, so the error stays in the range of the float-ulp of ret.
+// Returns the near intersection, INFINITY if there is none or it is behind the origin (only use if not inside).
+float planet_sphere_intersect(vec3 o, vec3 u, float rad_e, float r) {
+	// |o-c|^2 - r^2.
+	float c = dot(o, o) + 2*rad_e*o.y + (rad_e-r)*(rad_e+r);
+	// dot(u, o-c).
+	float b = dot(u, o) + rad_e*u.y;
+	float under_root = b*b - c;
+	if (b*b > r*r) {
+		// b*b - c cancels for grazing rays from far away, r^2 - |part of o-c perpendicular to u|^2 doesn't.
+		float l = length(o + vec3(0, rad_e, 0) - b*u);
+		under_root = (r-l)*(r+l);
+	}
+	if (under_root < 0)
+		// no intersection.
+		return INFINITY;
+	// roots are q and c/q, near root first for rays pointing towards the sphere (b < 0).
+	float q = -(b + (b < 0 ? -1 : 1)*sqrt(under_root));
+	if (q == 0)
+		return 0;
+	float res = min(q, c/q);
+	if (res < 0) return INFINITY;
+	return res;
+}
+
+// height of o (same space as planet_sphere_intersect) above the surface, without subtracting two radii.
+float planet_height(vec3 o, float rad_e) {
+	return (dot(o, o) + 2*rad_e*o.y)/(length(o + vec3(0, rad_e, 0)) + rad_e);
+}
+
 // shift samples so 0,0,0 and 1,1,1 are at the texel-centers, not on the border.
 vec3 tex_address_shifted(vec3 texcoord_range_zero_one, vec3 res) {
 	return vec3(
@@ -205,6 +321,19 @@ vec3 transmittance_from_density(float dens_m, float dens_r, float dens_o, vec3 e
 	return exp(-(dens_m*extcoeff_m + dens_r*extcoeff_r + dens_o*extcoeff_o));
 }
 
+// transmittance from p (inside the atmosphere) to the atmosphere-border in direction dir, without the LUT.
+// Doesn't check for intersections with the planet.
+vec3 transmittance_analytic(vec3 p, vec3 dir, float r_scale_height, float m_scale_height, vec3 extcoeff_r, vec3 extcoeff_m, vec3 extcoeff_o, float rad_e, float rad_a) {
+	float r = length(p);
+	float mu = dot(p, dir)/r;
+	// distance to the atmosphere-border.
+	float t = -r*mu + sqrt(max(r*r*(mu*mu-1) + rad_a*rad_a, 0));
+
+	float dens_r = optical_depth_analytic(r, mu, t, rad_e, r_scale_height);
+	float dens_m = optical_depth_analytic(r, mu, t, rad_e, m_scale_height);
+	return transmittance_from_density(dens_m, dens_r, dens_r*6e-7, extcoeff_m, extcoeff_r, extcoeff_o);
+}
+
 // @param view is normalized, points away from cam.
 // @param light_in is normalized, points away from light source.
 //
@@ -1,5 +1,13 @@
-#define GATHERING_RESOLUTION_HEIGHT 32
-#define GATHERING_RESOLUTION_SUN 32
+// resolution of the medium quality tier, the one in use is chosen at runtime (en::AtmosphereQuality)
+// and passed to the shaders as specialization constants.
+#define GATHERING_RESOLUTION_HEIGHT_DEFAULT 32
+#define GATHERING_RESOLUTION_SUN_DEFAULT 32
+#define GATHERING_RESOLUTION_HEIGHT_ID 15
+#define GATHERING_RESOLUTION_SUN_ID 16
+#ifndef __cplusplus
+layout (constant_id = GATHERING_RESOLUTION_HEIGHT_ID) const int GATHERING_RESOLUTION_HEIGHT = GATHERING_RESOLUTION_HEIGHT_DEFAULT;
+layout (constant_id = GATHERING_RESOLUTION_SUN_ID) const int GATHERING_RESOLUTION_SUN = GATHERING_RESOLUTION_SUN_DEFAULT;
+#endif
 
 #define GATHERING_STEPS 25
 
@@ -0,0 +1,22 @@
+// intersections without dependencies on the atmosphere headers, for shaders not including functions.glsl.
+// functions.glsl includes this file as well.
+#ifndef INTERSECT_GLSL
+#define INTERSECT_GLSL
+
+// no predifined constant, but this works.
+const float INFINITY = 1.0/0.0;
+
+// distances along rd (normalized) where the ray enters (0 if ro is inside) and leaves the box,
+// missed if x > y. Slab test, axis-parallel rays divide by zero into infinities.
+vec2 box_intersect(vec3 ro, vec3 rd, vec3 box_min, vec3 box_max) {
+	vec3 inv_rd = 1.0 / rd;
+	vec3 t0 = (box_min - ro) * inv_rd;
+	vec3 t1 = (box_max - ro) * inv_rd;
+	vec3 t_near = min(t0, t1);
+	vec3 t_far = max(t0, t1);
+	return vec2(
+		max(max(t_near.x, t_near.y), max(t_near.z, 0.0)),
+		min(min(t_far.x, t_far.y), t_far.z));
+}
+
+#endif
@@ -0,0 +1,8 @@
+#include "blend.h"
+
+// blend_ratio() is 0 if not blending, target 0 is the visible one then.
+#define RATIO_SET(SET_INDEX) layout (set = SET_INDEX, binding = 0) uniform ratio_uniform_t \
+{                                                                                          \
+	float ratio;                                                                           \
+} ratio;                                                                                   \
+float blend_ratio() { return LUT_BLEND ? ratio.ratio : 0; }
@@ -1,8 +1,18 @@
 #define SCATTERING_ORDERS 4
 
-#define SCATTERING_RESOLUTION_HEIGHT 32
-#define SCATTERING_RESOLUTION_VIEW 64
-#define SCATTERING_RESOLUTION_SUN 32
+// resolution of the medium quality tier, the one in use is chosen at runtime (en::AtmosphereQuality)
+// and passed to the shaders as specialization constants.
+#define SCATTERING_RESOLUTION_HEIGHT_DEFAULT 32
+#define SCATTERING_RESOLUTION_VIEW_DEFAULT 64
+#define SCATTERING_RESOLUTION_SUN_DEFAULT 32
+#define SCATTERING_RESOLUTION_HEIGHT_ID 12
+#define SCATTERING_RESOLUTION_VIEW_ID 13
+#define SCATTERING_RESOLUTION_SUN_ID 14
+#ifndef __cplusplus
+layout (constant_id = SCATTERING_RESOLUTION_HEIGHT_ID) const int SCATTERING_RESOLUTION_HEIGHT = SCATTERING_RESOLUTION_HEIGHT_DEFAULT;
+layout (constant_id = SCATTERING_RESOLUTION_VIEW_ID) const int SCATTERING_RESOLUTION_VIEW = SCATTERING_RESOLUTION_VIEW_DEFAULT;
+layout (constant_id = SCATTERING_RESOLUTION_SUN_ID) const int SCATTERING_RESOLUTION_SUN = SCATTERING_RESOLUTION_SUN_DEFAULT;
+#endif
 
 #define SCATTERING_STEP_LENGTH 1000
 
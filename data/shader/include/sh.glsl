@@ -0,0 +1,28 @@
+// real spherical harmonics up to band 2, shared by ground_lighting_sh.comp (projects the sky radiance)
+// and simple_material_sh.frag (evaluates the irradiance).
+
+void sh_basis(vec3 d, out float y[9]) {
+	y[0] = 0.282095;
+	y[1] = 0.488603*d.y;
+	y[2] = 0.488603*d.z;
+	y[3] = 0.488603*d.x;
+	y[4] = 1.092548*d.x*d.y;
+	y[5] = 1.092548*d.y*d.z;
+	y[6] = 0.315392*(3*d.z*d.z - 1);
+	y[7] = 1.092548*d.x*d.z;
+	y[8] = 0.546274*(d.x*d.x - d.y*d.y);
+}
+
+// convolution with the cosine lobe per band, divided by pi (Ramamoorthi and Hanrahan). Folded into the
+// stored coefficients, so evaluating them yields irradiance/pi, the radiance reflected by a white diffuse surface.
+const float sh_cosine_lobe[9] = float[9](1, 2./3, 2./3, 2./3, .25, .25, .25, .25, .25);
+
+vec3 sh_evaluate(vec4 coefficients[9], vec3 d) {
+	float y[9];
+	sh_basis(d, y);
+	vec3 res = vec3(0);
+	for (int i = 0; i != 9; ++i)
+		res += coefficients[i].rgb*y[i];
+	// ringing may go below zero opposite of the bright sky.
+	return max(res, vec3(0));
+}
@@ -1,9 +1,8 @@
 #define SKY_SETS_CAM 0
 #define SKY_SETS_SUN 1
-#define SKY_SETS_SCTEXTURE0 2
-#define SKY_SETS_SCTEXTURE1 3
-#define SKY_SETS_RATIO 4
-#define SKY_SETS_ENV0 5
-#define SKY_SETS_ENV1 6
-#define SKY_SETS_TRANSMITTANCE0 7
-#define SKY_SETS_TRANSMITTANCE1 8
+#define SKY_SETS_SKY_VIEW 2
+#define SKY_SETS_RATIO 3
+#define SKY_SETS_ENV0 4
+#define SKY_SETS_ENV1 5
+#define SKY_SETS_TRANSMITTANCE0 6
+#define SKY_SETS_TRANSMITTANCE1 7
@@ -0,0 +1,31 @@
+// parametrization of the sky-view LUT, shared by sky_view.comp (writes) and atmosphere.frag (samples).
+
+const float SKY_VIEW_PI = 3.14159265;
+
+// columns are the axes of the LUT: y is up at the camera, x points towards the azimuth of the sun,
+// so the sun is always in the middle column and the seam (u = 0/1) opposite of it.
+mat3 sky_view_frame(vec3 up, vec3 sun_dir) {
+	vec3 x = sun_dir - dot(sun_dir, up)*up;
+	// sun in zenith or nadir, the sky is symmetric around up then and any azimuth works.
+	if (dot(x, x) < 1e-8)
+		x = abs(up.x) < .9 ? vec3(1,0,0) - up.x*up : vec3(0,0,1) - up.z*up;
+	x = normalize(x);
+	return mat3(x, up, cross(x, up));
+}
+
+// u is linear in longitude, v quadratic in latitude to concentrate texels around the horizon.
+vec2 sky_view_uv(vec3 dir, mat3 frame) {
+	vec3 local = transpose(frame)*dir;
+	float lat = asin(clamp(local.y, -1, 1));
+	float lon = atan(local.z, local.x);
+	return vec2(
+		0.5 + lon/(2*SKY_VIEW_PI),
+		0.5 + 0.5*sign(lat)*sqrt(abs(lat)/(SKY_VIEW_PI/2)));
+}
+
+vec3 sky_view_dir(vec2 uv, mat3 frame) {
+	float lon = (uv.x - 0.5)*2*SKY_VIEW_PI;
+	float s = 2*uv.y - 1;
+	float lat = sign(s)*s*s*SKY_VIEW_PI/2;
+	return frame*vec3(cos(lat)*cos(lon), sin(lat), cos(lat)*sin(lon));
+}
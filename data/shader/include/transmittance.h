@@ -1,7 +1,30 @@
-#define TRANSMITTANCE_RESOLUTION_HEIGHT 32
-#define TRANSMITTANCE_RESOLUTION_VIEW 128
+// resolution of the medium quality tier, the one in use is chosen at runtime (en::AtmosphereQuality)
+// and passed to the shaders as specialization constants.
+#define TRANSMITTANCE_RESOLUTION_HEIGHT_DEFAULT 32
+#define TRANSMITTANCE_RESOLUTION_VIEW_DEFAULT 128
+#define TRANSMITTANCE_RESOLUTION_HEIGHT_ID 10
+#define TRANSMITTANCE_RESOLUTION_VIEW_ID 11
+#ifndef __cplusplus
+layout (constant_id = TRANSMITTANCE_RESOLUTION_HEIGHT_ID) const int TRANSMITTANCE_RESOLUTION_HEIGHT = TRANSMITTANCE_RESOLUTION_HEIGHT_DEFAULT;
+layout (constant_id = TRANSMITTANCE_RESOLUTION_VIEW_ID) const int TRANSMITTANCE_RESOLUTION_VIEW = TRANSMITTANCE_RESOLUTION_VIEW_DEFAULT;
+#endif
 
 #define TRANSMITTANCE_STEP_LENGTH 3000
 
+// integrator used by transmittance() in functions.glsl.
+// Trapezoid: TRANSMITTANCE_TRAPEZOID_STEPS uniform steps.
+// Gauss-Legendre: TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS uniform segments, three samples each.
+// Analytic: closed form using an approximation of the Chapman function, no loop. Also replaces the
+// density-integration in aerial_perspective.comp and the transmittance-fetches in cloud.frag.
+// 8 Gauss-Legendre segments (24 samples) are ~8x more accurate than 50 trapezoid steps on earth,
+// see SkyRenderer --transmittance-benchmark.
+#define TRANSMITTANCE_INTEGRATOR_TRAPEZOID 0
+#define TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE 1
+#define TRANSMITTANCE_INTEGRATOR_ANALYTIC 2
+#define TRANSMITTANCE_INTEGRATOR TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE
+
+#define TRANSMITTANCE_TRAPEZOID_STEPS 50
+#define TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS 8
+
 #define T_SETS_IMAGE 0
 #define T_SETS_ENV 1
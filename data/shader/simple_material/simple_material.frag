@@ -3,6 +3,7 @@
 
 layout(location = 0) in vec2 frag_uv;
 layout(location = 1) in vec3 frag_normal;
+layout(location = 2) in vec3 frag_world_pos;
 
 layout (set = 2, binding = 0) uniform material_uniform_t
 {
@@ -22,6 +23,11 @@ layout(set = 3, binding = 0) uniform sun_t
 
 layout(set = 4, binding = 0) uniform samplerCube environment_diffuse;
 
+#include "intersect.glsl"
+#include "cloud_shadow.h"
+CLOUD_SHADOW_SET(5)
+#include "cloud_shadow.glsl"
+
 layout (location = 0) out vec4 out_color;
 
 void main()
@@ -34,4 +40,6 @@ void main()
 		out_color = material_ubo.diffuse_color;
 
 	out_color.rgb *= texture(environment_diffuse, normal).rgb;
+	// there is no direct sunlight to shadow, the clouds darken the ambient light instead.
+	out_color.rgb *= mix(1.0, cloud_shadow_towards_sun(frag_world_pos, normalize(sun.dir)), cloud_shadow.terrain_strength);
 }
@@ -16,10 +16,13 @@ CAM_SET(1)
 
 layout(location = 0) out vec2 frag_uv;
 layout(location = 1) out vec3 frag_normal;
+layout(location = 2) out vec3 frag_world_pos;
 
 void main()
 {
-	gl_Position = cam.proj_view_mat * model_ubo.model_mat * vec4(pos, 1.0);
+	const vec4 world_pos = model_ubo.model_mat * vec4(pos, 1.0);
+	gl_Position = cam.proj_view_mat * world_pos;
+	frag_world_pos = world_pos.xyz;
 	frag_uv = uv;
 	frag_normal = normal;
 }
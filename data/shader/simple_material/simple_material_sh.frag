@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#include "sh.glsl"
+
+layout(location = 0) in vec2 frag_uv;
+layout(location = 1) in vec3 frag_normal;
+layout(location = 2) in vec3 frag_world_pos;
+
+layout (set = 2, binding = 0) uniform material_uniform_t
+{
+	vec4 diffuse_color;
+	uint use_diffuse_tex;
+} material_ubo;
+
+layout (set = 2, binding = 1) uniform sampler2D material_diffuse_tex;
+
+layout(set = 3, binding = 0) uniform sun_t
+{
+	vec3 color;
+	float zenith;
+	vec3 dir;
+	float azimuth;
+} sun;
+
+// ambient light projected by ground_lighting_sh.comp.
+layout(set = 4, binding = 0) uniform environment_sh_t
+{
+	vec4 coefficients[9];
+} environment_sh;
+
+#include "intersect.glsl"
+#include "cloud_shadow.h"
+CLOUD_SHADOW_SET(5)
+#include "cloud_shadow.glsl"
+
+layout (location = 0) out vec4 out_color;
+
+void main()
+{
+	vec3 normal = normalize(frag_normal);
+
+	if (material_ubo.use_diffuse_tex == 1)
+		out_color = texture(material_diffuse_tex, frag_uv);
+	else
+		out_color = material_ubo.diffuse_color;
+
+	out_color.rgb *= sh_evaluate(environment_sh.coefficients, normal);
+	// there is no direct sunlight to shadow, the clouds darken the ambient light instead.
+	out_color.rgb *= mix(1.0, cloud_shadow_towards_sun(frag_world_pos, normalize(sun.dir)), cloud_shadow.terrain_strength);
+}
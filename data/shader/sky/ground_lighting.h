@@ -12,3 +12,9 @@
 #define GRL_SETS_SCATTERING_SAMPLER0 4
 #define GRL_SETS_SCATTERING_SAMPLER1 5
 #define GRL_SETS_CUBEMAP_IMAGE 6
+
+// replaces the cubemap image in spherical harmonics mode (GroundLightingOutput::SphericalHarmonics).
+#define GRL_SETS_SH_BUFFER 6
+
+// L2 spherical harmonics, stored as vec4 (std140).
+#define GRL_SH_COEFFICIENTS 9
@@ -0,0 +1,23 @@
+// texels of the sky-view LUT of the medium quality tier, the ones in use are chosen at runtime
+// (en::AtmosphereQuality) and passed to the shaders as specialization constants.
+// Longitude in x, latitude in y, both relative to the camera (see sky_view.glsl).
+#define SKY_VIEW_X_DEFAULT 192
+#define SKY_VIEW_Y_DEFAULT 108
+#define SKY_VIEW_X_ID 21
+#define SKY_VIEW_Y_ID 22
+#ifndef __cplusplus
+layout (constant_id = SKY_VIEW_X_ID) const int SKY_VIEW_X = SKY_VIEW_X_DEFAULT;
+layout (constant_id = SKY_VIEW_Y_ID) const int SKY_VIEW_Y = SKY_VIEW_Y_DEFAULT;
+#endif
+
+// local size of sky_view.comp in x and y.
+#define SKY_VIEW_GROUP_SIZE 8
+
+#define SV_SETS_IMAGE 0
+#define SV_SETS_CAM 1
+#define SV_SETS_SUN 2
+#define SV_SETS_RATIO 3
+#define SV_SETS_ENV0 4
+#define SV_SETS_ENV1 5
+#define SV_SETS_SCATTERING_SAMPLER0 6
+#define SV_SETS_SCATTERING_SAMPLER1 7
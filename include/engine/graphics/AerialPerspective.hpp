@@ -6,10 +6,22 @@
 #include "engine/graphics/vulkan/CommandPool.hpp"
 #include "engine/graphics/vulkan/Shader.hpp"
 #include "engine/graphics/Camera.hpp"
+#include "engine/graphics/vulkan/Buffer.hpp"
 #include <array>
 
 #define IMAGE_COUNT 2
 
+// properly aligned.
+struct APFrameParams {
+	// from positions relative to the current camera to the clip space of the previous volume.
+	glm::mat4 m_PrevProjView;
+	float m_PrevNear;
+	float m_PrevFar;
+	// workgroup rows integrated this frame (wrapping around), the others are reprojected.
+	int32_t m_RowStart;
+	int32_t m_RowCount;
+};
+
 namespace en {
 
 class AerialPerspective {
@@ -18,6 +30,7 @@ class AerialPerspective {
 		~AerialPerspective();
 
 		void Compute(VkSemaphore *waitSemaphore, VkPipelineStageFlags waitFlags, VkSemaphore *signalSemaphore);
+		void RenderImgui();
 		VkDescriptorSet GetSampleDescriptor() const;
 		VkDescriptorSetLayout GetSampleDescriptorLayout() const;
 
@@ -29,33 +42,84 @@ class AerialPerspective {
 
 		vk::Shader m_Shader;
 
+		// froxel columns per workgroup (AP_GROUP_X, AP_GROUP_Y).
+		uint32_t m_GroupX;
+		uint32_t m_GroupY;
+
+		// timestamps before and after the dispatch, VK_NULL_HANDLE if not supported.
+		VkQueryPool m_QueryPool;
+		float m_TimestampPeriod;
+		// whether the queries were written by a submitted buffer.
+		bool m_Measuring;
+		// smoothed, in ms, negative if not measured yet.
+		float m_ComputeTime;
+
+		// spread the integration over several frames, reproject the rest.
+		bool m_Amortized;
+		// workgroup rows integrated per frame if amortized.
+		int m_RowsPerFrame;
+		uint32_t m_NextRow;
+		// workgroup rows not integrated since the inputs last changed, nothing is computed once this is 0.
+		uint32_t m_StaleRows;
+		// workgroup rows integrated by the last Compute.
+		uint32_t m_LastRows;
+
+		// inputs of the current volume, m_HasInputs is false until it was computed once.
+		bool m_HasInputs;
+		glm::mat4 m_LastRelativeProjView;
+		glm::vec3 m_LastCamPos;
+		float m_LastNear;
+		float m_LastFar;
+		SunData m_LastSun;
+		float m_LastRatio;
+
+		vk::Buffer m_FrameUBO;
+
 		vk::CommandPool m_CommandPool;
-		VkCommandBuffer m_ComputeCommandBuffer;
-		std::array<VkCommandBuffer, IMAGE_COUNT> m_LayoutCommandBuffer;
+		// one per sum target state (Precomputer::GetSumTargetState), for integrating all rows
+		// and for integrating only some (with the history copy).
+		std::array<std::array<VkCommandBuffer, SUM_TARGET_STATE_COUNT>, 2> m_ComputeCommandBuffers;
+		// Atmosphere::GetDescriptorGeneration the compute buffers were recorded with.
+		uint64_t m_DescriptorGeneration;
+		std::array<VkCommandBuffer, 2*IMAGE_COUNT> m_LayoutCommandBuffer;
 
 		VkDescriptorPool m_DescriptorPool;
 
-		VkFormat m_ComputeImageFormat;
+		// by binding.
+		std::array<LutFormat, IMAGE_COUNT> m_ImageFormats;
 
-		std::array<VkImage, IMAGE_COUNT> m_APImages;
-		std::array<VkDeviceMemory, IMAGE_COUNT> m_APImagesMemory;
-		std::array<VkImageView, IMAGE_COUNT> m_APImageViews;
+		// the current volume by binding, followed by a copy of the previous one.
+		std::array<VkImage, 2*IMAGE_COUNT> m_APImages;
+		std::array<VkDeviceMemory, 2*IMAGE_COUNT> m_APImagesMemory;
+		std::array<VkImageView, 2*IMAGE_COUNT> m_APImageViews;
 
 		VkDescriptorSetLayout m_ImageDescriptorLayout;
 		VkDescriptorSetLayout m_SampleDescriptorLayout;
+		VkDescriptorSetLayout m_ReprojectionDescriptorLayout;
 		VkDescriptorSet m_APImageDescriptor;
+		VkDescriptorSet m_ReprojectionDescriptor;
 
 		VkSampler m_LinearSampler;
 		VkDescriptorSet m_APImageSampleDescriptor;
 
 		VkPipelineLayout m_APPipelineLayout;
+		// only samples one sum target, used outside of blends.
 		VkPipeline m_APPipeline;
+		VkPipeline m_APBlendPipeline;
 
+		void SelectGroupSize();
+		void CreateQueryPool(VkDevice device);
+		void ReadTimestamps();
 		void CreateComputeImages(VkDevice device);
 		void CreateComputePipeline(VkDevice device);
 		void CreateDescriptors(VkDevice device);
 		void CreateCommandBuffers();
 		void RecordCommandBuffers();
+		void RecordCommandBuffer(VkCommandBuffer buf, size_t state, bool partial);
+		// copies the current volume into the previous one.
+		void RecordHistoryCopy(VkCommandBuffer buf);
+		// whether anything the volume depends on changed since the last Compute.
+		bool InputsChanged() const;
 };
 
 };
@@ -3,12 +3,84 @@
 #include "engine/graphics/vulkan/CommandPool.hpp"
 #include "engine/graphics/vulkan/Shader.hpp"
 #include "engine/graphics/EnvConditions.hpp"
+#include "engine/graphics/LutFormat.hpp"
 #include <array>
+#include <string>
+#include <vector>
 
 namespace en {
+	// images written/read by the precomputation, used to declare accesses of precompute-nodes.
+	// Scattering and Gathering are scratch images shared by both sum targets.
+	// Only the visible sum target stays allocated, the scratch images and the other sum target only exist
+	// while precomputing or blending (see Atmosphere::AllocateSumTarget).
+	enum class AtmosphereImage {
+		Transmittance,
+		Scattering,
+		ScatteringSum,
+		Gathering,
+		GatheringSum
+	};
+
+	// trades LUT memory and precompute time for quality, chosen at startup (SkyRenderer --quality).
+	enum class AtmosphereQuality {
+		Low,
+		Medium,
+		High
+	};
+
+	// sizes of the LUTs, the aerial perspective froxels and the sky-view LUT.
+	// Shaders receive them as specialization constants (the *_ID macros in the shared headers).
+	struct AtmosphereResolution {
+		uint32_t m_TransmittanceHeight;
+		uint32_t m_TransmittanceView;
+		uint32_t m_ScatteringHeight;
+		uint32_t m_ScatteringView;
+		uint32_t m_ScatteringSun;
+		uint32_t m_GatheringHeight;
+		uint32_t m_GatheringSun;
+		uint32_t m_ApX;
+		uint32_t m_ApY;
+		uint32_t m_ApZ;
+		uint32_t m_SkyViewX;
+		uint32_t m_SkyViewY;
+
+		static AtmosphereResolution FromQuality(AtmosphereQuality quality);
+		static const char *GetQualityName(AtmosphereQuality quality);
+		// returns false for an unknown name ("low", "medium", "high").
+		static bool ParseQuality(const std::string &name, AtmosphereQuality &quality);
+
+		// entries for all constants, offset is the position of the resolution in the specialization data.
+		static std::vector<VkSpecializationMapEntry> GetSpecializationMapEntries(uint32_t offset = 0);
+		// for shaders without other constants, only valid as long as this and entries live.
+		VkSpecializationInfo GetSpecializationInfo(const std::vector<VkSpecializationMapEntry> &entries) const;
+
+		bool operator==(const AtmosphereResolution &other) const = default;
+	};
+
+	// specialization data of shaders sampling the sum targets, m_Blend is LUT_BLEND (see blend.h).
+	struct LutBlendSpecialization {
+		AtmosphereResolution m_Resolution;
+		VkBool32 m_Blend;
+
+		// entries for the resolution and LUT_BLEND, offset is the position of this in the specialization data.
+		static std::vector<VkSpecializationMapEntry> GetSpecializationMapEntries(uint32_t offset = 0);
+		// for shaders without other constants, only valid as long as this and entries live.
+		VkSpecializationInfo GetSpecializationInfo(const std::vector<VkSpecializationMapEntry> &entries) const;
+	};
+
+	// raw texels of the LUTs of one sum target, always in m_Format so cached LUTs don't depend on the device.
+	// Atmosphere::ReadLuts/WriteLuts convert from/to the formats of the images.
+	struct AtmosphereLuts {
+		static constexpr LutFormat m_Format = LutFormat::Rgba16Unorm;
+
+		std::vector<char> m_Transmittance;
+		std::vector<char> m_ScatteringSum;
+		std::vector<char> m_GatheringSum;
+	};
+
 	class Atmosphere {
 		public:
-			Atmosphere(VkDescriptorSetLayout envLayout);
+			Atmosphere(VkDescriptorSetLayout envLayout, AtmosphereQuality quality = AtmosphereQuality::Medium);
 			~Atmosphere();
 
 			void Precompute() const;
@@ -24,13 +96,46 @@ namespace en {
 
 			EnvConditions &GetEnv();
 
-			void RecordTransmittanceCommandBuffer(VkCommandBuffer buf, size_t sum_target, VkDescriptorSet env);
-			void RecordSingleScatteringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
-			void RecordMultiScatteringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
-			void RecordGatheringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
+			const AtmosphereResolution &GetResolution() const;
+
+			VkImage GetImage(AtmosphereImage image, size_t sum_target) const;
+			LutFormat GetImageFormat(AtmosphereImage image) const;
+			VkExtent3D GetImageExtent(AtmosphereImage image) const;
+			VkDeviceSize GetImageSize(AtmosphereImage image) const;
+
+			// sum target 0 is allocated on construction, the sample/image descriptor sets of a target that isn't
+			// allocated alias the other target, so renderers can always bind both.
+			// Both (de)allocations rewrite descriptor sets, they are meant for the start/end of a precomputation
+			// and blend only. They don't wait, the caller makes sure no submitted work uses the target
+			// (the Precomputer waits on its timeline semaphore, frames are waited for by the main loop).
+			void AllocateSumTarget(size_t sum_target);
+			// the other target has to be allocated.
+			void ReleaseSumTarget(size_t sum_target);
+			bool IsSumTargetAllocated(size_t sum_target) const;
+			void AllocateScratch();
+			// like the sum targets, cancelled precomputations may still use the scratch images.
+			void ReleaseScratch();
+			bool IsScratchAllocated() const;
+			// changes whenever the descriptor sets of the sum targets are rewritten, command buffers
+			// recorded with them have to be recorded again.
+			uint64_t GetDescriptorGeneration() const;
+			// texel data of all currently allocated images.
+			VkDeviceSize GetAllocatedSize() const;
+
+			// synchronous, for loading/storing whole LUTs, not meant to be used every frame.
+			AtmosphereLuts ReadLuts(size_t sum_target);
+			void WriteLuts(size_t sum_target, const AtmosphereLuts &luts);
+
+			// record into an already begun buffer, synchronization is up to the caller.
+			void RecordGatheringSumClear(VkCommandBuffer buf, size_t sum_target);
+			void RecordTransmittance(VkCommandBuffer buf, size_t sum_target, VkDescriptorSet env);
+			void RecordSingleScattering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
+			void RecordMultiScattering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
+			void RecordGathering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env);
 
 		private:
 			VkDescriptorSetLayout m_EnvLayout;
+			AtmosphereResolution m_Resolution;
 
 			vk::Shader m_SingleShader;
 			vk::Shader m_MultiShader;
@@ -44,7 +149,9 @@ namespace en {
 
 			VkDescriptorPool m_DescriptorPool;
 
-			VkFormat m_ComputeImageFormat;
+			// scattering and gathering, the transmittance only needs three channels and may be packed.
+			LutFormat m_ComputeImageFormat;
+			LutFormat m_TransmittanceFormat;
 
 			VkImage m_ScatteringImage;
 			VkDeviceMemory m_ScatteringImageMemory;
@@ -66,8 +173,13 @@ namespace en {
 			std::array<VkDeviceMemory, 2> m_TransmittanceImageMemory;
 			std::array<VkImageView, 2> m_TransmittanceImageView;
 
+			std::array<bool, 2> m_SumTargetAllocated;
+			bool m_ScratchAllocated;
+			uint64_t m_DescriptorGeneration;
+
 			vk::CommandPool m_LayoutCommandPool;
-			std::vector<VkCommandBuffer> m_LayoutCommandBuffers;
+			// reused for the layout transition of every allocation.
+			VkCommandBuffer m_LayoutCommandBuffer;
 
 
 			VkDescriptorSetLayout m_ImageDescriptorLayout;
@@ -101,5 +213,13 @@ namespace en {
 			void CreateComputePipeline(VkDevice device);
 			void CreateDescriptors(VkDevice device);
 			void CreateCommandBuffers();
+			void CreateImage(VkDevice device, AtmosphereImage image, VkImage &vkImage, VkDeviceMemory &memory, VkImageView &view);
+			void DestroyImage(VkDevice device, VkImage vkImage, VkDeviceMemory memory, VkImageView view);
+			// to general layout, cleared to zero so blending with a fresh target never mixes in garbage.
+			void InitImages(const std::vector<VkImage> &images);
+			void WriteDescriptorSets(VkDevice device, VkDescriptorSet imageSet, VkDescriptorSet sampleSet, VkImageView view);
+			// points the descriptor sets of sum_target at the images of source.
+			void WriteSumTargetDescriptorSets(VkDevice device, size_t sum_target, size_t source);
+			void CopyLuts(size_t sum_target, AtmosphereLuts &luts, bool upload);
 	};
 }
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "engine/graphics/EnvConditions.hpp"
+#include <string>
+#include <vector>
+
+namespace en {
+	struct AtmospherePreset {
+		std::string m_Name;
+		EnvConditions::Environment m_Env;
+	};
+
+	// baked into LUT packs by tools/LutBaker.cpp, the first one (earth) is the default environment.
+	const std::vector<AtmospherePreset> &GetAtmospherePresets();
+}
@@ -61,12 +61,15 @@ namespace en
 		void SetFarPlane(float farPlane);
 
 		VkDescriptorSet GetDescriptorSet() const;
+		// projection*view of the last UpdateUBO without the translation, for positions relative to the camera.
+		const glm::mat4& GetRelativeProjView() const;
 
 	private:
 		static VkDescriptorSetLayout m_DescriptorSetLayout;
 		static VkDescriptorPool m_DescriptorPool;
 
 		CamParams m_UboData;
+		glm::mat4 m_RelativeProjView;
 
 		float m_Zenith;
 
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "engine/graphics/Sun.hpp"
+#include "engine/graphics/vulkan/Buffer.hpp"
+#include "engine/graphics/vulkan/CommandPool.hpp"
+#include "engine/graphics/vulkan/Shader.hpp"
+#include "engine/objects/CloudData.hpp"
+#include "engine/objects/Wind.hpp"
+
+// properly aligned, binding 1 of the sample descriptor (CLOUD_SHADOW_SET in cloud_shadow.h).
+struct CloudShadowUniformData {
+	// sky box the volume was computed for.
+	glm::vec3 m_BoxMin;
+	// how much the shadow darkens the light of the terrain, 0 to 1.
+	float m_TerrainStrength;
+	glm::vec3 m_BoxSize;
+	// the raymarching samples the volume instead of marching toward the sun.
+	int32_t m_UseInClouds;
+	// wind offset since the volume was computed, in texture coordinates of the sky box (x, z).
+	glm::vec2 m_WindShift;
+};
+
+namespace en {
+
+// transmittance from each point of the cloud sky box toward the sun, in a volume aligned with the box.
+// Sampled once per sample by the cloud raymarching and by the materials for cloud shadows on the terrain.
+class CloudShadow {
+	public:
+		CloudShadow(const Sun &sun, const Wind &wind, const CloudData &cloudData);
+		~CloudShadow();
+
+		// only dispatches if the sun or the clouds changed, or the wind moved the weather by more than
+		// CLOUD_SHADOW_MAX_WIND_SHIFT texels since the last dispatch. Smaller movements shift the lookups.
+		void Compute();
+		void RenderImgui();
+		VkDescriptorSet GetSampleDescriptorSet() const;
+		VkDescriptorSetLayout GetSampleDescriptorLayout() const;
+
+	private:
+		const Sun &m_Sun;
+		const Wind &m_Wind;
+		const CloudData &m_CloudData;
+
+		vk::Shader m_Shader;
+
+		vk::CommandPool m_CommandPool;
+		// the descriptor sets never change, recorded once.
+		VkCommandBuffer m_ComputeCommandBuffer;
+		VkCommandBuffer m_LayoutCommandBuffer;
+
+		// inputs of the current volume, unset until it was computed once.
+		// m_LastWindOffset is the offset it was computed with, not the one of the last frame.
+		bool m_HasInputs;
+		glm::vec3 m_LastSunDir;
+		glm::vec2 m_LastWindOffset;
+		CloudUniformData m_LastCloudData;
+		// if the last Compute dispatched.
+		bool m_Updated;
+
+		CloudShadowUniformData m_UniformData;
+		vk::Buffer m_UniformBuffer;
+
+		VkImage m_Image;
+		VkDeviceMemory m_ImageMemory;
+		VkImageView m_ImageView;
+
+		VkDescriptorPool m_DescriptorPool;
+		VkDescriptorSetLayout m_ImageDescriptorLayout;
+		VkDescriptorSetLayout m_SampleDescriptorLayout;
+		VkDescriptorSet m_ImageDescriptor;
+
+		VkSampler m_LinearSampler;
+		VkDescriptorSet m_SampleDescriptor;
+
+		VkPipelineLayout m_PipelineLayout;
+		VkPipeline m_Pipeline;
+
+		void CreateComputeImage(VkDevice device);
+		void CreateDescriptors(VkDevice device);
+		void CreateComputePipeline(VkDevice device);
+		void RecordCommandBuffer();
+};
+
+}
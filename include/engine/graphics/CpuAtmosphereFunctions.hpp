@@ -0,0 +1,200 @@
+#pragma once
+
+#include "engine/graphics/EnvConditions.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <transmittance.h>
+
+// the helpers of functions.glsl on the CPU, shared by CpuPrecomputer and the diagnostics in
+// CpuPrecomputeDiagnostics. Same constants as in the shaders, results have to match them.
+namespace en::cpu {
+	inline const float pi = 3.1415f;
+	// 3-point Gauss-Legendre on [-1, 1].
+	inline const double gaussNodes[3] {-0.7745966692414834, 0, 0.7745966692414834};
+	inline const double gaussWeights[3] {5.0/9.0, 8.0/9.0, 5.0/9.0};
+	inline const float infinity = std::numeric_limits<float>::infinity();
+
+	inline float DensityR(float height, float rScaleHeight) {
+		return std::exp(-height/rScaleHeight);
+	}
+
+	inline float DensityM(float height, float mScaleHeight) {
+		return std::exp(-height/mScaleHeight);
+	}
+
+	inline float DensityO(float height, float rScaleHeight) {
+		return DensityR(height, rScaleHeight)*6e-7f;
+	}
+
+	// height(vec2) in functions.glsl.
+	inline float Height(float x, float y, float rPlanet) {
+		return std::max(std::sqrt(x*x + y*y) - rPlanet, 0.3f);
+	}
+
+	inline void UnitVecFromCos(float c, float &x, float &y) {
+		c = std::min(c, 1.0f);
+		x = std::sqrt(1 - c*c);
+		y = c;
+	}
+
+	// x such that |p+x*dir| == r, infinity on no intersection.
+	inline float ConcentricCircleIntersect(float px, float py, float dx, float dy, float r) {
+		float pdd = px*dx + py*dy;
+		float xPart = pdd*pdd - (px*px + py*py) + r*r;
+		if (xPart < 0)
+			return infinity;
+		xPart = std::sqrt(xPart);
+		float res = -pdd - xPart;
+		if (res >= 0)
+			return res;
+		res = -pdd + xPart;
+		return res >= 0 ? res : infinity;
+	}
+
+	// distance to the earth along dir, to the atmosphere if the earth isn't hit.
+	inline float AtmosphereEarthIntersect(float px, float py, float dx, float dy, float rPlanet, float rAtmosphere) {
+		float x = ConcentricCircleIntersect(px, py, dx, dy, rPlanet);
+		return x == infinity ? ConcentricCircleIntersect(px, py, dx, dy, rAtmosphere) : x;
+	}
+
+	// ray/sphere intersection as it was done in atmosphere.frag (in double), sphere around (0, -rPlanet, 0).
+	template<typename T>
+	inline T SphereIntersect(const T *o, const T *u, T rPlanet, T r) {
+		T rel[3] {o[0], o[1] + rPlanet, o[2]};
+		T a = u[0]*rel[0] + u[1]*rel[1] + u[2]*rel[2];
+		T centerDist = std::sqrt(rel[0]*rel[0] + rel[1]*rel[1] + rel[2]*rel[2]);
+		T underRoot = a*a - centerDist*centerDist + r*r;
+		if (underRoot < 0)
+			return std::numeric_limits<T>::infinity();
+		T res = -a - std::sqrt(underRoot);
+		return res < 0 ? std::numeric_limits<T>::infinity() : res;
+	}
+
+	// planet_sphere_intersect in functions.glsl.
+	inline float PlanetSphereIntersect(const float *o, const float *u, float rPlanet, float r) {
+		float c = o[0]*o[0] + o[1]*o[1] + o[2]*o[2] + 2*rPlanet*o[1] + (rPlanet-r)*(rPlanet+r);
+		float b = u[0]*o[0] + u[1]*o[1] + u[2]*o[2] + rPlanet*u[1];
+		float underRoot = b*b - c;
+		if (b*b > r*r) {
+			float l[3] {o[0] - b*u[0], o[1] + rPlanet - b*u[1], o[2] - b*u[2]};
+			float lLength = std::sqrt(l[0]*l[0] + l[1]*l[1] + l[2]*l[2]);
+			underRoot = (r-lLength)*(r+lLength);
+		}
+		if (underRoot < 0)
+			return infinity;
+		float q = -(b + (b < 0 ? -1 : 1)*std::sqrt(underRoot));
+		if (q == 0)
+			return 0;
+		float res = std::min(q, c/q);
+		return res < 0 ? infinity : res;
+	}
+
+	inline float HeightToTex(float h, float atmosphereHeight) {
+		return std::pow(h/atmosphereHeight, 0.5f);
+	}
+
+	inline float TexToHeight(float u, float atmosphereHeight) {
+		return u*u*atmosphereHeight;
+	}
+
+	inline float ViewToTex(float cView, float h, float rPlanet) {
+		float cHorizon = -std::sqrt(h*(2*rPlanet + h))/(rPlanet + h);
+		if (cView > cHorizon)
+			return 0.5f + 0.5f*std::pow((cView - cHorizon)/(1 - cHorizon), 0.2f);
+		else
+			return 0.5f - 0.5f*std::pow((cHorizon - cView)/(1 + cHorizon), 0.2f);
+	}
+
+	inline float TexToView(float u, float h, float rPlanet) {
+		float cHorizon = -std::sqrt(h*(2*rPlanet + h))/(rPlanet + h);
+		if (u > 0.5f) {
+			float tmp = 2*(u - 0.5f);
+			return cHorizon + tmp*tmp*tmp*tmp*tmp*(1 - cHorizon);
+		} else {
+			float tmp = -2*(u - 0.5f);
+			return cHorizon - tmp*tmp*tmp*tmp*tmp*(1 + cHorizon);
+		}
+	}
+
+	inline float SunToTex(float cSun) {
+		return 0.5f*(std::atan(std::max(cSun, -0.1975f)*std::tan(1.26f*1.1f))/1.1f + (1 - 0.26f));
+	}
+
+	inline float TexToSun(float u) {
+		return std::tan(1.1f*(2*u - 1 + 0.26f))/std::tan(1.26f*1.1f);
+	}
+
+	// chapman in functions.glsl.
+	template<typename T>
+	inline T Chapman(T x, T mu) {
+		T y = std::sqrt(T(0.5)*x)*mu;
+		return std::sqrt(T(0.5)*x)/(T(0.656)*y + std::sqrt(T(0.118336)*y*y + 1/T(pi)));
+	}
+
+	// optical_depth_to_infinity in functions.glsl.
+	template<typename T>
+	inline T OpticalDepthToInfinity(T r, T mu, T rPlanet, T scaleHeight) {
+		if (mu >= 0)
+			return scaleHeight*std::exp((rPlanet - r)/scaleHeight)*Chapman(r/scaleHeight, mu);
+
+		T r0 = r*std::sqrt(1 - mu*mu);
+		return scaleHeight*(
+			2*std::exp((rPlanet - r0)/scaleHeight)*Chapman(r0/scaleHeight, T(0)) -
+			std::exp((rPlanet - r)/scaleHeight)*Chapman(r/scaleHeight, -mu));
+	}
+
+	// optical_depth_analytic in functions.glsl.
+	template<typename T>
+	inline T OpticalDepthAnalytic(T r, T mu, T t, T rPlanet, T scaleHeight) {
+		T rT = std::sqrt(r*r + t*t + 2*r*t*mu);
+		T muT = (r*mu + t)/rT;
+		T depth = muT < 0 ?
+			OpticalDepthToInfinity(rT, -muT, rPlanet, scaleHeight) - OpticalDepthToInfinity(r, -mu, rPlanet, scaleHeight) :
+			OpticalDepthToInfinity(r, mu, rPlanet, scaleHeight) - OpticalDepthToInfinity(rT, muT, rPlanet, scaleHeight);
+		return std::max(depth, T(0));
+	}
+
+	// density-integrals (mie, rayleigh, ozone) along the ray from (0, fromY), like transmittance() in functions.glsl.
+	// integrator is one of TRANSMITTANCE_INTEGRATOR_*, steps is ignored by the analytic one.
+	template<typename T>
+	inline void OpticalDepth(const EnvConditions::EnvironmentData &env, T fromY, T dirX, T dirY, T length, int integrator, int steps, T *depth) {
+		auto densities = [&](T t, T *dens) {
+			T x = t*dirX;
+			T y = fromY + t*dirY;
+			T h = std::max(std::sqrt(x*x + y*y) - T(env.m_PlanetRadius), T(0.3));
+			dens[0] = std::exp(-h/T(env.m_MieScaleHeight));
+			dens[1] = std::exp(-h/T(env.m_RayleighScaleHeight));
+			dens[2] = dens[1]*T(6e-7);
+		};
+
+		T dens[3];
+		std::fill(depth, depth+3, T(0));
+		if (integrator == TRANSMITTANCE_INTEGRATOR_ANALYTIC) {
+			// dir is a unit vector, so dirY is the zenith-cosine at (0, fromY).
+			depth[0] = OpticalDepthAnalytic(fromY, dirY, length, T(env.m_PlanetRadius), T(env.m_MieScaleHeight));
+			depth[1] = OpticalDepthAnalytic(fromY, dirY, length, T(env.m_PlanetRadius), T(env.m_RayleighScaleHeight));
+			depth[2] = depth[1]*T(6e-7);
+		} else if (integrator == TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE) {
+			T segmentLength = length/steps;
+			for (int i = 0; i != steps; ++i)
+				for (int j = 0; j != 3; ++j) {
+					densities(segmentLength*(i + T(0.5) + T(0.5)*T(gaussNodes[j])), dens);
+					for (int c = 0; c != 3; ++c)
+						depth[c] += dens[c]*T(0.5)*segmentLength*T(gaussWeights[j]);
+				}
+		} else {
+			T stepLength = length/steps;
+			T prev[3];
+			densities(0, prev);
+			for (int i = 1; i <= steps; ++i) {
+				densities(stepLength*i, dens);
+				for (int c = 0; c != 3; ++c) {
+					depth[c] += (prev[c] + dens[c])/T(2)*stepLength;
+					prev[c] = dens[c];
+				}
+			}
+		}
+	}
+}
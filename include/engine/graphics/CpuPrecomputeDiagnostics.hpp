@@ -0,0 +1,19 @@
+#pragma once
+
+#include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/CpuPrecomputer.hpp"
+#include "engine/graphics/EnvConditions.hpp"
+
+// measurements on the CPU mirror of the atmosphere shaders (see CpuAtmosphereFunctions), not needed for precomputing.
+namespace en {
+	// logs error and cost of both transmittance integrators for several step counts, compared to a
+	// high-step reference over the rays of all transmittance texels.
+	void BenchmarkTransmittanceIntegrators(const EnvConditions::Environment &env, const AtmosphereResolution &resolution);
+	// logs the error of the float ray/planet and ray/atmosphere intersections of atmosphere.frag and
+	// sky_view.comp (planet_sphere_intersect), and of the naive float version, against a double
+	// reference for camera heights from the ground to orbit.
+	void LogSphereIntersectionPrecision(const EnvConditions::Environment &env);
+	// logs the error of storing the LUTs of the last Run of precomputer in each LutFormat with enough channels,
+	// checks the precision of the packed formats against the full-precision LUTs.
+	void LogFormatErrors(const CpuPrecomputer &precomputer);
+}
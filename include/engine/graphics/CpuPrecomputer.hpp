@@ -0,0 +1,81 @@
+#pragma once
+
+#include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/EnvConditions.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// texels processed together by one kernel invocation, lane loops are kept simple so they can be vectorized.
+#define CPU_PRECOMPUTE_LANES 8
+// max. absolute difference per channel accepted when comparing against the GPU.
+#define CPU_PRECOMPUTE_TOLERANCE 2e-3f
+
+namespace en {
+	// computes the atmosphere LUTs on the CPU, mirrors transmittance.comp, single_scattering.comp,
+	// gathering.comp and multi_scattering.comp (and their helpers in functions.glsl).
+	// Doesn't need a device, so LUTs can be computed on machines without a GPU.
+	class CpuPrecomputer {
+		public:
+			// difference between two sets of LUTs, per LUT.
+			struct LutError {
+				float m_Max;
+				float m_Mean;
+			};
+
+			// ms spent in each stage by the last Run.
+			struct Timings {
+				float m_Transmittance;
+				float m_SingleScattering;
+				float m_Gathering;
+				float m_MultiScattering;
+				float m_Total;
+			};
+
+			// threadCount of 0 uses all hardware threads.
+			CpuPrecomputer(const EnvConditions::Environment &env, const AtmosphereResolution &resolution, uint32_t threadCount = 0);
+
+			void Run();
+
+			// encoded in the format of the atmosphere images, can be passed to LutCache or Atmosphere::WriteLuts.
+			AtmosphereLuts GetLuts() const;
+			const Timings &GetTimings() const;
+			// logs texels per second for each stage of the last Run.
+			void LogBenchmark() const;
+			// full-precision LUTs of the last Run, four floats per texel in the layout of the images.
+			const std::vector<float> &GetTransmittance() const;
+			const std::vector<float> &GetScatteringSum() const;
+			const std::vector<float> &GetGatheringSum() const;
+
+			// transmittance, scattering, gathering.
+			static std::array<LutError, 3> Compare(const AtmosphereLuts &a, const AtmosphereLuts &b);
+			// compares with the GPU-LUTs, logs the result and returns true if they are within tolerance.
+			static bool LogComparison(const AtmosphereLuts &cpu, const AtmosphereLuts &gpu);
+
+		private:
+			// four floats per texel, same layout as the images (x, the height, varies fastest).
+			typedef std::vector<float> Lut;
+
+			EnvConditions::EnvironmentData m_EnvData;
+			AtmosphereResolution m_Resolution;
+			uint32_t m_ThreadCount;
+
+			Lut m_Transmittance;
+			// scratch, holds the last computed order.
+			Lut m_Scattering;
+			Lut m_ScatteringSum;
+			Lut m_Gathering;
+			Lut m_GatheringSum;
+
+			Timings m_Timings;
+
+			// calls func for every height-row in [0, rows), spread over m_ThreadCount threads.
+			void ParallelRows(uint32_t rows, const std::function<void(uint32_t)> &func) const;
+
+			void TransmittanceRow(uint32_t x);
+			void SingleScatteringRow(uint32_t x);
+			void GatheringRow(uint32_t x);
+			void MultiScatteringRow(uint32_t x);
+	};
+}
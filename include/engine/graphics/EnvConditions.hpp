@@ -30,7 +30,7 @@ namespace en {
 			Environment GetEnvironment();
 			void SetEnvironment(const Environment &env);
 
-		private:
+			// derived values as used by the shaders.
 			// All variables aligned by default.
 			struct EnvironmentData {
 				glm::vec3 m_RayleighSCoeff;
@@ -46,6 +46,7 @@ namespace en {
 				EnvironmentData(Environment);
 			};
 
+		private:
 			Environment m_Env;
 
 			EnvironmentData m_EnvData;
@@ -3,6 +3,7 @@
 #include "engine/graphics/Atmosphere.hpp"
 #include "engine/graphics/Precomputer.hpp"
 #include "engine/graphics/Sun.hpp"
+#include "engine/graphics/vulkan/Buffer.hpp"
 #include "engine/graphics/vulkan/CommandPool.hpp"
 #include "engine/graphics/vulkan/Shader.hpp"
 #include "engine/graphics/Camera.hpp"
@@ -12,51 +13,88 @@
 
 namespace en {
 
+// ambient light of the materials, chosen at startup (SkyRenderer --ambient cubemap|sh).
+enum class GroundLightingOutput {
+	// irradiance per direction in a 6-face cubemap.
+	Cubemap,
+	// radiance of the sky projected into 9 (L2) coefficients in a uniform buffer.
+	SphericalHarmonics
+};
+
 class GroundLighting {
 	public:
-		GroundLighting(Precomputer &precomp, Atmosphere &atm, Sun &sun);
+		GroundLighting(Precomputer &precomp, Atmosphere &atm, Sun &sun, GroundLightingOutput output);
 		~GroundLighting();
 
+		// only dispatches if the sun, the blend ratio or the LUTs changed since the last update.
 		void Compute();
+		void RenderImgui();
 		VkDescriptorSet GetSampleDescriptorSet() const;
 		VkDescriptorSetLayout GetSampleDescriptorLayout() const;
+		GroundLightingOutput GetOutput() const;
 
 	private:
 		Precomputer &m_Precomp;
 		Atmosphere &m_Atmosphere;
 		Sun &m_Sun;
+		GroundLightingOutput m_Output;
 
 		vk::Shader m_Shader;
 
 		vk::CommandPool m_CommandPool;
-		VkCommandBuffer m_ComputeCommandBuffer;
+		// one per sum target state (Precomputer::GetSumTargetState).
+		std::array<VkCommandBuffer, SUM_TARGET_STATE_COUNT> m_ComputeCommandBuffers;
+		// same, but only updating a single face, only recorded for the cubemap.
+		std::array<std::array<VkCommandBuffer, CUBE_FACES>, SUM_TARGET_STATE_COUNT> m_FaceCommandBuffers;
+		// Atmosphere::GetDescriptorGeneration the compute buffers were recorded with.
+		uint64_t m_DescriptorGeneration;
 		VkCommandBuffer m_LayoutCommandBuffer;
 
+		// inputs of the current cubemap, unset until it was computed once.
+		bool m_HasInputs;
+		glm::vec3 m_LastSunDir;
+		glm::vec3 m_LastSunColor;
+		float m_LastRatio;
+		// distance between the sun directions (~angle in radians) before the cubemap is updated.
+		float m_SunThreshold;
+		// if only the sun moved, update one face of the cubemap per frame instead of all of them.
+		bool m_Incremental;
+		uint32_t m_NextFace;
+		// faces not updated since the sun last moved.
+		uint32_t m_StaleFaces;
+		// faces updated by the last Compute.
+		uint32_t m_LastFaces;
+
 		VkDescriptorPool m_DescriptorPool;
 
 		VkFormat m_ComputeImageFormat;
 
+		// only the cubemap or the coefficients exist, depending on m_Output.
 		VkImage m_GLImage;
 		VkDeviceMemory m_GLImagesMemory;
 		VkImageView m_CubeImageView;
 		VkImageView m_ImageView;
+		vk::Buffer *m_SHBuffer;
 
-		VkDescriptorSetLayout m_ImageDescriptorLayout;
+		// written in compute, storage image or storage buffer.
+		VkDescriptorSetLayout m_TargetDescriptorLayout;
 		VkDescriptorSetLayout m_SampleDescriptorLayout;
-		VkDescriptorSet m_CubemapImageDescriptor;
+		VkDescriptorSet m_TargetDescriptor;
 
 		VkSampler m_LinearSampler;
-		VkDescriptorSet m_CubemapSampleDescriptor;
+		VkDescriptorSet m_SampleDescriptor;
 
 		VkPipelineLayout m_GLPipelineLayout;
+		// only samples one sum target, used outside of blends.
 		VkPipeline m_GLPipeline;
+		VkPipeline m_GLBlendPipeline;
 
 		void CreateComputeImages(VkDevice device);
 		void CreateComputePipeline(VkDevice device);
 		void CreateDescriptors(VkDevice device);
+		void CreateSHDescriptors(VkDevice device);
 		void CreateCommandBuffers();
 		void RecordCommandBuffers();
-		void GenerateVectors();
 };
 
 };
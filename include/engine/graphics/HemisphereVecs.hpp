@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+
+#include "ground_lighting.h"
+
+namespace en {
+
+// sample directions of the ground lighting, evaluated at compile time. tools/HemisphereVecsGenerator
+// emits them into shader_generated/hemisphere_vecs.glsl of the build directory at build time.
+namespace hemisphere {
+
+// most steps are taken at the belly of the sphere, sin(90) = 1.
+constexpr int MAX_HOR_STEPS = int(2*3.14159265358979/GRL_VEC_HOR_DIST);
+// zenith, GRL_ZENITH_ANGLES rings and nadir.
+constexpr int RING_COUNT = GRL_ZENITH_ANGLES+2;
+
+// std::sin isn't constexpr, the taylor series converges quickly after reducing to [-pi, pi].
+constexpr double Sin(double x) {
+	constexpr double pi = 3.14159265358979;
+	while (x > pi)
+		x -= 2*pi;
+	while (x < -pi)
+		x += 2*pi;
+	double term = x;
+	double sum = x;
+	for (int i = 1; i != 16; ++i) {
+		term *= -x*x/((2*i)*(2*i+1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double Cos(double x) {
+	return Sin(x + 3.14159265358979/2);
+}
+
+struct Vecs {
+	std::array<int, RING_COUNT> m_HorSizes;
+	// only the first m_HorSizes[i] directions of ring i are set, the rest is zero.
+	std::array<std::array<std::array<float, 3>, MAX_HOR_STEPS>, RING_COUNT> m_Dirs;
+};
+
+constexpr Vecs Generate() {
+	constexpr double pi = 3.14159265358979;
+	Vecs vecs{};
+
+	vecs.m_HorSizes[0] = 1;
+	vecs.m_Dirs[0][0] = {0, 1, 0};
+
+	// don't sample vec3(0,-1,0) GRL_AZIMUTH_ANGLES-times.
+	double zenith_step = pi/2/(GRL_ZENITH_ANGLES+1);
+	for (int i = 1; i != GRL_ZENITH_ANGLES+1; ++i) {
+		double zenith = zenith_step*i;
+
+		// calculate azimuth-angle-step based on circumference of sphere at given zenith angle.
+		int az_steps = int(Sin(zenith)*2*pi/GRL_VEC_HOR_DIST);
+		double az_step = 2*pi/az_steps;
+		vecs.m_HorSizes[i] = az_steps;
+
+		// azimuth has to complete one circle, starting one step away from +z.
+		for (int j = 0; j != az_steps; ++j) {
+			double azimuth = az_step*(j+1);
+			vecs.m_Dirs[i][j] = {
+				float(Sin(zenith)*Sin(azimuth)),
+				float(Cos(zenith)),
+				float(Sin(zenith)*Cos(azimuth)) };
+		}
+	}
+
+	vecs.m_HorSizes[GRL_ZENITH_ANGLES+1] = 1;
+	vecs.m_Dirs[GRL_ZENITH_ANGLES+1][0] = {0, -1, 0};
+	return vecs;
+}
+
+constexpr Vecs vecs = Generate();
+
+constexpr int VecCount() {
+	int count = 0;
+	for (int size : vecs.m_HorSizes)
+		count += size;
+	return count;
+}
+
+}
+
+}
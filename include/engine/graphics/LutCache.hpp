@@ -0,0 +1,53 @@
+#pragma once
+
+#include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/EnvConditions.hpp"
+#include <string>
+#include <cstdint>
+
+#include <istream>
+#include <ostream>
+
+// bump whenever the precompute-shaders change their output, invalidates cache-files and packs.
+#define LUT_CACHE_VERSION 2
+
+namespace en {
+	// everything the LUTs depend on, written verbatim into cache-files and packs.
+	struct LutKey {
+		uint32_t m_Version;
+		uint32_t m_Constants[12];
+		EnvConditions::Environment m_Env;
+
+		// the resolutions are part of the key, LUTs of different quality tiers don't collide.
+		// Parameters the LUTs don't depend on are zeroed, environments only differing in them share an entry.
+		static LutKey Create(const EnvConditions::Environment &env, const AtmosphereResolution &resolution);
+		// bytewise.
+		bool operator==(const LutKey &other) const;
+	};
+
+	// the three LUTs, each prefixed by its size.
+	void WriteLutData(std::ostream &stream, const AtmosphereLuts &luts);
+	// returns false on a truncated stream or if the sizes don't match resolution, luts is left unchanged in that case.
+	bool ReadLutData(std::istream &stream, const AtmosphereResolution &resolution, AtmosphereLuts &luts);
+	// moves past the LUTs of an entry that is not used, returns false on a truncated stream.
+	bool SkipLutData(std::istream &stream);
+
+	// stores precomputed LUTs of one resolution on disk, one file per environment.
+	// Files also record the resolutions and step constants they were computed with, entries with
+	// different constants are treated as missing.
+	class LutCache {
+		public:
+			LutCache(const std::string &directory, const AtmosphereResolution &resolution);
+
+			bool Contains(const EnvConditions::Environment &env) const;
+			// returns false if there is no (valid) entry for env, luts is left unchanged in that case.
+			bool Load(const EnvConditions::Environment &env, AtmosphereLuts &luts) const;
+			void Store(const EnvConditions::Environment &env, const AtmosphereLuts &luts) const;
+
+		private:
+			std::string m_Directory;
+			AtmosphereResolution m_Resolution;
+
+			std::string GetPath(const LutKey &key) const;
+	};
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace en {
+	// formats a LUT can be stored in on the device, the packed ones halve the footprint of rgb-LUTs.
+	enum class LutFormat {
+		Rgba16Unorm,
+		Rgba16Snorm,
+		B10G11R11Ufloat,
+		E5B9G9R9Ufloat,
+		// for values outside [0, 1] the other formats can't hold.
+		Rgba16Sfloat
+	};
+
+	struct LutFormatInfo {
+		VkFormat m_VkFormat;
+		const char *m_Name;
+		uint32_t m_TexelSize;
+		uint32_t m_Channels;
+		// max. absolute rounding error for values in [0, 1].
+		float m_MaxError;
+	};
+
+	// what a LUT needs from its format.
+	struct LutFormatRequirements {
+		uint32_t m_Channels;
+		float m_MaxError;
+	};
+
+	const LutFormatInfo &GetLutFormatInfo(LutFormat format);
+
+	// four floats per texel, channels the format doesn't store are dropped (and decoded as 0).
+	std::vector<char> EncodeLut(LutFormat format, const float *texels, size_t count);
+	std::vector<float> DecodeLut(LutFormat format, const std::vector<char> &data);
+	std::vector<char> ConvertLut(LutFormat from, LutFormat to, const std::vector<char> &data);
+
+	// first candidate (smallest first) meeting the requirements whose VkFormat supports features,
+	// falls back to the last candidate.
+	// The shaders write these images without format qualifier, without shaderStorageImageWriteWithoutFormat
+	// only the fallback is used.
+	LutFormat SelectLutFormat(const std::vector<LutFormat> &candidates, const LutFormatRequirements &requirements, VkFormatFeatureFlags features);
+}
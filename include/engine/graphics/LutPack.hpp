@@ -0,0 +1,39 @@
+#pragma once
+
+#include "engine/graphics/LutCache.hpp"
+#include <string>
+#include <vector>
+
+// bump whenever the layout of pack-files changes.
+#define LUT_PACK_VERSION 1
+
+namespace en {
+	// named, baked LUTs of one resolution for a set of environments (presets), stored in a single file.
+	// Created offline (tools/LutBaker.cpp), loaded at startup so switching to a preset needs no precomputation.
+	class LutPack {
+		public:
+			LutPack(const AtmosphereResolution &resolution);
+
+			// where the baker writes and the renderer looks for the pack of quality, relative to the repository root.
+			static std::string GetDefaultPath(AtmosphereQuality quality);
+
+			struct Entry {
+				std::string m_Name;
+				LutKey m_Key;
+				AtmosphereLuts m_Luts;
+			};
+
+			void Add(const std::string &name, const EnvConditions::Environment &env, const AtmosphereLuts &luts);
+			// entries baked with other constants, resolutions or shaders (LUT_CACHE_VERSION) are skipped.
+			bool Load(const std::string &path);
+			bool Save(const std::string &path) const;
+
+			// nullptr if there is no entry for env.
+			const AtmosphereLuts *Find(const EnvConditions::Environment &env) const;
+			const std::vector<Entry> &GetEntries() const;
+
+		private:
+			AtmosphereResolution m_Resolution;
+			std::vector<Entry> m_Entries;
+	};
+}
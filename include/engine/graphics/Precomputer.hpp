@@ -1,24 +1,43 @@
 #pragma once
 
 #include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/LutCache.hpp"
+#include "engine/graphics/LutPack.hpp"
 #include <cassert>
 #include <cstdint>
 #include <functional>
-#include <queue>
+#include <deque>
 #include <vulkan/vulkan_core.h>
 #include <memory>
-#include <list>
+#include <optional>
+#include <array>
 
-typedef std::vector<VkCommandBuffer>::iterator BufIter;
-typedef std::function<void()> InstantiaterResult;
-typedef std::function<InstantiaterResult(uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter &currentBuffer, VkDescriptorSet &env)> Instantiater;
+typedef std::function<void()> FrameTask;
 
-typedef std::function<void()> CleanupTask;
+#define PRECOMPUTE_STAGE_COUNT 5
+
+// states of the sum targets seen by renderers: 0/1 if only that target is visible, SUM_TARGET_STATE_BLEND
+// while blending between both. Renderers keep one pipeline variant (LUT_BLEND) per state.
+#define SUM_TARGET_STATE_BLEND 2
+#define SUM_TARGET_STATE_COUNT 3
+
+// bitmask of PrecomputeStages, bit i is set for stage i.
+typedef uint32_t PrecomputeStageFlags;
 
 namespace en {
+	enum class PrecomputeStage {
+		GatheringClear,
+		Transmittance,
+		SingleScattering,
+		Gathering,
+		MultiScattering
+	};
+
 	class Precomputer {
 		public:
-			Precomputer(Atmosphere &atmosphere, EnvConditions &env, uint32_t stepsPerScatteringOrder, uint32_t stepsPerFrame, uint32_t blendFrames);
+			// cache and pack may be nullptr. LUTs are taken from the pack, then the cache, and
+			// precomputed if neither has them. The initial LUTs are complete once constructed.
+			Precomputer(Atmosphere &atmosphere, EnvConditions &env, uint32_t stepsPerScatteringOrder, uint32_t stepsPerFrame, uint32_t blendFrames, LutCache *cache = nullptr, const LutPack *pack = nullptr);
 			~Precomputer();
 			void Frame();
 			void RenderImgui();
@@ -29,30 +48,86 @@ namespace en {
 			VkDescriptorSetLayout GetEffectiveEnvSetLayout() const;
 			VkDescriptorSet GetEffectiveEnvSet(size_t indx) const;
 
+			// ratio of sum target 1 in the blend, 0 or 1 outside of blends.
+			float GetRatio() const;
+			// derived from the blend ratio, stable (0 or 1) outside of blends.
+			size_t GetSumTargetState() const;
+			// sum target to bind in place of target slot (0/1) in state: the slot itself while blending,
+			// otherwise the visible target, which the single-LUT shaders only sample through slot 0.
+			static size_t GetBoundSumTarget(size_t state, size_t slot);
+
+			// stages whose results are invalid if the environment changes from old to current,
+			// including all stages depending on them.
+			static PrecomputeStageFlags InvalidatedStages(const EnvConditions::Environment &old, const EnvConditions::Environment &current);
+
 		private:
-			class PrecomputeTask {
+			struct ImageAccess {
+				AtmosphereImage image;
+				bool write;
+			};
+
+			// one node of the precompute-graph, covers rows [offset, offset+count) of its stage.
+			class PrecomputeNode {
 				public:
-					PrecomputeTask(
-						Instantiater *instantiater,
+					PrecomputeNode(
+						PrecomputeStage stage,
 						uint32_t offset,
 						uint32_t count,
 						uint32_t sumTarget,
-						BufIter *currentBuffer,
 						VkDescriptorSet env);
 
-					bool Combine(PrecomputeTask &subsequent);
-					InstantiaterResult Instantiate();
+					bool Combine(const PrecomputeNode &subsequent);
+					void Record(Atmosphere &atmosphere, VkCommandBuffer buf) const;
+
+					// position in the graph, for combined nodes the first one.
+					size_t m_Index;
+					// indices of nodes (in the same graph) that have to complete before this one.
+					std::vector<size_t> m_Dependencies;
+					std::vector<ImageAccess> m_Accesses;
+					VkPipelineStageFlags m_PipelineStage;
 
-				private:
+					PrecomputeStage m_Stage;
 					uint32_t m_Offset;
 					uint32_t m_Count;
 					uint32_t m_SumTarget;
-					BufIter *m_CurrentBuffer;
-					Instantiater *m_Instantiater;
 					VkDescriptorSet m_EnvDescSet;
 			};
 
+			// one started precomputation, its nodes are recorded and submitted over several frames.
+			struct Precomputation {
+				std::vector<PrecomputeNode> m_Nodes;
+				// first node that wasn't submitted yet.
+				size_t m_NextNode;
+				// timeline value of the batch each submitted node was part of.
+				std::vector<uint64_t> m_NodeValues;
+				std::unique_ptr<vk::CommandPool> m_CommandPool;
+				size_t m_NextBuffer;
+				// snapshot used by the GPU, must not change while precomputing.
+				std::unique_ptr<EnvConditions> m_Env;
+				// environment for the sky once done, may differ from m_Env in parameters not used by the LUTs.
+				EnvConditions::Environment m_Environment;
+				uint32_t m_SumTarget;
+			};
+
+			// resources of a finished or cancelled precomputation, free to reuse once m_Value is reached.
+			struct RetiredPrecomputation {
+				std::unique_ptr<vk::CommandPool> m_CommandPool;
+				std::unique_ptr<EnvConditions> m_Env;
+				uint64_t m_Value;
+			};
+
+			// timestamps of one submitted batch, read back once the batch completed.
+			struct Measurement {
+				uint64_t m_Value;
+				uint32_t m_FirstQuery;
+				// stage and row count of each measured node.
+				std::vector<std::pair<PrecomputeStage, uint32_t>> m_Nodes;
+			};
+
+			Atmosphere &m_Atmosphere;
 			EnvConditions &m_Env;
+			LutCache *m_Cache;
+			const LutPack *m_Pack;
 
 			// two envs for sky, for sumTarget=0/1 respectively.
 			EnvConditions m_EffectiveSkyEnv[2];
@@ -63,46 +138,87 @@ namespace en {
 
 			uint32_t m_BlendFrames;
 
+			// split into single rows and fill each frame up to m_FrameBudget (ms)
+			// instead of using the fixed step counts.
+			bool m_Adaptive;
+			float m_FrameBudget;
+			// predicted cost of the last submitted batch.
+			float m_LastBatchCost;
+
+			VkQueryPool m_QueryPool;
+			float m_TimestampPeriod;
+			// two halves of the pool, alternate between batches.
+			uint32_t m_QueryHalf;
+			std::deque<Measurement> m_Measurements;
+			// measured ms per row (per node for unsplit stages), negative if not measured yet.
+			std::array<float, PRECOMPUTE_STAGE_COUNT> m_StageCost;
+
 			VkDescriptorSetLayout m_RatioDescriptorSetLayout;
 			VkDescriptorPool m_DescriptorPool;
 			VkDescriptorSet m_RatioDescriptorSet;
 			vk::Buffer m_SumImageRatioUBO;
 
+			// last value written to m_SumImageRatioUBO.
 			float m_SumImageRatio;
 
 			// stores the target image of the last enqued atmosphere-change.
 			size_t m_SumTarget;
-
-			// create and store functions here and pass references to PrecomputeTask.
-			Instantiater m_TransmittanceInstantiater;
-			Instantiater m_SingleScatteringInstantiater;
-			Instantiater m_MultiScatteringInstantiater;
-			Instantiater m_GatheringInstantiater;
-
-			std::list<std::vector<InstantiaterResult>> m_FrameTasks;
-			std::list<std::vector<InstantiaterResult>>::iterator m_CurrentFrameTask;
-
-			// store in list: erase without invalidating iterators.
-			std::list<CleanupTask> m_CleanupTasks;
-
-			bool m_AllTasksRun;
-
-			void _init(size_t sumTarget);
+			// environment of the last enqueued atmosphere-change, the LUTs in m_SumTarget are (or will be) computed from it.
+			EnvConditions::Environment m_EnqueuedEnv;
+
+			// signaled by every submitted batch, value increases by one per batch.
+			VkSemaphore m_Timeline;
+			// value of the last submitted batch, safe to wait for.
+			uint64_t m_SubmittedValue;
+
+			// precomputation currently submitted or waited for.
+			std::unique_ptr<Precomputation> m_Active;
+			// latest requested environment that wasn't started yet, newer requests replace it.
+			std::optional<EnvConditions::Environment> m_Pending;
+			std::vector<RetiredPrecomputation> m_Retired;
+
+			// blend steps and environment updates, run one per frame while no precomputation is active.
+			std::deque<FrameTask> m_FrameTasks;
+
+			// loads LUTs for env into sumTarget from pack or cache if possible, starts a precomputation otherwise.
+			// Returns true if the LUTs were loaded.
+			bool Begin(const EnvConditions::Environment &env, uint32_t sumTarget);
+			bool LoadCached(const EnvConditions::Environment &env, uint32_t sumTarget);
+			void StoreCached(const Precomputation &precomputation);
+			void Start(const EnvConditions::Environment &env, uint32_t sumTarget);
+			void Retire(std::unique_ptr<Precomputation> precomputation);
+			std::unique_ptr<vk::CommandPool> AcquireCommandPool(uint32_t bufferCount);
 			void Enqueue();
 
-			// all tasks that have to be run to complete precomputation.
-
 			void CreateDescriptor(float initial_value);
-			std::deque<PrecomputeTask> CreateTasks(
-				uint32_t stepsPerScatteringOrder,
+			void SetRatio(float ratio);
+			void CreateTimeline();
+			void CreateQueryPool();
+
+			// all nodes that have to be run to complete precomputation.
+			std::vector<PrecomputeNode> CreateNodes(
+				uint32_t scatteringSteps,
+				uint32_t gatheringSteps,
 				uint32_t sumTarget,
-				BufIter &currentBuffer,
 				VkDescriptorSet envDescSet);
-			void CreateFrameTasks(
-				std::deque<PrecomputeTask> tasks,
-				uint32_t stepsPerFrame,
-				std::list<CleanupTask>::iterator cleanupIter,
-				std::shared_ptr<EnvConditions> env,
-				uint32_t sumTarget);
+			static void ResolveDependencies(std::vector<PrecomputeNode> &nodes);
+
+			// submit the nodes for this frame.
+			void SubmitNext(Precomputation &precomputation);
+			float EstimateCost(const PrecomputeNode &node) const;
+			// firstQuery is negative if the batch isn't measured.
+			void RecordGroup(VkCommandBuffer buf, const std::vector<PrecomputeNode> &group, int64_t firstQuery);
+			void Submit(VkCommandBuffer buf, uint64_t waitValue, uint64_t signalValue);
+			void ReadMeasurements();
+			bool IsComplete(uint64_t value) const;
+			// waits on the timeline for every submitted batch, the device doesn't have to idle.
+			void WaitForSubmitted() const;
+			// Atmosphere::Allocate/ReleaseSumTarget, once no submitted batch uses the target anymore.
+			void AllocateSumTarget(uint32_t sumTarget);
+			void ReleaseSumTarget(uint32_t sumTarget);
+
+			void CreateBlendTasks();
+			// runs the CPU precomputation for the visible LUTs and compares, blocks until done.
+			void CompareWithCpu();
 	};
 };
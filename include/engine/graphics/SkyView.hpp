@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/Precomputer.hpp"
+#include "engine/graphics/Sun.hpp"
+#include "engine/graphics/vulkan/CommandPool.hpp"
+#include "engine/graphics/vulkan/Shader.hpp"
+#include "engine/graphics/Camera.hpp"
+#include <array>
+
+namespace en {
+
+// low-resolution latitude/longitude LUT of the sky around the camera, computed once per frame
+// and sampled by SkyRenderer, so the cost of the sky doesn't depend on the output resolution.
+class SkyView {
+	public:
+		SkyView(Camera &cam, Precomputer &precomp, Atmosphere &atm, Sun &sun);
+		~SkyView();
+
+		void Compute();
+		VkDescriptorSet GetSampleDescriptor() const;
+		VkDescriptorSetLayout GetSampleDescriptorLayout() const;
+
+	private:
+		Camera &m_Cam;
+		Precomputer &m_Precomp;
+		Atmosphere &m_Atmosphere;
+		Sun &m_Sun;
+
+		vk::Shader m_Shader;
+
+		vk::CommandPool m_CommandPool;
+		// one per sum target state (Precomputer::GetSumTargetState).
+		std::array<VkCommandBuffer, SUM_TARGET_STATE_COUNT> m_ComputeCommandBuffers;
+		// Atmosphere::GetDescriptorGeneration the compute buffers were recorded with.
+		uint64_t m_DescriptorGeneration;
+		VkCommandBuffer m_LayoutCommandBuffer;
+
+		VkDescriptorPool m_DescriptorPool;
+
+		LutFormat m_ImageFormat;
+
+		VkImage m_Image;
+		VkDeviceMemory m_ImageMemory;
+		VkImageView m_ImageView;
+
+		VkDescriptorSetLayout m_ImageDescriptorLayout;
+		VkDescriptorSetLayout m_SampleDescriptorLayout;
+		VkDescriptorSet m_ImageDescriptor;
+
+		VkSampler m_LinearSampler;
+		VkDescriptorSet m_SampleDescriptor;
+
+		VkPipelineLayout m_PipelineLayout;
+		// only samples one sum target, used outside of blends.
+		VkPipeline m_Pipeline;
+		VkPipeline m_BlendPipeline;
+
+		void CreateComputeImage(VkDevice device);
+		void CreateComputePipeline(VkDevice device);
+		void CreateDescriptors(VkDevice device);
+		void CreateCommandBuffers();
+		void RecordCommandBuffers();
+};
+
+};
@@ -27,6 +27,7 @@ namespace en {
 			void SetColor(glm::vec3 c);
 
 			float GetZenith() const;
+			const SunData &GetData() const;
 
 			VkDescriptorSetLayout GetDescriptorSetLayout() const;
 			VkDescriptorSet GetDescriptorSet() const;
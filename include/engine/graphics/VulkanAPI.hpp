@@ -36,6 +36,8 @@ namespace en
 		static VkPresentModeKHR GetPresentMode();
 
 		static VkPhysicalDevice GetPhysicalDevice();
+		static const VkPhysicalDeviceProperties& GetPhysicalDeviceProperties();
+		static const VkPhysicalDeviceFeatures& GetEnabledFeatures();
 		static uint32_t GetGraphicsQFI();
 		static uint32_t GetComputeQFI();
 		static uint32_t GetPresentQFI();
@@ -54,6 +56,7 @@ namespace en
 		static VkPresentModeKHR m_PresentMode;
 
 		static PhysicalDeviceInfo m_PhysicalDeviceInfo;
+		static VkPhysicalDeviceFeatures m_EnabledFeatures;
 		static uint32_t m_GraphicsQFI;
 		static uint32_t m_ComputeQFI;
 		static uint32_t m_PresentQFI;
@@ -1,24 +1,59 @@
 #pragma once
 
 #include "engine/graphics/Atmosphere.hpp"
+#include "engine/graphics/CloudShadow.hpp"
 #include "engine/graphics/Precomputer.hpp"
 #include "engine/graphics/Subpass.hpp"
 #include <engine/graphics/Common.hpp>
 #include <engine/graphics/vulkan/Shader.hpp>
 #include <engine/graphics/vulkan/CommandPool.hpp>
+#include <engine/graphics/vulkan/Buffer.hpp>
 #include <engine/graphics/Camera.hpp>
 #include <engine/objects/CloudData.hpp>
 #include <engine/graphics/Sun.hpp>
 #include <engine/objects/Wind.hpp>
+#include <array>
+
+// properly aligned, push constants of the passes rendering into the low-resolution targets.
+struct CloudTemporalParams {
+	// from positions relative to the current camera to the clip space of the previous frame.
+	glm::mat4 m_PrevProjView;
+	// movement of the clouds since the previous frame, added to reach their previous position.
+	glm::vec3 m_WindShift;
+	// weight of the history in pixels marched this frame.
+	float m_HistoryWeight;
+	// pixel marched in each block this frame.
+	glm::ivec2 m_PixelOffset;
+	// size of the accumulation, or of the marched target without accumulation.
+	glm::ivec2 m_TargetSize;
+	// 4 if temporal, 1 otherwise.
+	int32_t m_BlockSize;
+	int32_t m_Frame;
+	int32_t m_HasHistory;
+	int32_t _padding;
+};
+
+// counters of the raymarching, in the statistics buffer.
+struct CloudSampleStatistics {
+	uint32_t m_Enabled;
+	// rays that hit the sky box.
+	uint32_t m_Rays;
+	uint32_t m_DensitySamples;
+	// primary samples skipped in empty space.
+	uint32_t m_SkippedSamples;
+};
 
 namespace en
 {
 	class CloudRenderer : public Subpass
 	{
 	public:
-	CloudRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const Wind* wind, const CloudData* cloudData, const Atmosphere* atmosphere, const Precomputer* precomp);
+	CloudRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const Wind* wind, const CloudData* cloudData, const CloudShadow* cloudShadow, const Atmosphere* atmosphere, const Precomputer* precomp);
 
+		// renders the clouds into the low-resolution target if CloudData::GetResolutionDivisor is above 1
+		// or CloudData::IsTemporal. Submitted before the frame, the subpass upsamples the result then.
 		void Render(VkQueue queue);
+		void RenderImgui();
 		void Destroy();
 
 		void Resize(uint32_t width, uint32_t height);
@@ -45,6 +80,7 @@ namespace en
 		const Sun* m_Sun;
 		const Wind* m_Wind;
 		const CloudData* m_CloudData;
+		const CloudShadow* m_CloudShadow;
 		const Atmosphere* m_Atmosphere;
 		const Precomputer* m_Precomputer;
 
@@ -58,10 +94,94 @@ namespace en
 		size_t m_Subpass;
 		vk::Shader m_VertShader;
 		vk::Shader m_FragShader;
+		vk::Shader m_LowResFragShader;
+		vk::Shader m_UpsampleFragShader;
+		vk::Shader m_ResolveFragShader;
 		VkPipelineLayout m_PipelineLayout;
+		// only samples one sum target, used outside of blends.
 		VkPipeline m_Pipeline;
+		VkPipeline m_BlendPipeline;
+
+		// color and transmittance, distance to the front of the cloud.
+		struct Target
+		{
+			std::array<VkImage, 2> m_Images;
+			std::array<VkDeviceMemory, 2> m_ImageMemory;
+			std::array<VkImageView, 2> m_ImageViews;
+			VkFramebuffer m_Framebuffer;
+			// allocated once, rewritten when the images are recreated.
+			VkDescriptorSet m_SampleDescriptor;
+			// 0 without images.
+			uint32_t m_Width;
+			uint32_t m_Height;
+		};
+
+		// low-resolution clouds, rendered in their own render pass before the frame.
+		// Only one set of targets, frames don't overlap (yet).
+		vk::CommandPool m_CommandPool;
+		VkCommandBuffer m_LowResCommandBuffer;
+		VkRenderPass m_LowResRenderPass;
+		// raymarched, if temporal one texel per block of the accumulation.
+		Target m_LowResTarget;
+		VkPipeline m_LowResPipeline;
+		VkPipeline m_LowResBlendPipeline;
+
+		// temporal accumulation, written alternately, the other one is the history.
+		std::array<Target, 2> m_HistoryTargets;
+		size_t m_HistoryIndex;
+		bool m_HasHistory;
+		uint32_t m_Frame;
+		glm::mat4 m_LastRelativeProjView;
+		glm::vec3 m_LastCamPos;
+		glm::vec2 m_LastWindOffset;
+		VkPipelineLayout m_ResolvePipelineLayout;
+		VkPipeline m_ResolvePipeline;
+
+		// read by the subpass, VK_NULL_HANDLE if it raymarches at full resolution.
+		VkDescriptorSet m_CompositeDescriptor;
+		VkSampler m_LowResSampler;
+		VkDescriptorPool m_LowResDescriptorPool;
+		VkDescriptorSetLayout m_LowResDescriptorSetLayout;
+		// march pipelines of cloud_upsample.frag, it marches again where the geometry cuts the low-resolution clouds.
+		VkPipeline m_UpsamplePipeline;
+		VkPipeline m_UpsampleBlendPipeline;
+
+		// written by the raymarching if m_StatisticsEnabled, read back the next frame.
+		bool m_StatisticsSupported;
+		bool m_StatisticsEnabled;
+		CloudSampleStatistics m_Statistics;
+		vk::Buffer m_StatisticsBuffer;
+		VkDescriptorPool m_StatisticsDescriptorPool;
+		VkDescriptorSetLayout m_StatisticsDescriptorSetLayout;
+		VkDescriptorSet m_StatisticsDescriptorSet;
 
 		void CreateRenderPass(VkDevice device);
 		void CreatePipelineLayout(VkDevice device);
+		void CreateLowResDescriptors(VkDevice device);
+		void CreateStatisticsDescriptors(VkDevice device);
+		void CreateTarget(VkDevice device, Target &target, uint32_t width, uint32_t height);
+		void DestroyTarget(VkDevice device, Target &target);
+		// begins the low-resolution render pass on target, with viewport and scissor covering it.
+		void BeginTarget(const Target &target);
+		// raymarching pipelines for one and both sum targets.
+		void CreateMarchPipelines(
+			VkShaderModule fragModule,
+			VkRenderPass renderpass,
+			size_t subpass,
+			uint32_t colorAttachmentCount,
+			bool blend,
+			VkPipeline &pipeline,
+			VkPipeline &blendPipeline);
+		// full-screen quad of cloud.vert, blend composites premultiplied colors onto the frame.
+		VkPipeline CreateQuadPipeline(
+			const VkPipelineShaderStageCreateInfo &fragStageCreateInfo,
+			VkPipelineLayout layout,
+			VkRenderPass renderpass,
+			size_t subpass,
+			uint32_t colorAttachmentCount,
+			bool blend);
+		// set 3 (geometry depth) is only read at full resolution, set 14 (low-resolution clouds) is
+		// appended for the upsample.
+		std::vector<VkDescriptorSet> GetMarchDescriptorSets(VkDescriptorSet geometryDepthSet) const;
 	};
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/graphics/CloudShadow.hpp"
 #include "engine/graphics/GroundLighting.hpp"
 #include "engine/graphics/vulkan/Swapchain.hpp"
 #include <engine/graphics/Common.hpp>
@@ -14,7 +15,7 @@ namespace en
 {
 	class SimpleModelRenderer : public Subpass {
 	public:
-		SimpleModelRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const GroundLighting &gl, size_t max_concurrent);
+		SimpleModelRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const GroundLighting &gl, const CloudShadow &cloudShadow, size_t max_concurrent);
 
 		void Render(VkQueue queue, size_t imageIndx) const;
 		void Destroy();
@@ -41,6 +42,7 @@ namespace en
 		const Camera* m_Camera;
 		const Sun* m_Sun;
 		const GroundLighting &m_GroundLighting;
+		const CloudShadow &m_CloudShadow;
 
 		VkRenderPass m_RenderPass;
 		uint32_t m_Subpass;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "engine/graphics/AerialPerspective.hpp"
+#include "engine/graphics/SkyView.hpp"
 #include "engine/graphics/Subpass.hpp"
 #include "engine/graphics/Sun.hpp"
 #include "engine/graphics/Atmosphere.hpp"
@@ -27,7 +28,8 @@ namespace en
 			vk::Swapchain &swapchain,
 			Atmosphere &atmosphere,
 			Precomputer &precomp,
-			AerialPerspective &aerial );
+			AerialPerspective &aerial,
+			SkyView &skyView );
 
 		void Precompute() const;
 		void Destroy();
@@ -56,7 +58,9 @@ namespace en
 		vk::Shader m_FragShader;
 
 		VkPipelineLayout m_PipelineLayout;
+		// only samples one sum target, used outside of blends.
 		VkPipeline m_GraphicsPipeline;
+		VkPipeline m_BlendGraphicsPipeline;
 
 		vk::CommandPool m_GraphicsCommandPool;
 		std::vector<VkCommandBuffer> m_GraphicsCommandBuffers;
@@ -64,6 +68,7 @@ namespace en
 		Atmosphere &m_Atmosphere;
 		Precomputer &m_Precomp;
 		AerialPerspective &m_Aerial;
+		SkyView &m_SkyView;
 
 		void CreatePipelineLayout(VkDevice device);
 		void CreateCommandBuffers();
@@ -14,6 +14,8 @@ namespace en::vk
 
 		void AllocateBuffers(uint32_t bufferCount, VkCommandBufferLevel level);
 		void FreeBuffers();
+		// resets all buffers to the initial state, keeps them allocated.
+		void Reset();
 
 		uint32_t GetBufferCount() const;
 		const std::vector<VkCommandBuffer>& GetBuffers() const;
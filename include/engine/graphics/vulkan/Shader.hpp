@@ -18,7 +18,8 @@ namespace en::vk
 
 		Shader();
 		Shader(const std::vector<char>& code);
-		Shader(const std::string& fileName, bool compiled);
+		// defines are passed to glslc (-D), each variant is compiled into its own file.
+		Shader(const std::string& fileName, bool compiled, const std::vector<std::string>& defines = {});
 
 		void Destroy();
 
@@ -4,6 +4,7 @@
 #include <engine/graphics/vulkan/Texture2D.hpp>
 #include <engine/graphics/vulkan/Buffer.hpp>
 #include <glm/glm.hpp>
+#include <array>
 
 namespace en
 {
@@ -32,6 +33,8 @@ namespace en
 		float jitterStrength;
 		float sigmaS;
 		float sigmaE;
+		// 0: analytic, 1: sphere traced, 2: difference of both (see cloud_march.glsl).
+		int32_t boundsMode;
 
 		bool operator==(const CloudUniformData& other);
 		bool operator!=(const CloudUniformData& other);
@@ -51,8 +54,17 @@ namespace en
 		void RenderImGui();
 
 		VkDescriptorSet GetDescriptorSet() const;
+		// as last written to the uniform buffer.
+		const CloudUniformData& GetUniformData() const;
 		const CloudSampleCounts& GetSampleCounts() const;
 		bool HaveSampleCountsChanged() const;
+		// 1, 2 or 4, the clouds are rendered at 1/divisor of the frame size.
+		uint32_t GetResolutionDivisor() const;
+		// only one pixel per 4x4 block is raymarched per frame, the others are reprojected.
+		bool IsTemporal() const;
+		// weight of the reprojected clouds in the raymarched pixels.
+		float GetHistoryWeight() const;
+		const glm::vec3& GetSkySize() const;
 
 	private:
 		static VkDescriptorSetLayout m_DescriptorSetLayout;
@@ -61,11 +73,20 @@ namespace en
 		vk::Texture3D m_CloudShapeTexture;
 		vk::Texture3D m_CloudDetailTexture;
 		vk::Texture2D m_WeatherTexture;
+		// per block of weather texels the maximum coverage and the lowest and highest extent of the
+		// cloud layer, lets the raymarching skip empty space.
+		vk::Texture2D m_WeatherOccupancyTexture;
 		CloudUniformData m_UniformData;
 		vk::Buffer* m_UniformBuffer;
 		VkDescriptorSet m_DescriptorSet;
 
 		CloudSampleCounts m_SampleCounts;
 		bool m_SampleCountsChanged;
+		// log2 of the resolution divisor, index into the ImGui combo.
+		int m_Resolution;
+		bool m_Temporal;
+		float m_HistoryWeight;
+
+		CloudData(const std::array<std::vector<std::vector<float>>, 4>& weather);
 	};
 }
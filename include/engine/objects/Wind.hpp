@@ -26,6 +26,8 @@ namespace en
 		void Update(float deltaTime);
 
 		VkDescriptorSet GetDescriptorSet() const;
+		// added to the weather texture coordinates.
+		const glm::vec2& GetOffset() const;
 
 	private:
 		static VkDescriptorSetLayout m_DescriptorSetLayout;
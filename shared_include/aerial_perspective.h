@@ -1,10 +1,29 @@
-#define AP_X 32
-#define AP_Y 32
+// froxels of the medium quality tier, the ones in use are chosen at runtime (en::AtmosphereQuality)
+// and passed to the shaders as specialization constants.
+#define AP_X_DEFAULT 32
+#define AP_Y_DEFAULT 32
 // 16 may be insufficient for out-of-atmosphere -> down, 32 looks well.
-#define AP_Z 16
+#define AP_Z_DEFAULT 16
+#define AP_X_ID 17
+#define AP_Y_ID 18
+#define AP_Z_ID 19
+#ifndef __cplusplus
+layout (constant_id = AP_X_ID) const int AP_X = AP_X_DEFAULT;
+layout (constant_id = AP_Y_ID) const int AP_Y = AP_Y_DEFAULT;
+layout (constant_id = AP_Z_ID) const int AP_Z = AP_Z_DEFAULT;
+#endif
 
 #define AP_STEPS_PER_CELL 10
 
+// aerial_perspective.comp runs one invocation per froxel, a workgroup holds AP_GROUP_X*AP_GROUP_Y
+// columns (at most 8x8) of AP_Z froxels. The column count is reduced at runtime until the group fits
+// (en::AerialPerspective), AP_GROUP_Z is always AP_Z.
+#define AP_GROUP_MAX_COLUMNS 8
+#define AP_GROUP_MAX_INVOCATIONS 256
+#define AP_GROUP_X_ID 23
+#define AP_GROUP_Y_ID 24
+#define AP_GROUP_Z_ID 25
+
 #define AP_SETS_IMAGES 0
 #define AP_TRANSMITTANCE_BINDING 0
 #define AP_SCATTERING_BINDING 1
@@ -18,3 +37,8 @@
 #define AP_SETS_GATHERING_SAMPLER0 7
 #define AP_SETS_GATHERING_SAMPLER1 8
 #define AP_SETS_SUN 9
+// amortized update: frame parameters and the previous volume (en::AerialPerspective).
+#define AP_SETS_REPROJECTION 10
+#define AP_REPROJECTION_FRAME_BINDING 0
+#define AP_REPROJECTION_TRANSMITTANCE_BINDING 1
+#define AP_REPROJECTION_SCATTERING_BINDING 2
@@ -1,27 +1,48 @@
+#include <algorithm>
 #include <cassert>
 #include <set>
 #include <vulkan/vulkan_core.h>
 #include "engine/graphics/AerialPerspective.hpp"
 #include "engine/graphics/VulkanAPI.hpp"
+#include "engine/util/Log.hpp"
+#include <glm/ext/matrix_transform.hpp>
+#include <imgui.h>
 
 #include "aerial_perspective.h"
 
 // one sampler+image store descriptor per image layer.
 #define SAMPLE_DESC_COUNT IMAGE_COUNT
 #define IMAGE_DESC_COUNT IMAGE_COUNT
+// the previous volume is sampled in compute.
+#define HISTORY_DESC_COUNT IMAGE_COUNT
 #define DESC_COUNT (SAMPLE_DESC_COUNT + IMAGE_DESC_COUNT)
 
 namespace en {
 
 AerialPerspective::AerialPerspective(Camera &cam, Precomputer &precomp, Atmosphere &atm, Sun &sun) :
-	m_CommandPool(0, VulkanAPI::GetComputeQFI()),
+	// the compute buffer is recorded again when the atmosphere descriptor sets change.
+	m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetComputeQFI()),
 	m_Shader("sky/aerial_perspective.comp", false),
 	m_Cam{cam},
 	m_Precomp{precomp},
 	m_Atmosphere{atm},
-	m_Sun{sun} {
+	m_Sun{sun},
+	m_Amortized{false},
+	m_RowsPerFrame{1},
+	m_NextRow{0},
+	m_StaleRows{0},
+	m_LastRows{0},
+	m_HasInputs{false},
+	m_FrameUBO(
+		sizeof(APFrameParams),
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		{}) {
 	
 	VkDevice device = VulkanAPI::GetDevice();
+	SelectGroupSize();
+	CreateQueryPool(device);
 	// Need command buffer for image transition in CreateComputeImages.
 	CreateCommandBuffers();
 	CreateComputeImages(device);
@@ -35,7 +56,11 @@ AerialPerspective::~AerialPerspective() {
 
 	m_CommandPool.Destroy();
 
-	for (int i = 0; i != IMAGE_COUNT; ++i) {
+	if (m_QueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, m_QueryPool, nullptr);
+	m_FrameUBO.Destroy();
+
+	for (int i = 0; i != 2*IMAGE_COUNT; ++i) {
 		vkFreeMemory(device, m_APImagesMemory[i], nullptr);
 		vkDestroyImage(device, m_APImages[i], nullptr);
 		vkDestroyImageView(device, m_APImageViews[i], nullptr);
@@ -45,37 +70,88 @@ AerialPerspective::~AerialPerspective() {
 	vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(device, m_ImageDescriptorLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, m_SampleDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_ReprojectionDescriptorLayout, nullptr);
 
 	vkDestroyPipelineLayout(device, m_APPipelineLayout, nullptr);
 	vkDestroyPipeline(device, m_APPipeline, nullptr);
+	vkDestroyPipeline(device, m_APBlendPipeline, nullptr);
 
 	m_Shader.Destroy();
 }
 
+void AerialPerspective::SelectGroupSize() {
+	const VkPhysicalDeviceLimits &limits = VulkanAPI::GetPhysicalDeviceProperties().limits;
+	uint32_t apZ = m_Atmosphere.GetResolution().m_ApZ;
+	uint32_t maxInvocations = std::min<uint32_t>(AP_GROUP_MAX_INVOCATIONS, limits.maxComputeWorkGroupInvocations);
+	// the froxels of a column are summed up in one workgroup.
+	assert(apZ <= maxInvocations && apZ <= limits.maxComputeWorkGroupSize[2]);
+
+	m_GroupX = AP_GROUP_MAX_COLUMNS;
+	m_GroupY = AP_GROUP_MAX_COLUMNS;
+	while (m_GroupX*m_GroupY*apZ > maxInvocations) {
+		if (m_GroupX >= m_GroupY)
+			m_GroupX /= 2;
+		else
+			m_GroupY /= 2;
+	}
+	Log::Info("Aerial perspective workgroup " + std::to_string(m_GroupX) + "x" + std::to_string(m_GroupY) + "x" + std::to_string(apZ));
+}
+
+void AerialPerspective::CreateQueryPool(VkDevice device) {
+	const VkPhysicalDeviceLimits &limits = VulkanAPI::GetPhysicalDeviceProperties().limits;
+	m_Measuring = false;
+	m_ComputeTime = -1;
+
+	if (!limits.timestampComputeAndGraphics) {
+		m_QueryPool = VK_NULL_HANDLE;
+		return;
+	}
+	m_TimestampPeriod = limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo createInfo;
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.pNext = nullptr;
+	createInfo.flags = 0;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = 2;
+	createInfo.pipelineStatistics = 0;
+
+	ASSERT_VULKAN(vkCreateQueryPool(device, &createInfo, nullptr, &m_QueryPool));
+}
+
 void AerialPerspective::CreateComputeImages(VkDevice device) {
 	std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()}; 
 	// vector for contiguous memory.
 	std::vector<uint32_t> qvec{queues.begin(), queues.end()};
 
-	m_ComputeImageFormat = VK_FORMAT_R16G16B16A16_SNORM;
+	// sampled in aerial_perspective.frag, written in aerial_perspective.comp.
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+	// the froxels are coarse and interpolated, that error is well above the rounding of the packed formats.
+	m_ImageFormats[AP_TRANSMITTANCE_BINDING] = SelectLutFormat(
+		{LutFormat::E5B9G9R9Ufloat, LutFormat::B10G11R11Ufloat, LutFormat::Rgba16Snorm},
+		{3, 1.0f/128.0f},
+		features);
+	// rayleigh rgb and mie r, needs all four channels.
+	m_ImageFormats[AP_SCATTERING_BINDING] = LutFormat::Rgba16Snorm;
+	Log::Info(std::string("Aerial perspective transmittance format ") + GetLutFormatInfo(m_ImageFormats[AP_TRANSMITTANCE_BINDING]).m_Name);
 	// TODO: do better testing.
 	assert(VulkanAPI::IsFormatSupported(
-		m_ComputeImageFormat,
+		GetLutFormatInfo(m_ImageFormats[AP_SCATTERING_BINDING]).m_VkFormat,
 		VK_IMAGE_TILING_OPTIMAL,
 		0));
 	
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_3D;
-	imageInfo.extent.width = AP_X;
-	imageInfo.extent.height = AP_Y;
-	imageInfo.extent.depth = AP_Z;
+	imageInfo.extent.width = m_Atmosphere.GetResolution().m_ApX;
+	imageInfo.extent.height = m_Atmosphere.GetResolution().m_ApY;
+	imageInfo.extent.depth = m_Atmosphere.GetResolution().m_ApZ;
 	imageInfo.mipLevels = 1;
 	imageInfo.arrayLayers = 1;
-	imageInfo.format = m_ComputeImageFormat;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	// the current volume is copied into the previous one before each update.
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	// will only be accessed by one queue at a time (for now).
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -86,7 +162,6 @@ void AerialPerspective::CreateComputeImages(VkDevice device) {
 	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewCreateInfo.pNext = nullptr;
 	imageViewCreateInfo.flags = 0;
-	imageViewCreateInfo.format = m_ComputeImageFormat;
 	imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -120,7 +195,8 @@ void AerialPerspective::CreateComputeImages(VkDevice device) {
 		.pInheritanceInfo = nullptr
 	};
 
-	for (int i = 0; i != IMAGE_COUNT; ++i) {
+	for (int i = 0; i != 2*IMAGE_COUNT; ++i) {
+		imageInfo.format = GetLutFormatInfo(m_ImageFormats[i % IMAGE_COUNT]).m_VkFormat;
 		ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &m_APImages[i]));
 
 		VkMemoryRequirements memReqs;
@@ -137,6 +213,7 @@ void AerialPerspective::CreateComputeImages(VkDevice device) {
 		ASSERT_VULKAN(vkBindImageMemory(device, m_APImages[i], m_APImagesMemory[i], 0));
 
 		imageViewCreateInfo.image = m_APImages[i];
+		imageViewCreateInfo.format = imageInfo.format;
 		ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_APImageViews[i]));
 
 		imageMemoryBarrier.image = m_APImages[i];
@@ -179,6 +256,13 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 			// write to texture in compute.
 			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 			.descriptorCount = IMAGE_DESC_COUNT
+		}, {
+			// previous volume, read in compute.
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = HISTORY_DESC_COUNT
+		}, {
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1
 		}
 	};
 
@@ -229,6 +313,22 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 	imageBindings[1].binding = 1;
 	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_ImageDescriptorLayout));
 
+	VkDescriptorSetLayoutBinding reprojectionBindings[1+HISTORY_DESC_COUNT];
+	std::fill_n(reprojectionBindings, 1+HISTORY_DESC_COUNT, VkDescriptorSetLayoutBinding{
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr,
+	});
+	reprojectionBindings[0].binding = AP_REPROJECTION_FRAME_BINDING;
+	reprojectionBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	reprojectionBindings[1].binding = AP_REPROJECTION_TRANSMITTANCE_BINDING;
+	reprojectionBindings[2].binding = AP_REPROJECTION_SCATTERING_BINDING;
+
+	layoutCreateInfo.bindingCount = 1+HISTORY_DESC_COUNT;
+	layoutCreateInfo.pBindings = reprojectionBindings;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_ReprojectionDescriptorLayout));
+
 	VkSamplerCreateInfo sampler;
 	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	sampler.pNext = nullptr;
@@ -251,10 +351,11 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 	sampler.flags = 0;
 	ASSERT_VULKAN(vkCreateSampler(device, &sampler, nullptr, &m_LinearSampler));
 
-	// each image has one sampler and one imageStoreDescriptor.
-	std::vector<VkDescriptorSetLayout> allocLayouts(2);
+	// each image has one sampler and one imageStoreDescriptor, the previous volume one sampler.
+	std::vector<VkDescriptorSetLayout> allocLayouts(3);
 	std::fill_n(allocLayouts.begin(), 1, m_SampleDescriptorLayout);
 	std::fill_n(allocLayouts.begin()+1, 1, m_ImageDescriptorLayout);
+	std::fill_n(allocLayouts.begin()+2, 1, m_ReprojectionDescriptorLayout);
 
 	VkDescriptorSetAllocateInfo allocInfo {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -264,14 +365,15 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 		.pSetLayouts = allocLayouts.data()
 	};
 
-	VkDescriptorSet allocTarget[2];
+	VkDescriptorSet allocTarget[3];
 	ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, allocTarget));
 
 	m_APImageSampleDescriptor = allocTarget[0];
 	m_APImageDescriptor = allocTarget[1];
+	m_ReprojectionDescriptor = allocTarget[2];
 
-	std::vector<VkWriteDescriptorSet> writeDescSets(IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT);
-	std::fill_n(writeDescSets.begin(), IMAGE_DESC_COUNT + SAMPLE_DESC_COUNT, VkWriteDescriptorSet{
+	std::vector<VkWriteDescriptorSet> writeDescSets(IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT+HISTORY_DESC_COUNT+1);
+	std::fill_n(writeDescSets.begin(), writeDescSets.size(), VkWriteDescriptorSet{
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.pNext = nullptr,
 		.dstArrayElement = 0,
@@ -280,8 +382,8 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 		.pTexelBufferView = nullptr
 	});
 
-	std::vector<VkDescriptorImageInfo> texInfo(IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT);
-	std::fill_n(texInfo.begin(), IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT, VkDescriptorImageInfo{
+	std::vector<VkDescriptorImageInfo> texInfo(IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT+HISTORY_DESC_COUNT);
+	std::fill_n(texInfo.begin(), texInfo.size(), VkDescriptorImageInfo{
 		.sampler = m_LinearSampler,
 		.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
 	});
@@ -311,20 +413,43 @@ void AerialPerspective::CreateDescriptors(VkDevice device) {
 	writeDescSets[3].dstBinding = AP_SCATTERING_BINDING;
 	writeDescSets[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
+	texInfo[4].imageView = m_APImageViews[IMAGE_COUNT+AP_TRANSMITTANCE_BINDING];
+	writeDescSets[4].pImageInfo = &texInfo[4];
+	writeDescSets[4].dstSet = m_ReprojectionDescriptor;
+	writeDescSets[4].dstBinding = AP_REPROJECTION_TRANSMITTANCE_BINDING;
+	writeDescSets[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	texInfo[5].imageView = m_APImageViews[IMAGE_COUNT+AP_SCATTERING_BINDING];
+	writeDescSets[5].pImageInfo = &texInfo[5];
+	writeDescSets[5].dstSet = m_ReprojectionDescriptor;
+	writeDescSets[5].dstBinding = AP_REPROJECTION_SCATTERING_BINDING;
+	writeDescSets[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	VkDescriptorBufferInfo frameInfo {
+		.buffer = m_FrameUBO.GetVulkanHandle(),
+		.offset = 0,
+		.range = sizeof(APFrameParams)
+	};
+	writeDescSets[6].pImageInfo = nullptr;
+	writeDescSets[6].pBufferInfo = &frameInfo;
+	writeDescSets[6].dstSet = m_ReprojectionDescriptor;
+	writeDescSets[6].dstBinding = AP_REPROJECTION_FRAME_BINDING;
+	writeDescSets[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
 	vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
 }
 
 void AerialPerspective::CreateCommandBuffers() {
-	// one buffer for compute, one for transitioning each image.
-	m_CommandPool.AllocateBuffers(1+IMAGE_COUNT, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	// two buffers for compute per sum target state, one for transitioning each image.
+	m_CommandPool.AllocateBuffers(2*SUM_TARGET_STATE_COUNT+m_LayoutCommandBuffer.size(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	std::vector tmp(m_CommandPool.GetBuffers());
-	m_ComputeCommandBuffer = tmp[0];
-	m_LayoutCommandBuffer[0] = tmp[1];
-	m_LayoutCommandBuffer[1] = tmp[2];
+	std::copy_n(tmp.begin(), SUM_TARGET_STATE_COUNT, m_ComputeCommandBuffers[0].begin());
+	std::copy_n(tmp.begin()+SUM_TARGET_STATE_COUNT, SUM_TARGET_STATE_COUNT, m_ComputeCommandBuffers[1].begin());
+	std::copy_n(tmp.begin()+2*SUM_TARGET_STATE_COUNT, m_LayoutCommandBuffer.size(), m_LayoutCommandBuffer.begin());
 }
 
 void AerialPerspective::CreateComputePipeline(VkDevice device) {
-	std::vector<VkDescriptorSetLayout> apLayouts(10);
+	std::vector<VkDescriptorSetLayout> apLayouts(11);
 	apLayouts[AP_SETS_IMAGES] = m_ImageDescriptorLayout;
 	apLayouts[AP_SETS_CAM] = m_Cam.GetDescriptorSetLayout();
 	apLayouts[AP_SETS_SUN] = m_Sun.GetDescriptorSetLayout();
@@ -335,6 +460,7 @@ void AerialPerspective::CreateComputePipeline(VkDevice device) {
 	apLayouts[AP_SETS_TRANSMITTANCE_SAMPLER1] = m_Atmosphere.GetTransmittanceSampleDescriptorLayout();
 	apLayouts[AP_SETS_GATHERING_SAMPLER0] = m_Atmosphere.GetGatheringSampleDescriptorLayout();
 	apLayouts[AP_SETS_GATHERING_SAMPLER1] = m_Atmosphere.GetGatheringSampleDescriptorLayout();
+	apLayouts[AP_SETS_REPROJECTION] = m_ReprojectionDescriptorLayout;
 
 	VkPipelineLayoutCreateInfo apLayoutCreateInfo {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -352,7 +478,26 @@ void AerialPerspective::CreateComputePipeline(VkDevice device) {
 	compStageCreateInfo.flags = 0;
 	compStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	compStageCreateInfo.pName = "main";
-	compStageCreateInfo.pSpecializationInfo = nullptr;
+
+	// the LUT resolutions and LUT_BLEND, then the workgroup size.
+	struct SpecData {
+		LutBlendSpecialization lut;
+		uint32_t groupX;
+		uint32_t groupY;
+		uint32_t groupZ;
+	};
+	std::vector<VkSpecializationMapEntry> specEntries = LutBlendSpecialization::GetSpecializationMapEntries(offsetof(SpecData, lut));
+	specEntries.push_back({AP_GROUP_X_ID, offsetof(SpecData, groupX), sizeof(uint32_t)});
+	specEntries.push_back({AP_GROUP_Y_ID, offsetof(SpecData, groupY), sizeof(uint32_t)});
+	specEntries.push_back({AP_GROUP_Z_ID, offsetof(SpecData, groupZ), sizeof(uint32_t)});
+	SpecData specData {{m_Atmosphere.GetResolution(), VK_FALSE}, m_GroupX, m_GroupY, m_Atmosphere.GetResolution().m_ApZ};
+
+	VkSpecializationInfo specInfo;
+	specInfo.mapEntryCount = specEntries.size();
+	specInfo.pMapEntries = specEntries.data();
+	specInfo.dataSize = sizeof(SpecData);
+	specInfo.pData = &specData;
+	compStageCreateInfo.pSpecializationInfo = &specInfo;
 
 	VkComputePipelineCreateInfo pipeline;
 	pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -364,40 +509,138 @@ void AerialPerspective::CreateComputePipeline(VkDevice device) {
 	pipeline.layout = m_APPipelineLayout;
 
 	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_APPipeline));
+
+	// same pipeline, but mixing both sum targets.
+	specData.lut.m_Blend = VK_TRUE;
+	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_APBlendPipeline));
 }
 
 void AerialPerspective::RecordCommandBuffers() {
+	m_DescriptorGeneration = m_Atmosphere.GetDescriptorGeneration();
+	for (size_t state = 0; state != SUM_TARGET_STATE_COUNT; ++state) {
+		RecordCommandBuffer(m_ComputeCommandBuffers[0][state], state, false);
+		RecordCommandBuffer(m_ComputeCommandBuffers[1][state], state, true);
+	}
+}
+
+void AerialPerspective::RecordCommandBuffer(VkCommandBuffer buf, size_t state, bool partial) {
 	VkCommandBufferBeginInfo beginInfo;
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.pNext = nullptr;
 	beginInfo.flags = 0;
 	beginInfo.pInheritanceInfo = nullptr;
 
-	ASSERT_VULKAN(vkBeginCommandBuffer(m_ComputeCommandBuffer, &beginInfo));
+	ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
 
-	vkCmdBindPipeline(m_ComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_APPipeline);
+	// outside of blends the visible sum target is bound as target 0.
+	size_t target0 = Precomputer::GetBoundSumTarget(state, 0);
+	size_t target1 = Precomputer::GetBoundSumTarget(state, 1);
+	vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+		state == SUM_TARGET_STATE_BLEND ? m_APBlendPipeline : m_APPipeline);
 
-	std::vector<VkDescriptorSet> sets(10);
+	std::vector<VkDescriptorSet> sets(11);
 	sets[AP_SETS_IMAGES] = m_APImageDescriptor;
 	sets[AP_SETS_CAM] = m_Cam.GetDescriptorSet();
 	sets[AP_SETS_SUN] = m_Sun.GetDescriptorSet();
 	sets[AP_SETS_RATIO] = m_Precomp.GetRatioDescriptorSet();
-	sets[AP_SETS_ENV0] = m_Precomp.GetEffectiveEnv(0).GetDescriptorSet();
-	sets[AP_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSet();
-	sets[AP_SETS_TRANSMITTANCE_SAMPLER0] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(0);
-	sets[AP_SETS_TRANSMITTANCE_SAMPLER1] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(1);
-	sets[AP_SETS_GATHERING_SAMPLER0] = m_Atmosphere.GetGatheringSampleDescriptorSet(0);
-	sets[AP_SETS_GATHERING_SAMPLER1] = m_Atmosphere.GetGatheringSampleDescriptorSet(1);
+	sets[AP_SETS_ENV0] = m_Precomp.GetEffectiveEnv(target0).GetDescriptorSet();
+	sets[AP_SETS_ENV1] = m_Precomp.GetEffectiveEnv(target1).GetDescriptorSet();
+	sets[AP_SETS_TRANSMITTANCE_SAMPLER0] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(target0);
+	sets[AP_SETS_TRANSMITTANCE_SAMPLER1] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(target1);
+	sets[AP_SETS_GATHERING_SAMPLER0] = m_Atmosphere.GetGatheringSampleDescriptorSet(target0);
+	sets[AP_SETS_GATHERING_SAMPLER1] = m_Atmosphere.GetGatheringSampleDescriptorSet(target1);
+	sets[AP_SETS_REPROJECTION] = m_ReprojectionDescriptor;
+
+	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_APPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+
+	// rows that aren't integrated are reprojected from the previous volume, not needed if all rows are.
+	if (partial)
+		RecordHistoryCopy(buf);
+
+	// only the dispatch is measured.
+	if (m_QueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(buf, m_QueryPool, 0, 2);
+		vkCmdWriteTimestamp(buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, 0);
+	}
 
-	vkCmdBindDescriptorSets(m_ComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_APPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+	// a workgroup covers whole columns, so one group along Z.
+	const AtmosphereResolution &res = m_Atmosphere.GetResolution();
+	vkCmdDispatch(buf, (res.m_ApX+m_GroupX-1)/m_GroupX, (res.m_ApY+m_GroupY-1)/m_GroupY, 1);
 
-	// each shader walks along Z, so only 1 instance per (x,y) is needed.
-	vkCmdDispatch(m_ComputeCommandBuffer, AP_X, AP_Y, 1);
+	if (m_QueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, 1);
 
-	vkEndCommandBuffer(m_ComputeCommandBuffer);
+	vkEndCommandBuffer(buf);
+}
+
+void AerialPerspective::RecordHistoryCopy(VkCommandBuffer buf) {
+	std::array<VkImageMemoryBarrier, 2*IMAGE_COUNT> barriers;
+	for (int i = 0; i != 2*IMAGE_COUNT; ++i)
+		barriers[i] = VkImageMemoryBarrier {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			// written by the last dispatch, or read by it.
+			.srcAccessMask = i < IMAGE_COUNT ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT,
+			.dstAccessMask = i < IMAGE_COUNT ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = m_APImages[i],
+			.subresourceRange = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			}
+		};
+	vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+	const AtmosphereResolution &res = m_Atmosphere.GetResolution();
+	VkImageCopy region {
+		.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.srcOffset = {0, 0, 0},
+		.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.dstOffset = {0, 0, 0},
+		.extent = {res.m_ApX, res.m_ApY, res.m_ApZ}
+	};
+	for (int i = 0; i != IMAGE_COUNT; ++i)
+		vkCmdCopyImage(buf, m_APImages[i], VK_IMAGE_LAYOUT_GENERAL, m_APImages[IMAGE_COUNT+i], VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+	for (int i = 0; i != 2*IMAGE_COUNT; ++i) {
+		std::swap(barriers[i].srcAccessMask, barriers[i].dstAccessMask);
+		// the current volume is written, the previous one sampled.
+		barriers[i].dstAccessMask = i < IMAGE_COUNT ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+}
+
+bool AerialPerspective::InputsChanged() const {
+	const SunData &sun = m_Sun.GetData();
+	return !m_HasInputs ||
+		m_Cam.GetRelativeProjView() != m_LastRelativeProjView ||
+		m_Cam.GetPos() != m_LastCamPos ||
+		m_Cam.GetNearPlane() != m_LastNear ||
+		m_Cam.GetFarPlane() != m_LastFar ||
+		sun.m_Color != m_LastSun.m_Color ||
+		sun.m_SunDir != m_LastSun.m_SunDir ||
+		m_Precomp.GetRatio() != m_LastRatio;
 }
 
 void AerialPerspective::Compute(VkSemaphore *waitSemaphore, VkPipelineStageFlags waitFlags, VkSemaphore *signalSemaphore) {
+	ReadTimestamps();
+
+	uint32_t groupRows = (m_Atmosphere.GetResolution().m_ApY+m_GroupY-1)/m_GroupY;
+	bool changed = InputsChanged();
+	// the atmosphere rewrites the descriptor sets of a sum target when (de)allocating it, while the device is idle.
+	if (m_DescriptorGeneration != m_Atmosphere.GetDescriptorGeneration()) {
+		RecordCommandBuffers();
+		changed = true;
+	}
+	if (changed)
+		m_StaleRows = groupRows;
+
 	VkSubmitInfo submitInfo;
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pNext = nullptr;
@@ -406,10 +649,97 @@ void AerialPerspective::Compute(VkSemaphore *waitSemaphore, VkPipelineStageFlags
 	submitInfo.pWaitDstStageMask = &waitFlags;
 	submitInfo.signalSemaphoreCount = signalSemaphore != nullptr ? 1 : 0;
 	submitInfo.pSignalSemaphores = signalSemaphore;
+
+	// the volume is up to date, keep it.
+	if (m_StaleRows == 0) {
+		m_LastRows = 0;
+		// still wait for and signal the semaphores.
+		if (waitSemaphore != nullptr || signalSemaphore != nullptr) {
+			submitInfo.commandBufferCount = 0;
+			submitInfo.pCommandBuffers = nullptr;
+			ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+		}
+		return;
+	}
+
+	// the first volume is always integrated completely, there's nothing to reproject.
+	uint32_t rows = m_Amortized && m_HasInputs ? std::min<uint32_t>(m_RowsPerFrame, groupRows) : groupRows;
+	glm::vec3 camPos = m_Cam.GetPos();
+	APFrameParams params {
+		// previous camera, moved to the current position.
+		.m_PrevProjView = m_HasInputs ? m_LastRelativeProjView * glm::translate(glm::mat4(1), camPos - m_LastCamPos) : glm::mat4(1),
+		.m_PrevNear = m_LastNear,
+		.m_PrevFar = m_LastFar,
+		.m_RowStart = int32_t(m_NextRow),
+		.m_RowCount = int32_t(rows)
+	};
+	m_FrameUBO.MapMemory(sizeof(APFrameParams), &params, 0, 0);
+
+	m_NextRow = (m_NextRow+rows) % groupRows;
+	m_StaleRows -= std::min(rows, m_StaleRows);
+	m_LastRows = rows;
+
+	m_HasInputs = true;
+	m_LastRelativeProjView = m_Cam.GetRelativeProjView();
+	m_LastCamPos = camPos;
+	m_LastNear = m_Cam.GetNearPlane();
+	m_LastFar = m_Cam.GetFarPlane();
+	m_LastSun = m_Sun.GetData();
+	m_LastRatio = m_Precomp.GetRatio();
+
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_ComputeCommandBuffer;
+	submitInfo.pCommandBuffers = &m_ComputeCommandBuffers[rows != groupRows][m_Precomp.GetSumTargetState()];
 
 	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+	m_Measuring = m_QueryPool != VK_NULL_HANDLE;
+}
+
+void AerialPerspective::ReadTimestamps() {
+	if (!m_Measuring)
+		return;
+
+	// don't wait, the results of the last submit are usually there by the next frame.
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(
+		VulkanAPI::GetDevice(),
+		m_QueryPool,
+		0,
+		2,
+		sizeof(timestamps),
+		timestamps,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+
+	if (result == VK_SUCCESS) {
+		// ns -> ms.
+		float ms = (timestamps[1]-timestamps[0]) * m_TimestampPeriod / 1e6f;
+		m_ComputeTime = m_ComputeTime < 0 ? ms : 0.9f*m_ComputeTime + 0.1f*ms;
+		// only measured again by the next submit.
+		m_Measuring = false;
+	}
+}
+
+void AerialPerspective::RenderImgui() {
+	const AtmosphereResolution &res = m_Atmosphere.GetResolution();
+
+	ImGui::Begin("Aerial perspective");
+	ImGui::Text("Froxels: %ux%ux%u", res.m_ApX, res.m_ApY, res.m_ApZ);
+	ImGui::Text("Columns per workgroup: %ux%u", m_GroupX, m_GroupY);
+
+	uint32_t groupRows = (res.m_ApY+m_GroupY-1)/m_GroupY;
+	ImGui::Checkbox("Amortized", &m_Amortized);
+	ImGui::SliderInt("RowsPerFrame", &m_RowsPerFrame, 1, groupRows);
+	if (m_LastRows == 0)
+		ImGui::Text("Last frame: unchanged, skipped");
+	else
+		ImGui::Text("Last frame: %u/%u workgroup rows integrated", m_LastRows, groupRows);
+	if (m_QueryPool == VK_NULL_HANDLE)
+		ImGui::Text("Timestamps not supported");
+	else if (m_ComputeTime < 0)
+		ImGui::Text("Compute: not measured");
+	else
+		ImGui::Text("Compute: %.4f ms", m_ComputeTime);
+	ImGui::End();
 }
 
 VkDescriptorSet AerialPerspective::GetSampleDescriptor() const {
@@ -249,7 +249,9 @@ namespace en
 		fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragStageCreateInfo.module = m_FragShader.GetVulkanModule();
 		fragStageCreateInfo.pName = "main";
-		fragStageCreateInfo.pSpecializationInfo = nullptr;
+		std::vector<VkSpecializationMapEntry> fragSpecEntries = AtmosphereResolution::GetSpecializationMapEntries();
+		VkSpecializationInfo fragSpecInfo = m_Atmosphere.GetResolution().GetSpecializationInfo(fragSpecEntries);
+		fragStageCreateInfo.pSpecializationInfo = &fragSpecInfo;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertStageCreateInfo, fragStageCreateInfo };
 
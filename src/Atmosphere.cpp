@@ -2,7 +2,10 @@
 #include <cassert>
 #include <engine/graphics/Common.hpp>
 #include "engine/graphics/VulkanAPI.hpp"
+#include "engine/graphics/vulkan/Buffer.hpp"
 #include <engine/graphics/Atmosphere.hpp>
+#include <engine/graphics/CpuPrecomputer.hpp>
+#include <engine/util/Log.hpp>
 #include <imgui.h>
 #include <set>
 #include <vulkan/vulkan_core.h>
@@ -12,6 +15,10 @@
 #include <sum.h>
 #include <gathering.h>
 #include <transmittance.h>
+#include <aerial_perspective.h>
+#include <blend.h>
+#include <sky_view.h>
+#include <cstddef>
 
 // One for a scattering/gathering orders, two for sum (switching!)
 #define SCATTERING_IMAGE_COUNT (1+2)
@@ -20,33 +27,119 @@
 
 #define IMAGE_COUNT (GATHERING_IMAGE_COUNT+SCATTERING_IMAGE_COUNT+TRANSMITTANCE_IMAGE_COUNT)
 
-constexpr VkMemoryBarrier computeMemoryBarrier {
-	.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-	.pNext = nullptr,
-	.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
-	.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT
-};
-
 namespace en {
-	Atmosphere::Atmosphere(VkDescriptorSetLayout env) :
+	AtmosphereResolution AtmosphereResolution::FromQuality(AtmosphereQuality quality)
+	{
+		switch (quality) {
+			case AtmosphereQuality::Low:
+				return {32, 64, 16, 32, 16, 16, 16, 16, 16, 16, 128, 72};
+			case AtmosphereQuality::High:
+				return {64, 256, 48, 96, 48, 48, 48, 48, 48, 32, 256, 144};
+			case AtmosphereQuality::Medium:
+			default:
+				return {
+					TRANSMITTANCE_RESOLUTION_HEIGHT_DEFAULT,
+					TRANSMITTANCE_RESOLUTION_VIEW_DEFAULT,
+					SCATTERING_RESOLUTION_HEIGHT_DEFAULT,
+					SCATTERING_RESOLUTION_VIEW_DEFAULT,
+					SCATTERING_RESOLUTION_SUN_DEFAULT,
+					GATHERING_RESOLUTION_HEIGHT_DEFAULT,
+					GATHERING_RESOLUTION_SUN_DEFAULT,
+					AP_X_DEFAULT,
+					AP_Y_DEFAULT,
+					AP_Z_DEFAULT,
+					SKY_VIEW_X_DEFAULT,
+					SKY_VIEW_Y_DEFAULT};
+		}
+	}
+
+	static const char *qualityNames[3] {"low", "medium", "high"};
+
+	const char *AtmosphereResolution::GetQualityName(AtmosphereQuality quality)
+	{
+		return qualityNames[static_cast<int>(quality)];
+	}
+
+	bool AtmosphereResolution::ParseQuality(const std::string &name, AtmosphereQuality &quality)
+	{
+		for (int i = 0; i != 3; ++i)
+			if (name == qualityNames[i]) {
+				quality = static_cast<AtmosphereQuality>(i);
+				return true;
+			}
+		return false;
+	}
+
+	std::vector<VkSpecializationMapEntry> AtmosphereResolution::GetSpecializationMapEntries(uint32_t offset)
+	{
+		auto entry = [offset](uint32_t id, size_t member) {
+			return VkSpecializationMapEntry{id, static_cast<uint32_t>(offset + member), sizeof(uint32_t)};
+		};
+		return {
+			entry(TRANSMITTANCE_RESOLUTION_HEIGHT_ID, offsetof(AtmosphereResolution, m_TransmittanceHeight)),
+			entry(TRANSMITTANCE_RESOLUTION_VIEW_ID, offsetof(AtmosphereResolution, m_TransmittanceView)),
+			entry(SCATTERING_RESOLUTION_HEIGHT_ID, offsetof(AtmosphereResolution, m_ScatteringHeight)),
+			entry(SCATTERING_RESOLUTION_VIEW_ID, offsetof(AtmosphereResolution, m_ScatteringView)),
+			entry(SCATTERING_RESOLUTION_SUN_ID, offsetof(AtmosphereResolution, m_ScatteringSun)),
+			entry(GATHERING_RESOLUTION_HEIGHT_ID, offsetof(AtmosphereResolution, m_GatheringHeight)),
+			entry(GATHERING_RESOLUTION_SUN_ID, offsetof(AtmosphereResolution, m_GatheringSun)),
+			entry(AP_X_ID, offsetof(AtmosphereResolution, m_ApX)),
+			entry(AP_Y_ID, offsetof(AtmosphereResolution, m_ApY)),
+			entry(AP_Z_ID, offsetof(AtmosphereResolution, m_ApZ)),
+			entry(SKY_VIEW_X_ID, offsetof(AtmosphereResolution, m_SkyViewX)),
+			entry(SKY_VIEW_Y_ID, offsetof(AtmosphereResolution, m_SkyViewY))};
+	}
+
+	VkSpecializationInfo AtmosphereResolution::GetSpecializationInfo(const std::vector<VkSpecializationMapEntry> &entries) const
+	{
+		VkSpecializationInfo info;
+		info.mapEntryCount = entries.size();
+		info.pMapEntries = entries.data();
+		info.dataSize = sizeof(AtmosphereResolution);
+		info.pData = this;
+		return info;
+	}
+
+	std::vector<VkSpecializationMapEntry> LutBlendSpecialization::GetSpecializationMapEntries(uint32_t offset)
+	{
+		std::vector<VkSpecializationMapEntry> entries =
+			AtmosphereResolution::GetSpecializationMapEntries(offset + offsetof(LutBlendSpecialization, m_Resolution));
+		entries.push_back({LUT_BLEND_ID, static_cast<uint32_t>(offset + offsetof(LutBlendSpecialization, m_Blend)), sizeof(VkBool32)});
+		return entries;
+	}
+
+	VkSpecializationInfo LutBlendSpecialization::GetSpecializationInfo(const std::vector<VkSpecializationMapEntry> &entries) const
+	{
+		VkSpecializationInfo info;
+		info.mapEntryCount = entries.size();
+		info.pMapEntries = entries.data();
+		info.dataSize = sizeof(LutBlendSpecialization);
+		info.pData = this;
+		return info;
+	}
+
+	Atmosphere::Atmosphere(VkDescriptorSetLayout env, AtmosphereQuality quality) :
 		m_ComputeCommandPool(0, VulkanAPI::GetComputeQFI()),
-		m_LayoutCommandPool(0, VulkanAPI::GetComputeQFI()),
+		m_LayoutCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetComputeQFI()),
 		m_SingleShader("sky/single_scattering.comp", false),
 		m_MultiShader("sky/multi_scattering.comp", false),
 		m_GatheringShader("sky/gathering.comp", false),
 		m_TransmittanceShader("sky/transmittance.comp", false),
-		m_EnvLayout{env}
+		m_EnvLayout{env},
+		m_Resolution{AtmosphereResolution::FromQuality(quality)}
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 
 		CreateCommandBuffers();
 		CreateComputeImages(device);
 		CreateDescriptors(device);
+		// the Precomputer starts with target 0.
+		AllocateSumTarget(0);
 
 		CreateComputePipeline(device);
-		// RecordGatheringCommandBuffer(m_GatheringBuffer, 0, GATHERING_RESOLUTION_HEIGHT);
-		// RecordSingleScatteringCommandBuffer(m_SingleScatteringBuffer, 0, SCATTERING_RESOLUTION_HEIGHT);
-		// RecordSingleScatteringCommandBuffer(m_MultiScatteringBuffer, 0, SCATTERING_RESOLUTION_HEIGHT);
+		// RecordGatheringCommandBuffer(m_GatheringBuffer, 0, m_Resolution.m_GatheringHeight);
+		// RecordSingleScatteringCommandBuffer(m_SingleScatteringBuffer, 0, m_Resolution.m_ScatteringHeight);
+		// RecordSingleScatteringCommandBuffer(m_MultiScatteringBuffer, 0, m_Resolution.m_ScatteringHeight);
 
 		// Precompute();
 	}
@@ -57,35 +150,17 @@ namespace en {
 		m_ComputeCommandPool.Destroy();
 		m_LayoutCommandPool.Destroy();
 
-		vkFreeMemory(device, m_ScatteringImageMemory, nullptr);
-		vkDestroyImage(device, m_ScatteringImage, nullptr);
-		vkDestroyImageView(device, m_ScatteringImageView, nullptr);
-
-		vkFreeMemory(device, m_ScatteringSumImageMemory[0], nullptr);
-		vkDestroyImage(device, m_ScatteringSumImage[0], nullptr);
-		vkDestroyImageView(device, m_ScatteringSumImageView[0], nullptr);
-		vkFreeMemory(device, m_ScatteringSumImageMemory[1], nullptr);
-		vkDestroyImage(device, m_ScatteringSumImage[1], nullptr);
-		vkDestroyImageView(device, m_ScatteringSumImageView[1], nullptr);
-
-
-		vkFreeMemory(device, m_GatheringImageMemory, nullptr);
-		vkDestroyImage(device, m_GatheringImage, nullptr);
-		vkDestroyImageView(device, m_GatheringImageView, nullptr);
-
-		vkFreeMemory(device, m_GatheringSumImageMemory[0], nullptr);
-		vkDestroyImage(device, m_GatheringSumImage[0], nullptr);
-		vkDestroyImageView(device, m_GatheringSumImageView[0], nullptr);
-		vkFreeMemory(device, m_GatheringSumImageMemory[1], nullptr);
-		vkDestroyImage(device, m_GatheringSumImage[1], nullptr);
-		vkDestroyImageView(device, m_GatheringSumImageView[1], nullptr);
-
-		vkFreeMemory(device, m_TransmittanceImageMemory[0], nullptr);
-		vkDestroyImage(device, m_TransmittanceImage[0], nullptr);
-		vkDestroyImageView(device, m_TransmittanceImageView[0], nullptr);
-		vkFreeMemory(device, m_TransmittanceImageMemory[1], nullptr);
-		vkDestroyImage(device, m_TransmittanceImage[1], nullptr);
-		vkDestroyImageView(device, m_TransmittanceImageView[1], nullptr);
+		if (m_ScratchAllocated) {
+			DestroyImage(device, m_ScatteringImage, m_ScatteringImageMemory, m_ScatteringImageView);
+			DestroyImage(device, m_GatheringImage, m_GatheringImageMemory, m_GatheringImageView);
+		}
+		for (size_t i = 0; i != 2; ++i) {
+			if (!m_SumTargetAllocated[i])
+				continue;
+			DestroyImage(device, m_TransmittanceImage[i], m_TransmittanceImageMemory[i], m_TransmittanceImageView[i]);
+			DestroyImage(device, m_ScatteringSumImage[i], m_ScatteringSumImageMemory[i], m_ScatteringSumImageView[i]);
+			DestroyImage(device, m_GatheringSumImage[i], m_GatheringSumImageMemory[i], m_GatheringSumImageView[i]);
+		}
 
 		vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
 		vkDestroyDescriptorSetLayout(device, m_ImageDescriptorLayout, nullptr);
@@ -236,193 +311,31 @@ namespace en {
 		m_TransmittanceImageDescriptor[0] = allocTarget[IMAGE_COUNT+6];
 		m_TransmittanceImageDescriptor[1] = allocTarget[IMAGE_COUNT+7];
 
-		std::vector<VkDescriptorImageInfo> texInfo(2*IMAGE_COUNT);
-		std::fill_n(texInfo.begin(), 2*IMAGE_COUNT, VkDescriptorImageInfo{
-			.sampler = m_LinearSampler,
-			.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-		});
-
-		// prepare common members.
-		std::vector<VkWriteDescriptorSet> writeDescSets(2*IMAGE_COUNT);
-		std::fill_n(writeDescSets.begin(), 2*IMAGE_COUNT, VkWriteDescriptorSet{
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstBinding = 0,
-			.dstArrayElement = 0,
-			// cannot update multiple with the same ImageInfo, different dstSets.
-			.descriptorCount = 1,
-			.pBufferInfo = nullptr,
-			.pTexelBufferView = nullptr
-		});
-
-		std::vector<VkImageView> imageViews = {
-			m_ScatteringImageView,
-			m_ScatteringSumImageView[0],
-			m_ScatteringSumImageView[1],
-			m_GatheringImageView,
-			m_GatheringSumImageView[0],
-			m_GatheringSumImageView[1],
-			m_TransmittanceImageView[0],
-			m_TransmittanceImageView[1]
-		};
-
-		std::vector<VkDescriptorSet> imageDests = {
-			m_ScatteringImageDescriptor,
-			m_ScatteringSumImageDescriptor[0],
-			m_ScatteringSumImageDescriptor[1],
-			m_GatheringImageDescriptor,
-			m_GatheringSumImageDescriptor[0],
-			m_GatheringSumImageDescriptor[1],
-			m_TransmittanceImageDescriptor[0],
-			m_TransmittanceImageDescriptor[1]
-		};
-
-		std::vector<VkDescriptorSet> sampleDests = {
-			m_ScatteringSampleDescriptor,
-			m_ScatteringSumSampleDescriptor[0],
-			m_ScatteringSumSampleDescriptor[1],
-			m_GatheringSampleDescriptor,
-			m_GatheringSumSampleDescriptor[0],
-			m_GatheringSumSampleDescriptor[1],
-			m_TransmittanceSampleDescriptor[0],
-			m_TransmittanceSampleDescriptor[1]
-		};
-
-		for (int i = 0; i != IMAGE_COUNT; ++i) {
-			texInfo[i].imageView = imageViews[i];
-
-			writeDescSets[i].dstSet = imageDests[i];
-			writeDescSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			writeDescSets[i].pImageInfo = &texInfo[i];
-
-			writeDescSets[IMAGE_COUNT + i].dstSet = sampleDests[i];
-			writeDescSets[IMAGE_COUNT + i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			writeDescSets[IMAGE_COUNT + i].pImageInfo = &texInfo[i];
-		}
-		vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+		// written once the images are allocated.
 	}
 
 	void Atmosphere::CreateComputeImages(VkDevice device)
 	{
-		std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()}; 
-		// vector for contiguous memory.
-		std::vector<uint32_t> qvec{queues.begin(), queues.end()};
-
-		m_ComputeImageFormat = VK_FORMAT_R16G16B16A16_UNORM;
+		// sampled by the renderers, written by the precomputation, copied by ReadLuts/WriteLuts.
+		VkFormatFeatureFlags features =
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+			VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+			VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
+			VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		// scattering and gathering store mie in alpha and accumulate in place, no packed format fits.
+		m_ComputeImageFormat = LutFormat::Rgba16Unorm;
+		// every other LUT is computed from the transmittance, keep it within the CPU/GPU comparison tolerance.
+		m_TransmittanceFormat = SelectLutFormat(
+			{LutFormat::E5B9G9R9Ufloat, LutFormat::B10G11R11Ufloat, LutFormat::Rgba16Unorm},
+			{3, CPU_PRECOMPUTE_TOLERANCE},
+			features);
+		Log::Info(std::string("Transmittance LUT format ") + GetLutFormatInfo(m_TransmittanceFormat).m_Name);
 		// do better testing.
 		assert(VulkanAPI::IsFormatSupported(
-			m_ComputeImageFormat,
+			GetLutFormatInfo(m_ComputeImageFormat).m_VkFormat,
 			VK_IMAGE_TILING_OPTIMAL,
 			0));
 
-		VkImageCreateInfo imageInfo{};
-		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageInfo.imageType = VK_IMAGE_TYPE_3D;
-		imageInfo.extent.width = SCATTERING_RESOLUTION_HEIGHT;
-		imageInfo.extent.height = SCATTERING_RESOLUTION_VIEW;
-		imageInfo.extent.depth = SCATTERING_RESOLUTION_SUN;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.format = m_ComputeImageFormat;
-		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		// will only be accessed by one queue at a time (for now).
-		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageInfo.queueFamilyIndexCount = qvec.size();
-		imageInfo.pQueueFamilyIndices = qvec.data();
-
-		VkMemoryAllocateInfo memAllocInfo;
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memAllocInfo.pNext = nullptr;
-
-		std::vector<VkImage> scatteringImages(SCATTERING_IMAGE_COUNT);
-		std::vector<VkDeviceMemory> scatteringImageMemory(SCATTERING_IMAGE_COUNT);
-
-		// TODO: allocate into one block, pass offsets to vkBindImageMemory.
-		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
-		for (int i = 0; i != SCATTERING_IMAGE_COUNT; ++i) {
-			ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &scatteringImages[i]));
-
-			VkMemoryRequirements memReqs;
-			vkGetImageMemoryRequirements(device, scatteringImages[i], &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
-				memReqs.memoryTypeBits,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &scatteringImageMemory[i]));
-			ASSERT_VULKAN(vkBindImageMemory(device, scatteringImages[i], scatteringImageMemory[i], 0));
-		}
-		m_ScatteringImage = scatteringImages[0];
-		m_ScatteringSumImage[0] = scatteringImages[1];
-		m_ScatteringSumImage[1] = scatteringImages[2];
-
-		m_ScatteringImageMemory = scatteringImageMemory[0];
-		m_ScatteringSumImageMemory[0] = scatteringImageMemory[1];
-		m_ScatteringSumImageMemory[1] = scatteringImageMemory[2];
-
-
-		std::vector<VkImage> gatheringImages(GATHERING_IMAGE_COUNT);
-		std::vector<VkDeviceMemory> gatheringImageMemory(GATHERING_IMAGE_COUNT);
-
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.extent.width = GATHERING_RESOLUTION_HEIGHT;
-		imageInfo.extent.height = GATHERING_RESOLUTION_SUN;
-		imageInfo.extent.depth = 1;
-		// transfer dst for clearing sum image.
-		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		for (int i = 0; i != GATHERING_IMAGE_COUNT; ++i) {
-			ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &gatheringImages[i]));
-
-			VkMemoryRequirements memReqs;
-			vkGetImageMemoryRequirements(device, gatheringImages[i], &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
-				memReqs.memoryTypeBits,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &gatheringImageMemory[i]));
-			ASSERT_VULKAN(vkBindImageMemory(device, gatheringImages[i], gatheringImageMemory[i], 0));
-		}
-		m_GatheringImage = gatheringImages[0];
-		m_GatheringSumImage[0] = gatheringImages[1];
-		m_GatheringSumImage[1] = gatheringImages[2];
-
-		m_GatheringImageMemory = gatheringImageMemory[0];
-		m_GatheringSumImageMemory[0] = gatheringImageMemory[1];
-		m_GatheringSumImageMemory[1] = gatheringImageMemory[2];
-
-
-		std::vector<VkImage> transmittanceImages(TRANSMITTANCE_IMAGE_COUNT);
-		std::vector<VkDeviceMemory> transmittanceImageMemory(TRANSMITTANCE_IMAGE_COUNT);
-
-		imageInfo.extent.width = TRANSMITTANCE_RESOLUTION_HEIGHT;
-		imageInfo.extent.height = TRANSMITTANCE_RESOLUTION_VIEW;
-		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
-		imageInfo.extent.depth = 1;
-		for (int i = 0; i != TRANSMITTANCE_IMAGE_COUNT; ++i) {
-			ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &transmittanceImages[i]));
-
-			VkMemoryRequirements memReqs;
-			vkGetImageMemoryRequirements(device, transmittanceImages[i], &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
-				memReqs.memoryTypeBits,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &transmittanceImageMemory[i]));
-			ASSERT_VULKAN(vkBindImageMemory(device, transmittanceImages[i], transmittanceImageMemory[i], 0));
-		}
-		m_TransmittanceImage[0] = transmittanceImages[0];
-		m_TransmittanceImage[1] = transmittanceImages[1];
-
-		m_TransmittanceImageMemory[0] = transmittanceImageMemory[0];
-		m_TransmittanceImageMemory[1] = transmittanceImageMemory[1];
-
 		// Create sampler
 		VkSamplerCreateInfo sampler;
 		sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -445,12 +358,60 @@ namespace en {
 		sampler.flags = 0;
 		ASSERT_VULKAN(vkCreateSampler(device, &sampler, nullptr, &m_LinearSampler));
 
-		// Create Image View
+		// images are allocated by AllocateSumTarget/AllocateScratch.
+		m_SumTargetAllocated = {false, false};
+		m_ScratchAllocated = false;
+		m_DescriptorGeneration = 0;
+	}
+
+	void Atmosphere::CreateImage(VkDevice device, AtmosphereImage image, VkImage &vkImage, VkDeviceMemory &memory, VkImageView &view)
+	{
+		std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()}; 
+		// vector for contiguous memory.
+		std::vector<uint32_t> qvec{queues.begin(), queues.end()};
+
+		bool is3D = image == AtmosphereImage::Scattering || image == AtmosphereImage::ScatteringSum;
+		VkFormat format = GetLutFormatInfo(GetImageFormat(image)).m_VkFormat;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = is3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+		imageInfo.extent = GetImageExtent(image);
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		// will only be accessed by one queue at a time (for now).
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.queueFamilyIndexCount = qvec.size();
+		imageInfo.pQueueFamilyIndices = qvec.data();
+		// transfer for loading/storing LUTs and clearing the gathering sum.
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &vkImage));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, vkImage, &memReqs);
+
+		VkMemoryAllocateInfo memAllocInfo;
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAllocInfo.pNext = nullptr;
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
+			memReqs.memoryTypeBits,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &memory));
+		ASSERT_VULKAN(vkBindImageMemory(device, vkImage, memory, 0));
+
 		VkImageViewCreateInfo imageViewCreateInfo;
 		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		imageViewCreateInfo.pNext = nullptr;
 		imageViewCreateInfo.flags = 0;
-		imageViewCreateInfo.format = m_ComputeImageFormat;
+		imageViewCreateInfo.image = vkImage;
+		imageViewCreateInfo.viewType = is3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCreateInfo.format = format;
 		imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -461,51 +422,31 @@ namespace en {
 		imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 		imageViewCreateInfo.subresourceRange.layerCount = 1;
 
-		std::vector<VkImageView> scatteringImageViews(SCATTERING_IMAGE_COUNT);
-		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
-		for (int i = 0; i != SCATTERING_IMAGE_COUNT; ++i) {
-			imageViewCreateInfo.image = scatteringImages[i];
-
-			ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &scatteringImageViews[i]));
-		}
-		m_ScatteringImageView = scatteringImageViews[0];
-		m_ScatteringSumImageView[0] = scatteringImageViews[1];
-		m_ScatteringSumImageView[1] = scatteringImageViews[2];
-
-		std::vector<VkImageView> gatheringImageViews(SCATTERING_IMAGE_COUNT);
-		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		for (int i = 0; i != GATHERING_IMAGE_COUNT; ++i) {
-			imageViewCreateInfo.image = gatheringImages[i];
-
-			ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &gatheringImageViews[i]));
-		}
-		m_GatheringImageView = gatheringImageViews[0];
-		m_GatheringSumImageView[0] = gatheringImageViews[1];
-		m_GatheringSumImageView[1] = gatheringImageViews[2];
-
-		std::vector<VkImageView> transmittanceImageViews(TRANSMITTANCE_IMAGE_COUNT);
-		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		for (int i = 0; i != TRANSMITTANCE_IMAGE_COUNT; ++i) {
-			imageViewCreateInfo.image = transmittanceImages[i];
+		ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &view));
+	}
 
-			ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &transmittanceImageViews[i]));
-		}
-		m_TransmittanceImageView[0] = transmittanceImageViews[0];
-		m_TransmittanceImageView[1] = transmittanceImageViews[1];
+	void Atmosphere::DestroyImage(VkDevice device, VkImage vkImage, VkDeviceMemory memory, VkImageView view)
+	{
+		vkDestroyImageView(device, view, nullptr);
+		vkDestroyImage(device, vkImage, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
 
-		// use compute-command buffer once here.
+	void Atmosphere::InitImages(const std::vector<VkImage> &images)
+	{
 		VkCommandBufferBeginInfo beginInfo {
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 			.pNext = nullptr,
-			.flags = 0,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 			.pInheritanceInfo = nullptr
 		};
+		ASSERT_VULKAN(vkBeginCommandBuffer(m_LayoutCommandBuffer, &beginInfo));
 
 		VkImageMemoryBarrier imageMemoryBarrier;
 		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imageMemoryBarrier.pNext = nullptr;
 		imageMemoryBarrier.srcAccessMask = VK_ACCESS_NONE_KHR;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
 		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; // TODO: manage for later usage
@@ -516,24 +457,32 @@ namespace en {
 		imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
 		imageMemoryBarrier.subresourceRange.layerCount = 1;
 
-		// append gathering and transmittance images.
-		scatteringImages.insert(scatteringImages.end(), gatheringImages.begin(), gatheringImages.end());
-		scatteringImages.insert(scatteringImages.end(), transmittanceImages.begin(), transmittanceImages.end());
-		for (int i = 0; i != IMAGE_COUNT; ++i) {
-			imageMemoryBarrier.image = scatteringImages[i];
-			ASSERT_VULKAN(vkBeginCommandBuffer(m_LayoutCommandBuffers[i], &beginInfo));
-
-			vkCmdPipelineBarrier(
-				m_LayoutCommandBuffers[i],
-				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &imageMemoryBarrier);
-
-			ASSERT_VULKAN(vkEndCommandBuffer(m_LayoutCommandBuffers[i]));
-		}
+		std::vector<VkImageMemoryBarrier> barriers(images.size(), imageMemoryBarrier);
+		for (size_t i = 0; i != images.size(); ++i)
+			barriers[i].image = images[i];
+		vkCmdPipelineBarrier(
+			m_LayoutCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			barriers.size(), barriers.data());
+
+		VkClearColorValue clearColors {0,0,0,0};
+		for (VkImage image : images)
+			vkCmdClearColorImage(m_LayoutCommandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &clearColors, 1, &imageMemoryBarrier.subresourceRange);
+
+		// visible to everything after.
+		VkMemoryBarrier barrier {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(m_LayoutCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		ASSERT_VULKAN(vkEndCommandBuffer(m_LayoutCommandBuffer));
 
 		VkSubmitInfo submitInfo;
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -541,17 +490,131 @@ namespace en {
 		submitInfo.waitSemaphoreCount = 0;
 		submitInfo.pWaitSemaphores = nullptr;
 		submitInfo.pWaitDstStageMask = nullptr;
-		// submit all buffers at once.
-		submitInfo.commandBufferCount = m_LayoutCommandBuffers.size();
-		submitInfo.pCommandBuffers = m_LayoutCommandBuffers.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_LayoutCommandBuffer;
 		submitInfo.signalSemaphoreCount = 0;
 		submitInfo.pSignalSemaphores = nullptr;
 
 		ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-
+		// the buffer is reused for the next allocation.
 		ASSERT_VULKAN(vkQueueWaitIdle(VulkanAPI::GetComputeQueue()));
 	}
 
+	void Atmosphere::WriteDescriptorSets(VkDevice device, VkDescriptorSet imageSet, VkDescriptorSet sampleSet, VkImageView view)
+	{
+		VkDescriptorImageInfo texInfo {
+			.sampler = m_LinearSampler,
+			.imageView = view,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		};
+
+		std::array<VkWriteDescriptorSet, 2> writeDescSets;
+		writeDescSets.fill(VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.pImageInfo = &texInfo,
+			.pBufferInfo = nullptr,
+			.pTexelBufferView = nullptr
+		});
+		writeDescSets[0].dstSet = imageSet;
+		writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writeDescSets[1].dstSet = sampleSet;
+		writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+		vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+	}
+
+	void Atmosphere::WriteSumTargetDescriptorSets(VkDevice device, size_t sum_target, size_t source)
+	{
+		WriteDescriptorSets(device, m_TransmittanceImageDescriptor[sum_target], m_TransmittanceSampleDescriptor[sum_target], m_TransmittanceImageView[source]);
+		WriteDescriptorSets(device, m_ScatteringSumImageDescriptor[sum_target], m_ScatteringSumSampleDescriptor[sum_target], m_ScatteringSumImageView[source]);
+		WriteDescriptorSets(device, m_GatheringSumImageDescriptor[sum_target], m_GatheringSumSampleDescriptor[sum_target], m_GatheringSumImageView[source]);
+	}
+
+	void Atmosphere::AllocateSumTarget(size_t sum_target)
+	{
+		if (m_SumTargetAllocated[sum_target])
+			return;
+		VkDevice device = VulkanAPI::GetDevice();
+
+		CreateImage(device, AtmosphereImage::Transmittance, m_TransmittanceImage[sum_target], m_TransmittanceImageMemory[sum_target], m_TransmittanceImageView[sum_target]);
+		CreateImage(device, AtmosphereImage::ScatteringSum, m_ScatteringSumImage[sum_target], m_ScatteringSumImageMemory[sum_target], m_ScatteringSumImageView[sum_target]);
+		CreateImage(device, AtmosphereImage::GatheringSum, m_GatheringSumImage[sum_target], m_GatheringSumImageMemory[sum_target], m_GatheringSumImageView[sum_target]);
+		InitImages({m_TransmittanceImage[sum_target], m_ScatteringSumImage[sum_target], m_GatheringSumImage[sum_target]});
+		m_SumTargetAllocated[sum_target] = true;
+
+		WriteSumTargetDescriptorSets(device, sum_target, sum_target);
+		if (!m_SumTargetAllocated[sum_target^1])
+			WriteSumTargetDescriptorSets(device, sum_target^1, sum_target);
+		++m_DescriptorGeneration;
+	}
+
+	void Atmosphere::ReleaseSumTarget(size_t sum_target)
+	{
+		if (!m_SumTargetAllocated[sum_target])
+			return;
+		assert(m_SumTargetAllocated[sum_target^1]);
+		VkDevice device = VulkanAPI::GetDevice();
+
+		WriteSumTargetDescriptorSets(device, sum_target, sum_target^1);
+		DestroyImage(device, m_TransmittanceImage[sum_target], m_TransmittanceImageMemory[sum_target], m_TransmittanceImageView[sum_target]);
+		DestroyImage(device, m_ScatteringSumImage[sum_target], m_ScatteringSumImageMemory[sum_target], m_ScatteringSumImageView[sum_target]);
+		DestroyImage(device, m_GatheringSumImage[sum_target], m_GatheringSumImageMemory[sum_target], m_GatheringSumImageView[sum_target]);
+		m_TransmittanceImage[sum_target] = VK_NULL_HANDLE;
+		m_ScatteringSumImage[sum_target] = VK_NULL_HANDLE;
+		m_GatheringSumImage[sum_target] = VK_NULL_HANDLE;
+		m_SumTargetAllocated[sum_target] = false;
+		++m_DescriptorGeneration;
+	}
+
+	bool Atmosphere::IsSumTargetAllocated(size_t sum_target) const { return m_SumTargetAllocated[sum_target]; }
+
+	bool Atmosphere::IsScratchAllocated() const { return m_ScratchAllocated; }
+
+	void Atmosphere::AllocateScratch()
+	{
+		if (m_ScratchAllocated)
+			return;
+		VkDevice device = VulkanAPI::GetDevice();
+
+		CreateImage(device, AtmosphereImage::Scattering, m_ScatteringImage, m_ScatteringImageMemory, m_ScatteringImageView);
+		CreateImage(device, AtmosphereImage::Gathering, m_GatheringImage, m_GatheringImageMemory, m_GatheringImageView);
+		InitImages({m_ScatteringImage, m_GatheringImage});
+		// only bound by precomputations, none is in flight while the scratch images are released.
+		WriteDescriptorSets(device, m_ScatteringImageDescriptor, m_ScatteringSampleDescriptor, m_ScatteringImageView);
+		WriteDescriptorSets(device, m_GatheringImageDescriptor, m_GatheringSampleDescriptor, m_GatheringImageView);
+		m_ScratchAllocated = true;
+	}
+
+	void Atmosphere::ReleaseScratch()
+	{
+		if (!m_ScratchAllocated)
+			return;
+		VkDevice device = VulkanAPI::GetDevice();
+
+		DestroyImage(device, m_ScatteringImage, m_ScatteringImageMemory, m_ScatteringImageView);
+		DestroyImage(device, m_GatheringImage, m_GatheringImageMemory, m_GatheringImageView);
+		m_ScatteringImage = VK_NULL_HANDLE;
+		m_GatheringImage = VK_NULL_HANDLE;
+		m_ScratchAllocated = false;
+	}
+
+	uint64_t Atmosphere::GetDescriptorGeneration() const { return m_DescriptorGeneration; }
+
+	VkDeviceSize Atmosphere::GetAllocatedSize() const
+	{
+		VkDeviceSize size = 0;
+		for (size_t i = 0; i != 2; ++i)
+			if (m_SumTargetAllocated[i])
+				size += GetImageSize(AtmosphereImage::Transmittance) + GetImageSize(AtmosphereImage::ScatteringSum) + GetImageSize(AtmosphereImage::GatheringSum);
+		if (m_ScratchAllocated)
+			size += GetImageSize(AtmosphereImage::Scattering) + GetImageSize(AtmosphereImage::Gathering);
+		return size;
+	}
+
 	void Atmosphere::CreateComputePipeline(VkDevice device)
 	{
 		VkPushConstantRange pcRange = {
@@ -630,7 +693,10 @@ namespace en {
 		compStageCreateInfo.flags = 0;
 		compStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 		compStageCreateInfo.pName = "main";
-		compStageCreateInfo.pSpecializationInfo = nullptr;
+		// resolution of the LUTs.
+		std::vector<VkSpecializationMapEntry> specEntries = AtmosphereResolution::GetSpecializationMapEntries();
+		VkSpecializationInfo specInfo = m_Resolution.GetSpecializationInfo(specEntries);
+		compStageCreateInfo.pSpecializationInfo = &specInfo;
 
 		VkComputePipelineCreateInfo pipeline;
 		pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -666,22 +732,171 @@ namespace en {
 		m_MultiScatteringBuffer = tmp[1];
 		m_GatheringBuffer = tmp[2];
 
-		// Buffers for transitioning layout, one per image (+1 for sum-image).
-		m_LayoutCommandPool.AllocateBuffers(IMAGE_COUNT, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-		m_LayoutCommandBuffers = m_LayoutCommandPool.GetBuffers();
+		// for transitioning layouts of newly allocated images.
+		m_LayoutCommandPool.AllocateBuffers(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		m_LayoutCommandBuffer = m_LayoutCommandPool.GetBuffer(0);
+	}
+
+	VkImage Atmosphere::GetImage(AtmosphereImage image, size_t sum_target) const
+	{
+		switch (image) {
+			case AtmosphereImage::Transmittance: return m_TransmittanceImage[sum_target];
+			case AtmosphereImage::Scattering: return m_ScatteringImage;
+			case AtmosphereImage::ScatteringSum: return m_ScatteringSumImage[sum_target];
+			case AtmosphereImage::Gathering: return m_GatheringImage;
+			case AtmosphereImage::GatheringSum: return m_GatheringSumImage[sum_target];
+		}
+		return VK_NULL_HANDLE;
+	}
+
+	LutFormat Atmosphere::GetImageFormat(AtmosphereImage image) const
+	{
+		return image == AtmosphereImage::Transmittance ? m_TransmittanceFormat : m_ComputeImageFormat;
+	}
+
+	const AtmosphereResolution &Atmosphere::GetResolution() const { return m_Resolution; }
+
+	VkExtent3D Atmosphere::GetImageExtent(AtmosphereImage image) const
+	{
+		switch (image) {
+			case AtmosphereImage::Transmittance:
+				return {m_Resolution.m_TransmittanceHeight, m_Resolution.m_TransmittanceView, 1};
+			case AtmosphereImage::Scattering:
+			case AtmosphereImage::ScatteringSum:
+				return {m_Resolution.m_ScatteringHeight, m_Resolution.m_ScatteringView, m_Resolution.m_ScatteringSun};
+			case AtmosphereImage::Gathering:
+			case AtmosphereImage::GatheringSum:
+				return {m_Resolution.m_GatheringHeight, m_Resolution.m_GatheringSun, 1};
+		}
+		return {0, 0, 0};
 	}
 
-	void Atmosphere::RecordTransmittanceCommandBuffer(VkCommandBuffer buf, size_t sum_target, VkDescriptorSet env)
+	VkDeviceSize Atmosphere::GetImageSize(AtmosphereImage image) const
 	{
-		VkCommandBufferBeginInfo beginInfo;
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		VkExtent3D extent = GetImageExtent(image);
+		return VkDeviceSize(extent.width) * extent.height * extent.depth * GetLutFormatInfo(GetImageFormat(image)).m_TexelSize;
+	}
+
+	AtmosphereLuts Atmosphere::ReadLuts(size_t sum_target)
+	{
+		AtmosphereLuts luts;
+		CopyLuts(sum_target, luts, false);
+		return luts;
+	}
+
+	void Atmosphere::WriteLuts(size_t sum_target, const AtmosphereLuts &luts)
+	{
+		// CopyLuts only reads from luts when uploading.
+		CopyLuts(sum_target, const_cast<AtmosphereLuts &>(luts), true);
+	}
+
+	void Atmosphere::CopyLuts(size_t sum_target, AtmosphereLuts &luts, bool upload)
+	{
+		VkQueue queue = VulkanAPI::GetComputeQueue();
+
+		std::array<AtmosphereImage, 3> images {AtmosphereImage::Transmittance, AtmosphereImage::ScatteringSum, AtmosphereImage::GatheringSum};
+		std::array<std::vector<char> *, 3> data {&luts.m_Transmittance, &luts.m_ScatteringSum, &luts.m_GatheringSum};
+
+		// one staging buffer for all three, at these offsets.
+		std::array<VkDeviceSize, 3> offsets;
+		VkDeviceSize size = 0;
+		for (int i = 0; i != 3; ++i) {
+			offsets[i] = size;
+			size += GetImageSize(images[i]);
+		}
+
+		vk::Buffer stagingBuffer(
+			size,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			{});
 
+		// an unallocated target aliases the visible one.
+		assert(m_SumTargetAllocated[sum_target]);
+
+		if (upload)
+			for (int i = 0; i != 3; ++i) {
+				std::vector<char> texels = ConvertLut(AtmosphereLuts::m_Format, GetImageFormat(images[i]), *data[i]);
+				assert(texels.size() == GetImageSize(images[i]));
+				stagingBuffer.MapMemory(texels.size(), texels.data(), offsets[i], 0);
+			}
+
+		vk::CommandPool commandPool(0, VulkanAPI::GetComputeQFI());
+		commandPool.AllocateBuffers(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		VkCommandBuffer buf = commandPool.GetBuffer(0);
+
+		VkCommandBufferBeginInfo beginInfo {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = nullptr
+		};
 		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
 
-		// TODO: do this in separate buffer+function (another task in precomputer).
+		// wait for all previously submitted work on these images (precomputation, rendering).
+		VkMemoryBarrier barrier {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		for (int i = 0; i != 3; ++i) {
+			VkBufferImageCopy region {
+				.bufferOffset = offsets[i],
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = 0,
+					.baseArrayLayer = 0,
+					.layerCount = 1
+				},
+				.imageOffset = {0, 0, 0},
+				.imageExtent = GetImageExtent(images[i])
+			};
+			if (upload)
+				vkCmdCopyBufferToImage(buf, stagingBuffer.GetVulkanHandle(), GetImage(images[i], sum_target), VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+			else
+				vkCmdCopyImageToBuffer(buf, GetImage(images[i], sum_target), VK_IMAGE_LAYOUT_GENERAL, stagingBuffer.GetVulkanHandle(), 1, &region);
+		}
+
+		// make uploaded LUTs visible to everything after.
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		ASSERT_VULKAN(vkEndCommandBuffer(buf));
+
+		VkSubmitInfo submitInfo;
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = nullptr;
+		submitInfo.waitSemaphoreCount = 0;
+		submitInfo.pWaitSemaphores = nullptr;
+		submitInfo.pWaitDstStageMask = nullptr;
+		submitInfo.signalSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = nullptr;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &buf;
+
+		ASSERT_VULKAN(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		ASSERT_VULKAN(vkQueueWaitIdle(queue));
+
+		if (!upload)
+			for (int i = 0; i != 3; ++i) {
+				std::vector<char> texels(GetImageSize(images[i]));
+				stagingBuffer.GetData(texels.size(), texels.data(), offsets[i], 0);
+				*data[i] = ConvertLut(GetImageFormat(images[i]), AtmosphereLuts::m_Format, texels);
+			}
+
+		commandPool.Destroy();
+		stagingBuffer.Destroy();
+	}
+
+	void Atmosphere::RecordGatheringSumClear(VkCommandBuffer buf, size_t sum_target)
+	{
+		// gathering accumulates into the sum, has to start from zero.
 		VkClearColorValue clearColors {0,0,0,0};
 		VkImageSubresourceRange subresourceRanges {
 			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -691,7 +906,10 @@ namespace en {
 			.layerCount = 1
 		};
 		vkCmdClearColorImage(buf, m_GatheringSumImage[sum_target], VK_IMAGE_LAYOUT_GENERAL, &clearColors, 1, &subresourceRanges);
+	}
 
+	void Atmosphere::RecordTransmittance(VkCommandBuffer buf, size_t sum_target, VkDescriptorSet env)
+	{
 		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_TPipeline);
 
 		std::vector<VkDescriptorSet> sets(2);
@@ -699,27 +917,11 @@ namespace en {
 		sets[T_SETS_ENV] = env;
 		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_TPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
 
-		vkCmdDispatch(buf, TRANSMITTANCE_RESOLUTION_HEIGHT, TRANSMITTANCE_RESOLUTION_VIEW, 1);
-
-		vkEndCommandBuffer(buf);
+		vkCmdDispatch(buf, m_Resolution.m_TransmittanceHeight, m_Resolution.m_TransmittanceView, 1);
 	}
 
-	void Atmosphere::RecordSingleScatteringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env)
+	void Atmosphere::RecordSingleScattering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env)
 	{
-		VkCommandBufferBeginInfo beginInfo;
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
-
-		// Record all into separate buffers to execute sequentially for now.
-
-		// single scattering
-		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
-
-		// wait for previous compute (we need the full results of the previous scattering order).
-		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &computeMemoryBarrier, 0, nullptr, 0, nullptr);
-
 		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_SSPipeline);
 
 		std::vector<VkDescriptorSet> sets(4);
@@ -729,24 +931,11 @@ namespace en {
 		sets[SS_SETS_ENV] = env;
 		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_SSPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
 		vkCmdPushConstants(buf, m_SSPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &offset);
-		vkCmdDispatch(buf, count, SCATTERING_RESOLUTION_VIEW, SCATTERING_RESOLUTION_SUN);
-
-		vkEndCommandBuffer(buf);
+		vkCmdDispatch(buf, count, m_Resolution.m_ScatteringView, m_Resolution.m_ScatteringSun);
 	}
 
-	void Atmosphere::RecordMultiScatteringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env)
+	void Atmosphere::RecordMultiScattering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env)
 	{
-		VkCommandBufferBeginInfo beginInfo;
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
-
-		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
-
-		// wait for previous compute (we need the full results of the previous scattering order).
-		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &computeMemoryBarrier, 0, nullptr, 0, nullptr);
-
 		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_MSPipeline);
 
 		std::vector<VkDescriptorSet> sets(5);
@@ -767,27 +956,13 @@ namespace en {
 			nullptr);
 		vkCmdPushConstants(buf, m_MSPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &offset);
 
-		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &computeMemoryBarrier, 0, nullptr, 0, nullptr);
 		vkCmdDispatch(buf,
 			count,
-			SCATTERING_RESOLUTION_VIEW,
-			SCATTERING_RESOLUTION_SUN);
-
-		vkEndCommandBuffer(buf);
+			m_Resolution.m_ScatteringView,
+			m_Resolution.m_ScatteringSun);
 	}
 
-	void Atmosphere::RecordGatheringCommandBuffer(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env) {
-		VkCommandBufferBeginInfo beginInfo;
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
-
-		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
-
-		// wait for previous compute (we need the full results of the previous scattering order).
-		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &computeMemoryBarrier, 0, nullptr, 0, nullptr);
-
+	void Atmosphere::RecordGathering(VkCommandBuffer buf, uint32_t offset, uint32_t count, size_t sum_target, VkDescriptorSet env) {
 		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_GPipeline);
 		// always 3 descriptorSets from now on.
 		std::vector<VkDescriptorSet> sets(5);
@@ -810,10 +985,8 @@ namespace en {
 
 		vkCmdDispatch(buf,
 			count,
-			GATHERING_RESOLUTION_SUN,
+			m_Resolution.m_GatheringSun,
 			1);
-
-		vkEndCommandBuffer(buf);
 	}
 
 	// all three use the same layout, but that may change, so different functions make sense for now.
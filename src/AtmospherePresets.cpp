@@ -0,0 +1,50 @@
+#include <engine/graphics/AtmospherePresets.hpp>
+#include <cmath>
+
+namespace en {
+
+static const EnvConditions::Environment earthConditions {
+	// data from https://www.iup.uni-bremen.de/gruppen/molspec/downloads/serdyuchenkogorshelev5digits.dat.
+	// 650, 510, 475nm at 243K (-30C, eyeballed average temperature for height of most ozone).
+	// *10^-4 for cm^2 -> m^2.
+	.m_OzoneExtinctionCoefficient = glm::vec3(2.43181E-25, 1.151113e-25, 4.47939e-26),
+	.m_PlanetRadius = 6371000,
+	.m_AtmosphereHeight = 80000,
+	.m_RefractiveIndexAir = 1.0003,
+	.m_AirDensityAtSeaLevel = static_cast<float>(2.545*pow(10, 25)),
+	.m_MieScatteringCoefficient = 0.000002,
+	.m_AsymmetryFactor = 0.73,
+	.m_RayleighScaleHeight = 8000,
+	.m_MieScaleHeight = 1200
+};
+
+const std::vector<AtmospherePreset> &GetAtmospherePresets() {
+	static const std::vector<AtmospherePreset> presets {
+		{"Earth", earthConditions},
+		// ten times the aerosols, spread higher.
+		{"Hazy", {
+			.m_OzoneExtinctionCoefficient = earthConditions.m_OzoneExtinctionCoefficient,
+			.m_PlanetRadius = 6371000,
+			.m_AtmosphereHeight = 80000,
+			.m_RefractiveIndexAir = 1.0003,
+			.m_AirDensityAtSeaLevel = static_cast<float>(2.545*pow(10, 25)),
+			.m_MieScatteringCoefficient = 0.00002,
+			.m_AsymmetryFactor = 0.76,
+			.m_RayleighScaleHeight = 8000,
+			.m_MieScaleHeight = 2000 }},
+		// thin CO2 atmosphere (~1% of earths density), dominated by dust, no ozone.
+		{"Mars", {
+			.m_OzoneExtinctionCoefficient = glm::vec3(0),
+			.m_PlanetRadius = 3389500,
+			.m_AtmosphereHeight = 100000,
+			.m_RefractiveIndexAir = 1.0000034,
+			.m_AirDensityAtSeaLevel = static_cast<float>(2.0*pow(10, 23)),
+			.m_MieScatteringCoefficient = 0.00002,
+			.m_AsymmetryFactor = 0.63,
+			.m_RayleighScaleHeight = 11100,
+			.m_MieScaleHeight = 11100 }}
+	};
+	return presets;
+}
+
+}
@@ -142,6 +142,7 @@ namespace en
 		glm::mat4 viewMat = glm::lookAt(glm::vec3(0,0,0), glm::vec3(m_ViewDir), m_Up);
 		// invert before applying translation, better numerical stability.
 		glm::mat4 viewMatInv = glm::inverse(viewMat);
+		m_RelativeProjView = projMat * viewMat;
 			
 		viewMat *= glm::translate(-m_Pos);
 		viewMatInv = glm::translate(m_Pos) * viewMatInv;
@@ -268,4 +269,9 @@ namespace en
 	{
 		return m_DescriptorSet;
 	}
+
+	const glm::mat4& Camera::GetRelativeProjView() const
+	{
+		return m_RelativeProjView;
+	}
 }
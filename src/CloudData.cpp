@@ -4,8 +4,71 @@
 #include <imgui.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <engine/util/ReadFile.hpp>
+#include <algorithm>
 namespace en
 {
+	// weather texels per side of an occupancy texel.
+	const uint32_t WEATHER_OCCUPANCY_CELL_SIZE = 8;
+
+	static std::array<VecVecF, 4> GenerateWeather()
+	{
+		return {
+			NoiseGenerator::Worley2D(glm::uvec2(256), 16, 0.0f, 1.0f),
+			NoiseGenerator::Perlin2D(glm::uvec2(256), glm::vec2(20.0f, 10.0f), 1.0f / 16.0f, 0.4f, 0.7f),
+			NoiseGenerator::Perlin2D(glm::uvec2(256), glm::vec2(10.0f, 30.0f), 1.0f / 16.0f, 0.0f, 0.3f),
+			NoiseGenerator::NoNoise2D(glm::uvec2(256), 1.0f) };
+	}
+
+	// r: maximum coverage, g: lowest cloud bottom, b: highest cloud top (relative to the sky box),
+	// over every weather texel a bilinear fetch inside the cell can reach.
+	static std::array<VecVecF, 4> GenerateWeatherOccupancy(const std::array<VecVecF, 4>& weather)
+	{
+		const int width = weather[0].size();
+		const int height = weather[0][0].size();
+		const uint32_t cellsX = (width + WEATHER_OCCUPANCY_CELL_SIZE-1) / WEATHER_OCCUPANCY_CELL_SIZE;
+		const uint32_t cellsY = (height + WEATHER_OCCUPANCY_CELL_SIZE-1) / WEATHER_OCCUPANCY_CELL_SIZE;
+
+		// the same 8 bit values as Texture2D uploads, the shader compares them exactly.
+		auto quantize = [](float value) { return static_cast<int>(static_cast<uint8_t>(std::max(0.0f, value * 255.0f))); };
+		// stored as (k+0.5)/255, which Texture2D truncates to k again.
+		auto store = [](int value) { return (std::min(value, 255) + 0.5f) / 255.0f; };
+
+		std::array<VecVecF, 4> occupancy;
+		for (VecVecF& channel : occupancy)
+			channel = VecVecF(cellsX, std::vector<float>(cellsY, 0.0f));
+
+		for (uint32_t cx = 0; cx < cellsX; cx++)
+		{
+			for (uint32_t cy = 0; cy < cellsY; cy++)
+			{
+				int maxCoverage = 0;
+				int minBottom = 255;
+				int maxTop = 0;
+				// one texel more on each side, bilinear filtering reaches into the neighbouring cells.
+				const int x0 = std::max(0, static_cast<int>(cx * WEATHER_OCCUPANCY_CELL_SIZE) - 1);
+				const int x1 = std::min(width - 1, static_cast<int>((cx + 1) * WEATHER_OCCUPANCY_CELL_SIZE));
+				const int y0 = std::max(0, static_cast<int>(cy * WEATHER_OCCUPANCY_CELL_SIZE) - 1);
+				const int y1 = std::min(height - 1, static_cast<int>((cy + 1) * WEATHER_OCCUPANCY_CELL_SIZE));
+				for (int x = x0; x <= x1; x++)
+				{
+					for (int y = y0; y <= y1; y++)
+					{
+						const int bottom = quantize(weather[2][x][y]);
+						maxCoverage = std::max(maxCoverage, quantize(weather[0][x][y]));
+						minBottom = std::min(minBottom, bottom);
+						maxTop = std::max(maxTop, bottom + quantize(weather[1][x][y]));
+					}
+				}
+
+				occupancy[0][cx][cy] = store(maxCoverage);
+				occupancy[1][cx][cy] = store(minBottom);
+				occupancy[2][cx][cy] = store(maxTop);
+			}
+		}
+
+		return occupancy;
+	}
+
 	bool CloudUniformData::operator==(const CloudUniformData& other)
 	{
 		return
@@ -22,7 +85,8 @@ namespace en
 			this->ambientGradientMaxVal == other.ambientGradientMaxVal &&
 			this->jitterStrength == other.jitterStrength &&
 			this->sigmaS == other.sigmaS &&
-			this->sigmaE == other.sigmaE;
+			this->sigmaE == other.sigmaE &&
+			this->boundsMode == other.boundsMode;
 	}
 
 	bool CloudUniformData::operator!=(const CloudUniformData& other)
@@ -42,31 +106,38 @@ namespace en
 		dataBinding.binding = 0;
 		dataBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		dataBinding.descriptorCount = 1;
-		dataBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		dataBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		dataBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutBinding cloudShapeBinding;
 		cloudShapeBinding.binding = 1;
 		cloudShapeBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		cloudShapeBinding.descriptorCount = 1;
-		cloudShapeBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		cloudShapeBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		cloudShapeBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutBinding cloudDetailBinding;
 		cloudDetailBinding.binding = 2;
 		cloudDetailBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		cloudDetailBinding.descriptorCount = 1;
-		cloudDetailBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		cloudDetailBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		cloudDetailBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutBinding weatherBinding;
 		weatherBinding.binding = 3;
 		weatherBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		weatherBinding.descriptorCount = 1;
-		weatherBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		weatherBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		weatherBinding.pImmutableSamplers = nullptr;
 
-		std::vector<VkDescriptorSetLayoutBinding> bindings = { dataBinding, cloudShapeBinding, cloudDetailBinding, weatherBinding };
+		VkDescriptorSetLayoutBinding weatherOccupancyBinding;
+		weatherOccupancyBinding.binding = 4;
+		weatherOccupancyBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		weatherOccupancyBinding.descriptorCount = 1;
+		weatherOccupancyBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		weatherOccupancyBinding.pImmutableSamplers = nullptr;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings = { dataBinding, cloudShapeBinding, cloudDetailBinding, weatherBinding, weatherOccupancyBinding };
 
 		VkDescriptorSetLayoutCreateInfo descSetLayoutCreateInfo;
 		descSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -95,7 +166,11 @@ namespace en
 		weatherSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		weatherSize.descriptorCount = 1;
 
-		std::vector<VkDescriptorPoolSize> poolSizes = { dataSize, cloudShapeSize, cloudDetailSize, weatherSize };
+		VkDescriptorPoolSize weatherOccupancySize;
+		weatherOccupancySize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		weatherOccupancySize.descriptorCount = 1;
+
+		std::vector<VkDescriptorPoolSize> poolSizes = { dataSize, cloudShapeSize, cloudDetailSize, weatherSize, weatherOccupancySize };
 
 		VkDescriptorPoolCreateInfo descPoolCreateInfo;
 		descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -123,6 +198,11 @@ namespace en
 	}
 
 	CloudData::CloudData() :
+		CloudData(GenerateWeather())
+	{
+	}
+
+	CloudData::CloudData(const std::array<VecVecF, 4>& weather) :
 		m_CloudShapeTexture(
 			{ NoiseGenerator::Perlin3D(glm::uvec3(128, 32, 128), glm::vec3(0.0f), 1.0f / 48.0f, 0.0f, 1.0f),
 				NoiseGenerator::Worley3D(glm::uvec3(128, 32, 128), 16, true, 0.0f, 1.0f),
@@ -138,19 +218,24 @@ namespace en
 			VK_FILTER_LINEAR,
 			VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT),
 		m_WeatherTexture(
-			{ NoiseGenerator::Worley2D(glm::uvec2(256), 16, 0.0f, 1.0f),
-				NoiseGenerator::Perlin2D(glm::uvec2(256), glm::vec2(20.0f, 10.0f), 1.0f / 16.0f, 0.4f, 0.7f),
-				NoiseGenerator::Perlin2D(glm::uvec2(256), glm::vec2(10.0f, 30.0f), 1.0f / 16.0f, 0.0f, 0.3f),
-				NoiseGenerator::NoNoise2D(glm::uvec2(256), 1.0f) },
+			weather,
 			VK_FILTER_LINEAR,
 			VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT),
+		// same addressing as the weather texture, the cells are sampled as a whole.
+		m_WeatherOccupancyTexture(
+			GenerateWeatherOccupancy(weather),
+			VK_FILTER_NEAREST,
+			VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT),
 		m_UniformBuffer(new vk::Buffer(
 			sizeof(CloudUniformData),
 			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			{})),
 		m_SampleCounts({ 40, 4 }),
-		m_SampleCountsChanged(false)
+		m_SampleCountsChanged(false),
+		m_Resolution(0),
+		m_Temporal(false),
+		m_HistoryWeight(0.5f)
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 
@@ -169,6 +254,7 @@ namespace en
 		m_UniformData.jitterStrength = 1.0f;
 		m_UniformData.sigmaS = 0.5f;
 		m_UniformData.sigmaE = 0.35f;
+		m_UniformData.boundsMode = 0;
 
 		m_UniformBuffer->MapMemory(sizeof(CloudUniformData), &m_UniformData, 0, 0);
 
@@ -252,7 +338,24 @@ namespace en
 		weatherWrite.pBufferInfo = nullptr;
 		weatherWrite.pTexelBufferView = nullptr;
 
-		std::vector<VkWriteDescriptorSet> descWrites = { dataWrite, cloudShapeWrite, cloudDetailWrite, weatherWrite };
+		VkDescriptorImageInfo weatherOccupancyImageInfo;
+		weatherOccupancyImageInfo.sampler = m_WeatherOccupancyTexture.GetSampler();
+		weatherOccupancyImageInfo.imageView = m_WeatherOccupancyTexture.GetImageView();
+		weatherOccupancyImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet weatherOccupancyWrite;
+		weatherOccupancyWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		weatherOccupancyWrite.pNext = nullptr;
+		weatherOccupancyWrite.dstSet = m_DescriptorSet;
+		weatherOccupancyWrite.dstBinding = 4;
+		weatherOccupancyWrite.dstArrayElement = 0;
+		weatherOccupancyWrite.descriptorCount = 1;
+		weatherOccupancyWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		weatherOccupancyWrite.pImageInfo = &weatherOccupancyImageInfo;
+		weatherOccupancyWrite.pBufferInfo = nullptr;
+		weatherOccupancyWrite.pTexelBufferView = nullptr;
+
+		std::vector<VkWriteDescriptorSet> descWrites = { dataWrite, cloudShapeWrite, cloudDetailWrite, weatherWrite, weatherOccupancyWrite };
 
 		vkUpdateDescriptorSets(device, descWrites.size(), descWrites.data(), 0, nullptr);
 	}
@@ -262,6 +365,7 @@ namespace en
 		m_UniformBuffer->Destroy();
 		delete m_UniformBuffer;
 
+		m_WeatherOccupancyTexture.Destroy();
 		m_WeatherTexture.Destroy();
 		m_CloudDetailTexture.Destroy();
 		m_CloudShapeTexture.Destroy();
@@ -289,8 +393,14 @@ namespace en
 		ImGui::SliderFloat("Jitter Strength", &m_UniformData.jitterStrength, 0.0f, 1.0f);
 		ImGui::SliderFloat("Sigma S", &m_UniformData.sigmaS, 0.0f, 4.0f);
 		ImGui::SliderFloat("Sigma E", &m_UniformData.sigmaE, 0.0f, 4.0f);
+		const char* boundsModes[] = { "Analytic", "Sphere traced", "Difference" };
+		ImGui::Combo("Bounds", &m_UniformData.boundsMode, boundsModes, 3);
 		ImGui::SliderInt("Primary Sample Count", &m_SampleCounts.primary, 1, 128);
 		ImGui::SliderInt("Secondary Sample Count", &m_SampleCounts.secondary, 0, 8);
+		const char* resolutions[] = { "Full", "Half", "Quarter" };
+		ImGui::Combo("Resolution", &m_Resolution, resolutions, 3);
+		ImGui::Checkbox("Temporal", &m_Temporal);
+		ImGui::SliderFloat("History Weight", &m_HistoryWeight, 0.0f, 0.95f);
 		ImGui::End();
 
 		// Check if uniform data changed
@@ -311,6 +421,11 @@ namespace en
 		return m_DescriptorSet;
 	}
 
+	const CloudUniformData& CloudData::GetUniformData() const
+	{
+		return m_UniformData;
+	}
+
 	const CloudSampleCounts& CloudData::GetSampleCounts() const
 	{
 		return m_SampleCounts;
@@ -320,4 +435,24 @@ namespace en
 	{
 		return m_SampleCountsChanged;
 	}
+
+	uint32_t CloudData::GetResolutionDivisor() const
+	{
+		return 1u << m_Resolution;
+	}
+
+	bool CloudData::IsTemporal() const
+	{
+		return m_Temporal;
+	}
+
+	float CloudData::GetHistoryWeight() const
+	{
+		return m_HistoryWeight;
+	}
+
+	const glm::vec3& CloudData::GetSkySize() const
+	{
+		return m_UniformData.skySize;
+	}
 }
@@ -1,11 +1,23 @@
 #include <engine/graphics/renderer/CloudRenderer.hpp>
 #include <engine/graphics/VulkanAPI.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <imgui.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace en
 {
-	CloudRenderer::CloudRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const Wind* wind, const CloudData* cloudData, const Atmosphere* atmosphere, const Precomputer* precomp) :
+	// the statistics buffer is only compiled into the raymarching if fragment shaders may write it.
+	static std::vector<std::string> GetStatisticsDefines()
+	{
+		if (VulkanAPI::GetEnabledFeatures().fragmentStoresAndAtomics == VK_TRUE)
+			return { "SAMPLE_STATISTICS" };
+		return {};
+	}
+
+	CloudRenderer::CloudRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const Wind* wind, const CloudData* cloudData, const CloudShadow* cloudShadow, const Atmosphere* atmosphere, const Precomputer* precomp) :
 		m_Width(width),
 		m_Height(height),
 		m_Camera(camera),
@@ -13,10 +25,33 @@ namespace en
 		m_Wind(wind),
 		m_Precomputer(precomp),
 		m_CloudData(cloudData),
+		m_CloudShadow(cloudShadow),
 		m_Atmosphere(atmosphere),
 		m_VertShader("cloud/cloud.vert", false),
-		m_FragShader("cloud/cloud.frag", false),
-		m_DescriptorPool{VK_NULL_HANDLE}
+		m_FragShader("cloud/cloud.frag", false, GetStatisticsDefines()),
+		m_LowResFragShader("cloud/cloud_low_res.frag", false, GetStatisticsDefines()),
+		m_UpsampleFragShader("cloud/cloud_upsample.frag", false, GetStatisticsDefines()),
+		m_ResolveFragShader("cloud/cloud_resolve.frag", false),
+		m_DescriptorPool{VK_NULL_HANDLE},
+		m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetGraphicsQFI()),
+		m_LowResTarget{},
+		m_HistoryTargets{},
+		m_HistoryIndex{0},
+		m_HasHistory{false},
+		m_Frame{0},
+		m_LastRelativeProjView{1.0f},
+		m_LastCamPos{0.0f},
+		m_LastWindOffset{0.0f},
+		m_CompositeDescriptor{VK_NULL_HANDLE},
+		m_StatisticsSupported{VulkanAPI::GetEnabledFeatures().fragmentStoresAndAtomics == VK_TRUE},
+		m_StatisticsEnabled{false},
+		m_Statistics{},
+		m_StatisticsBuffer(
+			sizeof(CloudSampleStatistics),
+			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			{})
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 
@@ -39,20 +74,61 @@ namespace en
 		ASSERT_VULKAN(result);
 
 		// other
+		CreateLowResDescriptors(device);
+		CreateStatisticsDescriptors(device);
 		CreatePipelineLayout(device);
+
+		// the low-resolution target is created on first use, the render pass doesn't depend on its size.
+		m_CommandPool.AllocateBuffers(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		m_LowResCommandBuffer = m_CommandPool.GetBuffers()[0];
+		CreateRenderPass(device);
+		CreateMarchPipelines(m_LowResFragShader.GetVulkanModule(), m_LowResRenderPass, 0, 2, false, m_LowResPipeline, m_LowResBlendPipeline);
+
+		VkPipelineShaderStageCreateInfo resolveStageCreateInfo;
+		resolveStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		resolveStageCreateInfo.pNext = nullptr;
+		resolveStageCreateInfo.flags = 0;
+		resolveStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		resolveStageCreateInfo.module = m_ResolveFragShader.GetVulkanModule();
+		resolveStageCreateInfo.pName = "main";
+		resolveStageCreateInfo.pSpecializationInfo = nullptr;
+
+		m_ResolvePipeline = CreateQuadPipeline(resolveStageCreateInfo, m_ResolvePipelineLayout, m_LowResRenderPass, 0, 2, false);
 	}
 
 	void CloudRenderer::Destroy()
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 
+		m_CommandPool.Destroy();
+		DestroyTarget(device, m_LowResTarget);
+		DestroyTarget(device, m_HistoryTargets[0]);
+		DestroyTarget(device, m_HistoryTargets[1]);
+		vkDestroyRenderPass(device, m_LowResRenderPass, nullptr);
+
 		vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
 		vkDestroyPipeline(device, m_Pipeline, nullptr);
+		vkDestroyPipeline(device, m_BlendPipeline, nullptr);
+		vkDestroyPipeline(device, m_LowResPipeline, nullptr);
+		vkDestroyPipeline(device, m_LowResBlendPipeline, nullptr);
+		vkDestroyPipeline(device, m_UpsamplePipeline, nullptr);
+		vkDestroyPipeline(device, m_UpsampleBlendPipeline, nullptr);
+		vkDestroyPipelineLayout(device, m_ResolvePipelineLayout, nullptr);
+		vkDestroyPipeline(device, m_ResolvePipeline, nullptr);
 		m_VertShader.Destroy();
 		m_FragShader.Destroy();
+		m_LowResFragShader.Destroy();
+		m_UpsampleFragShader.Destroy();
+		m_ResolveFragShader.Destroy();
 
 		vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
 		vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, nullptr);
+		m_StatisticsBuffer.Destroy();
+		vkDestroyDescriptorPool(device, m_StatisticsDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_StatisticsDescriptorSetLayout, nullptr);
+		vkDestroySampler(device, m_LowResSampler, nullptr);
+		vkDestroyDescriptorPool(device, m_LowResDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_LowResDescriptorSetLayout, nullptr);
 	}
 
 	void CloudRenderer::Resize(uint32_t width, uint32_t height)
@@ -179,7 +255,18 @@ namespace en
 			m_Atmosphere->GetTransmittanceSampleDescriptorLayout(),
 			m_Precomputer->GetEffectiveEnvSetLayout(),
 			m_Precomputer->GetEffectiveEnvSetLayout(),
-			m_Precomputer->GetRatioDescriptorSetLayout() };
+			m_Precomputer->GetRatioDescriptorSetLayout(),
+			m_StatisticsDescriptorSetLayout,
+			m_CloudShadow->GetSampleDescriptorLayout(),
+			// the low-resolution clouds, only read by cloud_upsample.frag.
+			m_LowResDescriptorSetLayout };
+
+		// only used by cloud_low_res.frag, but compatible with the full-resolution subpass.
+		VkPushConstantRange pcRange = {
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.offset = 0,
+			.size = sizeof(CloudTemporalParams)
+		};
 
 		VkPipelineLayoutCreateInfo layoutCreateInfo;
 		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -187,11 +274,22 @@ namespace en
 		layoutCreateInfo.flags = 0;
 		layoutCreateInfo.setLayoutCount = descSetLayouts.size();
 		layoutCreateInfo.pSetLayouts = descSetLayouts.data();
-		layoutCreateInfo.pushConstantRangeCount = 0;
-		layoutCreateInfo.pPushConstantRanges = nullptr;
+		layoutCreateInfo.pushConstantRangeCount = 1;
+		layoutCreateInfo.pPushConstantRanges = &pcRange;
 
 		VkResult result = vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &m_PipelineLayout);
 		ASSERT_VULKAN(result);
+
+		// camera for reprojecting, this frame's march and the history.
+		std::vector<VkDescriptorSetLayout> resolveSetLayouts = {
+			Camera::GetDescriptorSetLayout(),
+			m_LowResDescriptorSetLayout,
+			m_LowResDescriptorSetLayout };
+		layoutCreateInfo.setLayoutCount = resolveSetLayouts.size();
+		layoutCreateInfo.pSetLayouts = resolveSetLayouts.data();
+
+		result = vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &m_ResolvePipelineLayout);
+		ASSERT_VULKAN(result);
 	}
 
 	void CloudRenderer::CreatePipeline(size_t subpass, VkRenderPass renderpass)
@@ -200,48 +298,87 @@ namespace en
 		// (Recreation only takes place after this is assigned).
 		m_Subpass = subpass;
 
-		VkDevice device = VulkanAPI::GetDevice();
-
-		// Vertex shader stage
-		VkPipelineShaderStageCreateInfo vertStageCreateInfo;
-		vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertStageCreateInfo.pNext = nullptr;
-		vertStageCreateInfo.flags = 0;
-		vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertStageCreateInfo.module = m_VertShader.GetVulkanModule();
-		vertStageCreateInfo.pName = "main";
-		vertStageCreateInfo.pSpecializationInfo = nullptr;
+		CreateMarchPipelines(m_FragShader.GetVulkanModule(), renderpass, subpass, 1, true, m_Pipeline, m_BlendPipeline);
+		// marches again where the geometry cuts the low-resolution clouds.
+		CreateMarchPipelines(m_UpsampleFragShader.GetVulkanModule(), renderpass, subpass, 1, true, m_UpsamplePipeline, m_UpsampleBlendPipeline);
+	}
 
+	void CloudRenderer::CreateMarchPipelines(
+		VkShaderModule fragModule,
+		VkRenderPass renderpass,
+		size_t subpass,
+		uint32_t colorAttachmentCount,
+		bool blend,
+		VkPipeline &pipeline,
+		VkPipeline &blendPipeline)
+	{
 		// Fragment shader stage
+		// sample counts, the LUT resolutions and LUT_BLEND, in one block.
+		struct FragSpecData {
+			CloudSampleCounts sampleCounts;
+			LutBlendSpecialization lut;
+		};
+
 		VkSpecializationMapEntry sampleCountMapEntry;
 		sampleCountMapEntry.constantID = 0;
-		sampleCountMapEntry.offset = offsetof(CloudSampleCounts, primary);
+		sampleCountMapEntry.offset = offsetof(FragSpecData, sampleCounts) + offsetof(CloudSampleCounts, primary);
 		sampleCountMapEntry.size = sizeof(CloudSampleCounts::primary);
 		
 		VkSpecializationMapEntry secondarySampleCountMapEntry;
 		secondarySampleCountMapEntry.constantID = 1;
-		secondarySampleCountMapEntry.offset = offsetof(CloudSampleCounts, secondary);
+		secondarySampleCountMapEntry.offset = offsetof(FragSpecData, sampleCounts) + offsetof(CloudSampleCounts, secondary);
 		secondarySampleCountMapEntry.size = sizeof(CloudSampleCounts::secondary);
 
-		std::vector<VkSpecializationMapEntry> fragSpecMapEntries = { sampleCountMapEntry, secondarySampleCountMapEntry };
+		std::vector<VkSpecializationMapEntry> fragSpecMapEntries = LutBlendSpecialization::GetSpecializationMapEntries(offsetof(FragSpecData, lut));
+		fragSpecMapEntries.push_back(sampleCountMapEntry);
+		fragSpecMapEntries.push_back(secondarySampleCountMapEntry);
 
-		CloudSampleCounts sampleCounts = m_CloudData->GetSampleCounts();
+		FragSpecData fragSpecData = {
+			m_CloudData->GetSampleCounts(),
+			{ m_Atmosphere->GetResolution(), VK_FALSE } };
 
 		VkSpecializationInfo fragSpecInfo;
 		fragSpecInfo.mapEntryCount = fragSpecMapEntries.size();
 		fragSpecInfo.pMapEntries = fragSpecMapEntries.data();
-		fragSpecInfo.dataSize = sizeof(CloudSampleCounts);
-		fragSpecInfo.pData = &sampleCounts;
+		fragSpecInfo.dataSize = sizeof(FragSpecData);
+		fragSpecInfo.pData = &fragSpecData;
 
 		VkPipelineShaderStageCreateInfo fragStageCreateInfo;
 		fragStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragStageCreateInfo.pNext = nullptr;
 		fragStageCreateInfo.flags = 0;
 		fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragStageCreateInfo.module = m_FragShader.GetVulkanModule();
+		fragStageCreateInfo.module = fragModule;
 		fragStageCreateInfo.pName = "main";
 		fragStageCreateInfo.pSpecializationInfo = &fragSpecInfo;
 
+		pipeline = CreateQuadPipeline(fragStageCreateInfo, m_PipelineLayout, renderpass, subpass, colorAttachmentCount, blend);
+
+		// same pipeline, but mixing both sum targets.
+		fragSpecData.lut.m_Blend = VK_TRUE;
+		blendPipeline = CreateQuadPipeline(fragStageCreateInfo, m_PipelineLayout, renderpass, subpass, colorAttachmentCount, blend);
+	}
+
+	VkPipeline CloudRenderer::CreateQuadPipeline(
+		const VkPipelineShaderStageCreateInfo &fragStageCreateInfo,
+		VkPipelineLayout layout,
+		VkRenderPass renderpass,
+		size_t subpass,
+		uint32_t colorAttachmentCount,
+		bool blend)
+	{
+		VkDevice device = VulkanAPI::GetDevice();
+
+		// Vertex shader stage
+		VkPipelineShaderStageCreateInfo vertStageCreateInfo;
+		vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertStageCreateInfo.pNext = nullptr;
+		vertStageCreateInfo.flags = 0;
+		vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertStageCreateInfo.module = m_VertShader.GetVulkanModule();
+		vertStageCreateInfo.pName = "main";
+		vertStageCreateInfo.pSpecializationInfo = nullptr;
+
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertStageCreateInfo, fragStageCreateInfo };
 
 		// Vertex input
@@ -329,7 +466,7 @@ namespace en
 
 		// Color blending
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
-		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.blendEnable = blend ? VK_TRUE : VK_FALSE;
 		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
 		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -337,6 +474,7 @@ namespace en
 		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(colorAttachmentCount, colorBlendAttachment);
 
 		VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo;
 		colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -344,8 +482,8 @@ namespace en
 		colorBlendCreateInfo.flags = 0;
 		colorBlendCreateInfo.logicOpEnable = VK_FALSE;
 		colorBlendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-		colorBlendCreateInfo.attachmentCount = 1;
-		colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
+		colorBlendCreateInfo.attachmentCount = colorBlendAttachments.size();
+		colorBlendCreateInfo.pAttachments = colorBlendAttachments.data();
 		colorBlendCreateInfo.blendConstants[0] = 0.0f;
 		colorBlendCreateInfo.blendConstants[1] = 0.0f;
 		colorBlendCreateInfo.blendConstants[2] = 0.0f;
@@ -377,16 +515,550 @@ namespace en
 		createInfo.pDepthStencilState = &depthStencilCreateInfo;
 		createInfo.pColorBlendState = &colorBlendCreateInfo;
 		createInfo.pDynamicState = &dynamicStateCreateInfo;
-		createInfo.layout = m_PipelineLayout;
+		createInfo.layout = layout;
 		createInfo.renderPass = renderpass;
 		createInfo.subpass = subpass;
 		createInfo.basePipelineHandle = VK_NULL_HANDLE;
 		createInfo.basePipelineIndex = -1;
 
-		VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_Pipeline);
+		VkPipeline pipeline;
+		VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
+		ASSERT_VULKAN(result);
+		return pipeline;
+	}
+
+	// order in which the pixels of a 4x4 block are marched, ordered dither.
+	static const glm::ivec2 BAYER_OFFSETS[16] = {
+		{0, 0}, {2, 2}, {2, 0}, {0, 2},
+		{1, 1}, {3, 3}, {3, 1}, {1, 3},
+		{1, 0}, {3, 2}, {3, 0}, {1, 2},
+		{0, 1}, {2, 3}, {2, 1}, {0, 3} };
+
+	void CloudRenderer::Render(VkQueue queue)
+	{
+		VkDevice device = VulkanAPI::GetDevice();
+
+		// counted from scratch by this frame's raymarching.
+		CloudSampleStatistics statistics {};
+		statistics.m_Enabled = m_StatisticsEnabled ? 1 : 0;
+		m_StatisticsBuffer.MapMemory(sizeof(CloudSampleStatistics), &statistics, 0, 0);
+
+		// Specialization constants
+		if (m_CloudData->HaveSampleCountsChanged())
+		{
+			vkDestroyPipeline(device, m_LowResPipeline, nullptr);
+			vkDestroyPipeline(device, m_LowResBlendPipeline, nullptr);
+			CreateMarchPipelines(m_LowResFragShader.GetVulkanModule(), m_LowResRenderPass, 0, 2, false, m_LowResPipeline, m_LowResBlendPipeline);
+		}
+
+		// full resolution without accumulation is raymarched in the subpass.
+		uint32_t divisor = m_CloudData->GetResolutionDivisor();
+		bool temporal = m_CloudData->IsTemporal();
+		m_CompositeDescriptor = VK_NULL_HANDLE;
+		if (divisor == 1 && !temporal)
+		{
+			m_HasHistory = false;
+			return;
+		}
+
+		// round up, the upsample may fetch the last texel.
+		uint32_t width = (m_Width + divisor-1)/divisor;
+		uint32_t height = (m_Height + divisor-1)/divisor;
+		int32_t blockSize = temporal ? 4 : 1;
+		uint32_t marchWidth = (width + blockSize-1)/blockSize;
+		uint32_t marchHeight = (height + blockSize-1)/blockSize;
+
+		if (m_LowResTarget.m_Width != marchWidth || m_LowResTarget.m_Height != marchHeight)
+			CreateTarget(device, m_LowResTarget, marchWidth, marchHeight);
+		if (!temporal)
+		{
+			// keep the memory only while accumulating.
+			DestroyTarget(device, m_HistoryTargets[0]);
+			DestroyTarget(device, m_HistoryTargets[1]);
+			m_HasHistory = false;
+		}
+		else if (m_HistoryTargets[0].m_Width != width || m_HistoryTargets[0].m_Height != height)
+		{
+			CreateTarget(device, m_HistoryTargets[0], width, height);
+			CreateTarget(device, m_HistoryTargets[1], width, height);
+			m_HasHistory = false;
+		}
+
+		glm::vec3 camPos = m_Camera->GetPos();
+		// the weather texture coordinates are wrapped, so is the offset.
+		glm::vec2 windDelta = m_Wind->GetOffset() - m_LastWindOffset;
+		windDelta -= glm::round(windDelta);
+		glm::vec3 skySize = m_CloudData->GetSkySize();
+		CloudTemporalParams params {
+			// previous camera, moved to the current position.
+			.m_PrevProjView = m_LastRelativeProjView * glm::translate(glm::mat4(1), camPos - m_LastCamPos),
+			// the clouds move opposite to the offset.
+			.m_WindShift = glm::vec3(windDelta.x * skySize.x, 0.0f, windDelta.y * skySize.z),
+			.m_HistoryWeight = m_CloudData->GetHistoryWeight(),
+			.m_PixelOffset = temporal ? BAYER_OFFSETS[m_Frame % 16] : glm::ivec2(0),
+			.m_TargetSize = temporal ? glm::ivec2(width, height) : glm::ivec2(marchWidth, marchHeight),
+			.m_BlockSize = blockSize,
+			// constant jitter without accumulation, it would flicker otherwise.
+			.m_Frame = temporal ? int32_t(m_Frame) : 0,
+			.m_HasHistory = m_HasHistory ? 1 : 0,
+			._padding = 0
+		};
+
+		VkCommandBufferBeginInfo beginInfo {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = nullptr
+		};
+		ASSERT_VULKAN(vkBeginCommandBuffer(m_LowResCommandBuffer, &beginInfo));
+
+		BeginTarget(m_LowResTarget);
+
+		size_t state = m_Precomputer->GetSumTargetState();
+		vkCmdBindPipeline(m_LowResCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			state == SUM_TARGET_STATE_BLEND ? m_LowResBlendPipeline : m_LowResPipeline);
+
+		// set 3 (geometry depth) and set 14 (this target) are unused by cloud_low_res.frag and stay unbound.
+		std::vector<VkDescriptorSet> descSets = GetMarchDescriptorSets(VK_NULL_HANDLE);
+		vkCmdBindDescriptorSets(m_LowResCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 3, descSets.data(), 0, nullptr);
+		vkCmdBindDescriptorSets(m_LowResCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 4, descSets.size()-4, descSets.data()+4, 0, nullptr);
+		vkCmdPushConstants(m_LowResCommandBuffer, m_PipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(CloudTemporalParams), &params);
+		vkCmdDraw(m_LowResCommandBuffer, 6, 1, 0, 0);
+
+		vkCmdEndRenderPass(m_LowResCommandBuffer);
+		m_CompositeDescriptor = m_LowResTarget.m_SampleDescriptor;
+
+		if (temporal)
+		{
+			// the render pass dependency orders the resolve after the march.
+			const Target &target = m_HistoryTargets[m_HistoryIndex];
+			BeginTarget(target);
+
+			// the other target isn't written yet without history, it's not read then either.
+			std::vector<VkDescriptorSet> resolveSets = {
+				m_Camera->GetDescriptorSet(),
+				m_LowResTarget.m_SampleDescriptor,
+				m_HasHistory ? m_HistoryTargets[1 - m_HistoryIndex].m_SampleDescriptor : m_LowResTarget.m_SampleDescriptor };
+			vkCmdBindPipeline(m_LowResCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ResolvePipeline);
+			vkCmdBindDescriptorSets(m_LowResCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ResolvePipelineLayout, 0, resolveSets.size(), resolveSets.data(), 0, nullptr);
+			vkCmdPushConstants(m_LowResCommandBuffer, m_ResolvePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(CloudTemporalParams), &params);
+			vkCmdDraw(m_LowResCommandBuffer, 6, 1, 0, 0);
+
+			vkCmdEndRenderPass(m_LowResCommandBuffer);
+			m_CompositeDescriptor = target.m_SampleDescriptor;
+
+			m_HistoryIndex = 1 - m_HistoryIndex;
+			m_HasHistory = true;
+		}
+
+		ASSERT_VULKAN(vkEndCommandBuffer(m_LowResCommandBuffer));
+
+		m_Frame++;
+		m_LastRelativeProjView = m_Camera->GetRelativeProjView();
+		m_LastCamPos = camPos;
+		m_LastWindOffset = m_Wind->GetOffset();
+
+		VkSubmitInfo submitInfo;
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = nullptr;
+		submitInfo.waitSemaphoreCount = 0;
+		submitInfo.pWaitSemaphores = nullptr;
+		submitInfo.pWaitDstStageMask = nullptr;
+		submitInfo.signalSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = nullptr;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_LowResCommandBuffer;
+
+		// same queue as the frame, the render pass dependency orders the upsample after it.
+		ASSERT_VULKAN(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
+
+	void CloudRenderer::RenderImgui()
+	{
+		ImGui::Begin("Cloud Renderer");
+		if (!m_StatisticsSupported)
+			ImGui::Text("Sample statistics need fragmentStoresAndAtomics");
+		else
+		{
+			ImGui::Checkbox("Sample statistics", &m_StatisticsEnabled);
+			if (m_StatisticsEnabled)
+			{
+				// the frames are waited for, the last one is complete.
+				m_StatisticsBuffer.GetData(sizeof(CloudSampleStatistics), &m_Statistics, 0, 0);
+				float rays = std::max(m_Statistics.m_Rays, 1u);
+				ImGui::Text("Rays: %u", m_Statistics.m_Rays);
+				ImGui::Text("Density samples per ray: %.2f", m_Statistics.m_DensitySamples / rays);
+				ImGui::Text("Skipped samples per ray: %.2f", m_Statistics.m_SkippedSamples / rays);
+			}
+		}
+		ImGui::End();
+	}
+
+	void CloudRenderer::BeginTarget(const Target &target)
+	{
+		// transmittance 1, nothing in front of the geometry.
+		std::array<VkClearValue, 2> clearValues;
+		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		clearValues[1].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		VkRenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.pNext = nullptr;
+		renderPassBeginInfo.renderPass = m_LowResRenderPass;
+		renderPassBeginInfo.framebuffer = target.m_Framebuffer;
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = { target.m_Width, target.m_Height };
+		renderPassBeginInfo.clearValueCount = clearValues.size();
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(m_LowResCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport;
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(target.m_Width);
+		viewport.height = static_cast<float>(target.m_Height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(m_LowResCommandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor;
+		scissor.offset = { 0, 0 };
+		scissor.extent = { target.m_Width, target.m_Height };
+		vkCmdSetScissor(m_LowResCommandBuffer, 0, 1, &scissor);
+	}
+
+	void CloudRenderer::CreateRenderPass(VkDevice device)
+	{
+		// premultiplied color and transmittance, distance to the front of the cloud.
+		std::array<VkAttachmentDescription, 2> attachments;
+		attachments[0].flags = 0;
+		attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachments[1] = attachments[0];
+		attachments[1].format = VK_FORMAT_R32_SFLOAT;
+
+		std::array<VkAttachmentReference, 2> colorAttachmentReferences;
+		colorAttachmentReferences[0].attachment = 0;
+		colorAttachmentReferences[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachmentReferences[1].attachment = 1;
+		colorAttachmentReferences[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass;
+		subpass.flags = 0;
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.inputAttachmentCount = 0;
+		subpass.pInputAttachments = nullptr;
+		subpass.colorAttachmentCount = colorAttachmentReferences.size();
+		subpass.pColorAttachments = colorAttachmentReferences.data();
+		subpass.pResolveAttachments = nullptr;
+		subpass.pDepthStencilAttachment = nullptr;
+		subpass.preserveAttachmentCount = 0;
+		subpass.pPreserveAttachments = nullptr;
+
+		// the previous frame's upsample reads the target, this frame's upsample waits for it.
+		std::array<VkSubpassDependency, 2> subpassDependencies;
+		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		subpassDependencies[0].dstSubpass = 0;
+		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subpassDependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[0].dependencyFlags = 0;
+		subpassDependencies[1].srcSubpass = 0;
+		subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		subpassDependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo createInfo;
+		createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		createInfo.pNext = nullptr;
+		createInfo.flags = 0;
+		createInfo.attachmentCount = attachments.size();
+		createInfo.pAttachments = attachments.data();
+		createInfo.subpassCount = 1;
+		createInfo.pSubpasses = &subpass;
+		createInfo.dependencyCount = subpassDependencies.size();
+		createInfo.pDependencies = subpassDependencies.data();
+
+		VkResult result = vkCreateRenderPass(device, &createInfo, nullptr, &m_LowResRenderPass);
 		ASSERT_VULKAN(result);
 	}
 
+	void CloudRenderer::CreateStatisticsDescriptors(VkDevice device)
+	{
+		VkDescriptorSetLayoutBinding binding;
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo;
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.pNext = nullptr;
+		layoutCreateInfo.flags = 0;
+		layoutCreateInfo.bindingCount = 1;
+		layoutCreateInfo.pBindings = &binding;
+		ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_StatisticsDescriptorSetLayout));
+
+		VkDescriptorPoolSize poolSize {
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1
+		};
+
+		VkDescriptorPoolCreateInfo poolCreateInfo;
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.pNext = nullptr;
+		poolCreateInfo.flags = 0;
+		poolCreateInfo.maxSets = 1;
+		poolCreateInfo.poolSizeCount = 1;
+		poolCreateInfo.pPoolSizes = &poolSize;
+		ASSERT_VULKAN(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &m_StatisticsDescriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.descriptorPool = m_StatisticsDescriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &m_StatisticsDescriptorSetLayout
+		};
+		ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, &m_StatisticsDescriptorSet));
+
+		VkDescriptorBufferInfo bufferInfo {
+			.buffer = m_StatisticsBuffer.GetVulkanHandle(),
+			.offset = 0,
+			.range = sizeof(CloudSampleStatistics)
+		};
+		VkWriteDescriptorSet write {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = m_StatisticsDescriptorSet,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = nullptr,
+			.pBufferInfo = &bufferInfo,
+			.pTexelBufferView = nullptr
+		};
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	void CloudRenderer::CreateLowResDescriptors(VkDevice device)
+	{
+		// the upsample weighs the texels itself, linear filtering would mix clouds across geometry edges.
+		VkSamplerCreateInfo sampler;
+		sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler.pNext = nullptr;
+		sampler.magFilter = VK_FILTER_NEAREST;
+		sampler.minFilter = VK_FILTER_NEAREST;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.mipLodBias = 0.0f;
+		sampler.anisotropyEnable = VK_FALSE;
+		sampler.maxAnisotropy = 1.0f;
+		sampler.compareEnable = VK_FALSE;
+		sampler.compareOp = VK_COMPARE_OP_NEVER;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = 1;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		sampler.unnormalizedCoordinates = VK_FALSE;
+		sampler.flags = 0;
+		ASSERT_VULKAN(vkCreateSampler(device, &sampler, nullptr, &m_LowResSampler));
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings;
+		for (uint32_t i = 0; i != bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo;
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.pNext = nullptr;
+		layoutCreateInfo.flags = 0;
+		layoutCreateInfo.bindingCount = bindings.size();
+		layoutCreateInfo.pBindings = bindings.data();
+		ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_LowResDescriptorSetLayout));
+
+		// the march target and both accumulation targets.
+		const uint32_t setCount = 3;
+		VkDescriptorPoolSize poolSize {
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = static_cast<uint32_t>(setCount * bindings.size())
+		};
+
+		VkDescriptorPoolCreateInfo poolCreateInfo;
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.pNext = nullptr;
+		poolCreateInfo.flags = 0;
+		poolCreateInfo.maxSets = setCount;
+		poolCreateInfo.poolSizeCount = 1;
+		poolCreateInfo.pPoolSizes = &poolSize;
+		ASSERT_VULKAN(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &m_LowResDescriptorPool));
+
+		std::array<VkDescriptorSetLayout, setCount> allocLayouts;
+		allocLayouts.fill(m_LowResDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.descriptorPool = m_LowResDescriptorPool,
+			.descriptorSetCount = setCount,
+			.pSetLayouts = allocLayouts.data()
+		};
+		std::array<VkDescriptorSet, setCount> sets;
+		ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+		m_LowResTarget.m_SampleDescriptor = sets[0];
+		m_HistoryTargets[0].m_SampleDescriptor = sets[1];
+		m_HistoryTargets[1].m_SampleDescriptor = sets[2];
+	}
+
+	void CloudRenderer::CreateTarget(VkDevice device, Target &target, uint32_t width, uint32_t height)
+	{
+		DestroyTarget(device, target);
+
+		target.m_Width = width;
+		target.m_Height = height;
+
+		const std::array<VkFormat, 2> formats = { VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32_SFLOAT };
+		for (size_t i = 0; i != formats.size(); ++i) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = target.m_Width;
+			imageInfo.extent.height = target.m_Height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = formats[i];
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &target.m_Images[i]));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, target.m_Images[i], &memReqs);
+
+			VkMemoryAllocateInfo memAllocInfo;
+			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memAllocInfo.pNext = nullptr;
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
+										   memReqs.memoryTypeBits,
+										   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &target.m_ImageMemory[i]));
+			ASSERT_VULKAN(vkBindImageMemory(device, target.m_Images[i], target.m_ImageMemory[i], 0));
+
+			VkImageViewCreateInfo imageViewCreateInfo;
+			imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewCreateInfo.pNext = nullptr;
+			imageViewCreateInfo.image = target.m_Images[i];
+			imageViewCreateInfo.flags = 0;
+			imageViewCreateInfo.format = formats[i];
+			imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageViewCreateInfo.subresourceRange.levelCount = 1;
+			imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+			imageViewCreateInfo.subresourceRange.layerCount = 1;
+			imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+			ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &target.m_ImageViews[i]));
+		}
+
+		VkFramebufferCreateInfo framebufferCreateInfo;
+		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferCreateInfo.pNext = nullptr;
+		framebufferCreateInfo.flags = 0;
+		framebufferCreateInfo.renderPass = m_LowResRenderPass;
+		framebufferCreateInfo.attachmentCount = target.m_ImageViews.size();
+		framebufferCreateInfo.pAttachments = target.m_ImageViews.data();
+		framebufferCreateInfo.width = target.m_Width;
+		framebufferCreateInfo.height = target.m_Height;
+		framebufferCreateInfo.layers = 1;
+		ASSERT_VULKAN(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &target.m_Framebuffer));
+
+		std::array<VkDescriptorImageInfo, 2> imageInfos;
+		std::array<VkWriteDescriptorSet, 2> writes;
+		for (uint32_t i = 0; i != imageInfos.size(); ++i) {
+			imageInfos[i] = {
+				.sampler = m_LowResSampler,
+				.imageView = target.m_ImageViews[i],
+				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			};
+			writes[i] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = target.m_SampleDescriptor,
+				.dstBinding = i,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &imageInfos[i],
+				.pBufferInfo = nullptr,
+				.pTexelBufferView = nullptr
+			};
+		}
+		vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	}
+
+	void CloudRenderer::DestroyTarget(VkDevice device, Target &target)
+	{
+		vkDestroyFramebuffer(device, target.m_Framebuffer, nullptr);
+		target.m_Framebuffer = VK_NULL_HANDLE;
+		for (size_t i = 0; i != target.m_Images.size(); ++i) {
+			vkDestroyImageView(device, target.m_ImageViews[i], nullptr);
+			vkFreeMemory(device, target.m_ImageMemory[i], nullptr);
+			vkDestroyImage(device, target.m_Images[i], nullptr);
+			target.m_ImageViews[i] = VK_NULL_HANDLE;
+			target.m_ImageMemory[i] = VK_NULL_HANDLE;
+			target.m_Images[i] = VK_NULL_HANDLE;
+		}
+		target.m_Width = 0;
+		target.m_Height = 0;
+	}
+
+	std::vector<VkDescriptorSet> CloudRenderer::GetMarchDescriptorSets(VkDescriptorSet geometryDepthSet) const
+	{
+		// outside of blends the visible sum target is bound as target 0.
+		size_t state = m_Precomputer->GetSumTargetState();
+		size_t target0 = Precomputer::GetBoundSumTarget(state, 0);
+		size_t target1 = Precomputer::GetBoundSumTarget(state, 1);
+		return {
+			m_Camera->GetDescriptorSet(),
+			m_Sun->GetDescriptorSet(),
+			m_CloudData->GetDescriptorSet(),
+			geometryDepthSet,
+			m_Wind->GetDescriptorSet(),
+			m_Atmosphere->GetScatteringSampleDescriptorSet(target0),
+			m_Atmosphere->GetScatteringSampleDescriptorSet(target1),
+			m_Atmosphere->GetTransmittanceSampleDescriptorSet(target0),
+			m_Atmosphere->GetTransmittanceSampleDescriptorSet(target1),
+			m_Precomputer->GetEffectiveEnvSet(target0),
+			m_Precomputer->GetEffectiveEnvSet(target1),
+			m_Precomputer->GetRatioDescriptorSet(),
+			m_StatisticsDescriptorSet,
+			m_CloudShadow->GetSampleDescriptorSet() };
+	}
+
 	void CloudRenderer::RecordFrameCommandBuffer(VkCommandBuffer buf, size_t frame_indx)
 	{
 		// Specialization constants
@@ -395,12 +1067,12 @@ namespace en
 			// Recreate pipline
 			VkDevice device = VulkanAPI::GetDevice();
 			vkDestroyPipeline(device, m_Pipeline, nullptr);
+			vkDestroyPipeline(device, m_BlendPipeline, nullptr);
+			vkDestroyPipeline(device, m_UpsamplePipeline, nullptr);
+			vkDestroyPipeline(device, m_UpsampleBlendPipeline, nullptr);
 			CreatePipeline(m_Subpass, m_RenderPass);
 		}
 
-		// Bind pipeline
-		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
-
 		// Viewport
 		VkViewport viewport;
 		viewport.x = 0.0f;
@@ -419,20 +1091,23 @@ namespace en
 
 		vkCmdSetScissor(buf, 0, 1, &scissor);
 
+		bool blend = m_Precomputer->GetSumTargetState() == SUM_TARGET_STATE_BLEND;
+		std::vector<VkDescriptorSet> descSets = GetMarchDescriptorSets(m_DescriptorSets[frame_indx]);
+
+		// Render() filled the low-resolution target this frame, composite it and march only where the geometry cuts it.
+		if (m_CompositeDescriptor != VK_NULL_HANDLE)
+		{
+			descSets.push_back(m_CompositeDescriptor);
+			vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, blend ? m_UpsampleBlendPipeline : m_UpsamplePipeline);
+			vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
+			vkCmdDraw(buf, 6, 1, 0, 0);
+			return;
+		}
+
+		// Bind pipeline
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, blend ? m_BlendPipeline : m_Pipeline);
+
 		// Draw
-		std::vector<VkDescriptorSet> descSets = { 
-			m_Camera->GetDescriptorSet(), 
-			m_Sun->GetDescriptorSet(),
-			m_CloudData->GetDescriptorSet(),
-			m_DescriptorSets[frame_indx],
-			m_Wind->GetDescriptorSet(),
-			m_Atmosphere->GetScatteringSampleDescriptorSet(0),
-			m_Atmosphere->GetScatteringSampleDescriptorSet(1),
-			m_Atmosphere->GetTransmittanceSampleDescriptorSet(0),
-			m_Atmosphere->GetTransmittanceSampleDescriptorSet(1),
-			m_Precomputer->GetEffectiveEnvSet(0),
-			m_Precomputer->GetEffectiveEnvSet(1),
-			m_Precomputer->GetRatioDescriptorSet() };
 		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
 		vkCmdDraw(buf, 6, 1, 0, 0);
 	}
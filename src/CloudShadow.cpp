@@ -0,0 +1,487 @@
+#include <cmath>
+#include <set>
+#include <vulkan/vulkan_core.h>
+#include "engine/graphics/CloudShadow.hpp"
+#include "engine/graphics/VulkanAPI.hpp"
+#include <imgui.h>
+
+#include "cloud_shadow.h"
+
+namespace en {
+
+CloudShadow::CloudShadow(const Sun &sun, const Wind &wind, const CloudData &cloudData) :
+	m_Sun{sun},
+	m_Wind{wind},
+	m_CloudData{cloudData},
+	m_Shader("cloud/cloud_shadow.comp", false),
+	m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetComputeQFI()),
+	m_HasInputs{false},
+	m_LastWindOffset{0.0f},
+	m_Updated{false},
+	m_UniformData{
+		.m_BoxMin = glm::vec3(0.0f),
+		.m_TerrainStrength = 0.8f,
+		.m_BoxSize = glm::vec3(1.0f),
+		.m_UseInClouds = 1,
+		.m_WindShift = glm::vec2(0.0f) },
+	m_UniformBuffer(
+		sizeof(CloudShadowUniformData),
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		{}) {
+
+	VkDevice device = VulkanAPI::GetDevice();
+	// one buffer for compute, one for transitioning the image in CreateComputeImage.
+	m_CommandPool.AllocateBuffers(2, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	m_ComputeCommandBuffer = m_CommandPool.GetBuffers()[0];
+	m_LayoutCommandBuffer = m_CommandPool.GetBuffers()[1];
+
+	m_UniformBuffer.MapMemory(sizeof(CloudShadowUniformData), &m_UniformData, 0, 0);
+
+	CreateComputeImage(device);
+	CreateDescriptors(device);
+	CreateComputePipeline(device);
+	RecordCommandBuffer();
+}
+
+CloudShadow::~CloudShadow() {
+	VkDevice device = VulkanAPI::GetDevice();
+
+	m_CommandPool.Destroy();
+	m_UniformBuffer.Destroy();
+
+	vkFreeMemory(device, m_ImageMemory, nullptr);
+	vkDestroyImage(device, m_Image, nullptr);
+	vkDestroyImageView(device, m_ImageView, nullptr);
+
+	vkDestroySampler(device, m_LinearSampler, nullptr);
+	vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_ImageDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_SampleDescriptorLayout, nullptr);
+
+	vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
+	vkDestroyPipeline(device, m_Pipeline, nullptr);
+
+	m_Shader.Destroy();
+}
+
+void CloudShadow::CreateComputeImage(VkDevice device) {
+	std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()};
+	// vector for contiguous memory.
+	std::vector<uint32_t> qvec{queues.begin(), queues.end()};
+
+	// written in cloud_shadow.comp, sampled by the clouds and the materials.
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_3D;
+	imageInfo.extent.width = CLOUD_SHADOW_X;
+	imageInfo.extent.height = CLOUD_SHADOW_Y;
+	imageInfo.extent.depth = CLOUD_SHADOW_Z;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	// storage and linear filtering are guaranteed, unlike for the single-channel formats.
+	imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	// will only be accessed by one queue at a time (for now).
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = qvec.size();
+	imageInfo.pQueueFamilyIndices = qvec.data();
+
+	ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &m_Image));
+
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, m_Image, &memReqs);
+
+	VkMemoryAllocateInfo memAllocInfo;
+	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.pNext = nullptr;
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
+								   memReqs.memoryTypeBits,
+								   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &m_ImageMemory));
+	ASSERT_VULKAN(vkBindImageMemory(device, m_Image, m_ImageMemory, 0));
+
+	VkImageViewCreateInfo imageViewCreateInfo;
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.pNext = nullptr;
+	imageViewCreateInfo.image = m_Image;
+	imageViewCreateInfo.flags = 0;
+	imageViewCreateInfo.format = imageInfo.format;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+	imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.levelCount = 1;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+	imageViewCreateInfo.subresourceRange.layerCount = 1;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_ImageView));
+
+	VkImageMemoryBarrier imageMemoryBarrier;
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.pNext = nullptr;
+	imageMemoryBarrier.image = m_Image;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_NONE_KHR;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+
+	VkCommandBufferBeginInfo beginInfo {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.pInheritanceInfo = nullptr
+	};
+
+	ASSERT_VULKAN(vkBeginCommandBuffer(m_LayoutCommandBuffer, &beginInfo));
+
+	vkCmdPipelineBarrier(
+		m_LayoutCommandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &imageMemoryBarrier);
+
+	ASSERT_VULKAN(vkEndCommandBuffer(m_LayoutCommandBuffer));
+
+	VkSubmitInfo submitInfo;
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_LayoutCommandBuffer;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+
+	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+	// wait for completion.
+	ASSERT_VULKAN(vkQueueWaitIdle(VulkanAPI::GetComputeQueue()));
+}
+
+void CloudShadow::CreateDescriptors(VkDevice device) {
+	std::vector<VkDescriptorPoolSize> poolSizes {{
+			// read from texture in fragment.
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1
+		}, {
+			// box and settings, read in fragment.
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1
+		}, {
+			// write to texture in compute.
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1
+		}
+	};
+
+	VkDescriptorPoolCreateInfo descPoolCreateInfo;
+	descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolCreateInfo.pNext = nullptr;
+	descPoolCreateInfo.flags = 0;
+	descPoolCreateInfo.maxSets = 2;
+	descPoolCreateInfo.poolSizeCount = poolSizes.size();
+	descPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+	ASSERT_VULKAN(vkCreateDescriptorPool(device, &descPoolCreateInfo, nullptr, &m_DescriptorPool));
+
+	// the sample set is only bound by fragment shaders: cloud.frag, cloud_low_res.frag and cloud_upsample.frag
+	// (CloudRenderer), simple_material(_sh).frag (SimpleModelRenderer). cloud_shadow.comp only uses the image set.
+	std::vector<VkDescriptorSetLayoutBinding> sampleBindings {{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			// sample in fragment.
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr,
+		}, {
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr,
+		}
+	};
+
+	VkDescriptorSetLayoutBinding imageBinding {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		// write in compute.
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr,
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo;
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = nullptr;
+	layoutCreateInfo.flags = 0;
+
+	layoutCreateInfo.bindingCount = sampleBindings.size();
+	layoutCreateInfo.pBindings = sampleBindings.data();
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_SampleDescriptorLayout));
+
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &imageBinding;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_ImageDescriptorLayout));
+
+	VkSamplerCreateInfo sampler;
+	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler.pNext = nullptr;
+	sampler.magFilter = VK_FILTER_LINEAR;
+	sampler.minFilter = VK_FILTER_LINEAR;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	// the outermost texels continue to the faces of the box.
+	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.mipLodBias = 0.0f;
+	sampler.anisotropyEnable = VK_FALSE;
+	sampler.maxAnisotropy = 1.0f;
+	sampler.compareEnable = VK_FALSE;
+	sampler.compareOp = VK_COMPARE_OP_NEVER;
+	sampler.minLod = 0.0f;
+	sampler.maxLod = 1;
+	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	sampler.unnormalizedCoordinates = VK_FALSE;
+	sampler.flags = 0;
+	ASSERT_VULKAN(vkCreateSampler(device, &sampler, nullptr, &m_LinearSampler));
+
+	std::vector<VkDescriptorSetLayout> allocLayouts = {m_SampleDescriptorLayout, m_ImageDescriptorLayout};
+
+	VkDescriptorSetAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = m_DescriptorPool,
+		.descriptorSetCount = static_cast<uint32_t>(allocLayouts.size()),
+		.pSetLayouts = allocLayouts.data()
+	};
+
+	VkDescriptorSet allocTarget[2];
+	ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, allocTarget));
+
+	m_SampleDescriptor = allocTarget[0];
+	m_ImageDescriptor = allocTarget[1];
+
+	VkDescriptorImageInfo texInfo {
+		.sampler = m_LinearSampler,
+		.imageView = m_ImageView,
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+	};
+
+	VkDescriptorBufferInfo bufferInfo {
+		.buffer = m_UniformBuffer.GetVulkanHandle(),
+		.offset = 0,
+		.range = sizeof(CloudShadowUniformData)
+	};
+
+	std::vector<VkWriteDescriptorSet> writeDescSets(3, VkWriteDescriptorSet{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.pImageInfo = &texInfo,
+		.pBufferInfo = nullptr,
+		.pTexelBufferView = nullptr
+	});
+
+	writeDescSets[0].dstSet = m_SampleDescriptor;
+	writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	writeDescSets[1].dstSet = m_SampleDescriptor;
+	writeDescSets[1].dstBinding = 1;
+	writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeDescSets[1].pImageInfo = nullptr;
+	writeDescSets[1].pBufferInfo = &bufferInfo;
+
+	writeDescSets[2].dstSet = m_ImageDescriptor;
+	writeDescSets[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+	vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+}
+
+void CloudShadow::CreateComputePipeline(VkDevice device) {
+	std::vector<VkDescriptorSetLayout> layouts(4);
+	layouts[CS_SETS_IMAGE] = m_ImageDescriptorLayout;
+	layouts[CS_SETS_SUN] = m_Sun.GetDescriptorSetLayout();
+	layouts[CS_SETS_CLOUD_DATA] = CloudData::GetDescriptorSetLayout();
+	layouts[CS_SETS_WIND] = Wind::GetDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo layoutCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.setLayoutCount = static_cast<uint32_t>(layouts.size()),
+		.pSetLayouts = layouts.data(),
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+	ASSERT_VULKAN(vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &m_PipelineLayout));
+
+	VkPipelineShaderStageCreateInfo compStageCreateInfo;
+	compStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compStageCreateInfo.pNext = nullptr;
+	compStageCreateInfo.flags = 0;
+	compStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compStageCreateInfo.module = m_Shader.GetVulkanModule();
+	compStageCreateInfo.pName = "main";
+	compStageCreateInfo.pSpecializationInfo = nullptr;
+
+	VkComputePipelineCreateInfo pipeline;
+	pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline.pNext = nullptr;
+	pipeline.flags = 0;
+	pipeline.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline.stage = compStageCreateInfo;
+	pipeline.layout = m_PipelineLayout;
+
+	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_Pipeline));
+}
+
+void CloudShadow::RecordCommandBuffer() {
+	VkCommandBufferBeginInfo beginInfo;
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	VkCommandBuffer buf = m_ComputeCommandBuffer;
+	ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
+
+	vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+
+	std::vector<VkDescriptorSet> sets(4);
+	sets[CS_SETS_IMAGE] = m_ImageDescriptor;
+	sets[CS_SETS_SUN] = m_Sun.GetDescriptorSet();
+	sets[CS_SETS_CLOUD_DATA] = m_CloudData.GetDescriptorSet();
+	sets[CS_SETS_WIND] = m_Wind.GetDescriptorSet();
+
+	vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+
+	// one invocation per texel.
+	vkCmdDispatch(buf,
+		(CLOUD_SHADOW_X + CLOUD_SHADOW_GROUP_SIZE-1)/CLOUD_SHADOW_GROUP_SIZE,
+		(CLOUD_SHADOW_Y + CLOUD_SHADOW_GROUP_SIZE-1)/CLOUD_SHADOW_GROUP_SIZE,
+		(CLOUD_SHADOW_Z + CLOUD_SHADOW_GROUP_SIZE-1)/CLOUD_SHADOW_GROUP_SIZE);
+
+	// the volume is read by fragment shaders of later submissions.
+	VkImageMemoryBarrier imageMemoryBarrier;
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.pNext = nullptr;
+	imageMemoryBarrier.image = m_Image;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+
+	vkCmdPipelineBarrier(
+		buf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &imageMemoryBarrier);
+
+	ASSERT_VULKAN(vkEndCommandBuffer(buf));
+}
+
+void CloudShadow::Compute() {
+	const glm::vec3 &sunDir = m_Sun.GetData().m_SunDir;
+	const CloudUniformData &cloudData = m_CloudData.GetUniformData();
+
+	// the wind changes every frame, the weather moves by the offset (in x and z of the sky box).
+	// Wrapping the offset in Wind::Update also counts as a large movement.
+	glm::vec2 windShift = m_Wind.GetOffset() - m_LastWindOffset;
+	bool windMoved =
+		std::abs(windShift.x) * CLOUD_SHADOW_X > CLOUD_SHADOW_MAX_WIND_SHIFT ||
+		std::abs(windShift.y) * CLOUD_SHADOW_Z > CLOUD_SHADOW_MAX_WIND_SHIFT;
+
+	// everything the density depends on, the sun color only affects the sampling shaders.
+	m_Updated = !m_HasInputs ||
+		sunDir != m_LastSunDir ||
+		windMoved ||
+		m_LastCloudData != cloudData;
+	if (!m_Updated) {
+		if (windShift != m_UniformData.m_WindShift) {
+			m_UniformData.m_WindShift = windShift;
+			m_UniformBuffer.MapMemory(sizeof(CloudShadowUniformData), &m_UniformData, 0, 0);
+		}
+		return;
+	}
+
+	m_HasInputs = true;
+	m_LastSunDir = sunDir;
+	m_LastWindOffset = m_Wind.GetOffset();
+	m_LastCloudData = cloudData;
+
+	// frames don't overlap, nothing reads the buffer now.
+	m_UniformData.m_BoxMin = cloudData.skyPos - cloudData.skySize / 2.0f;
+	m_UniformData.m_BoxSize = cloudData.skySize;
+	m_UniformData.m_WindShift = glm::vec2(0.0f);
+	m_UniformBuffer.MapMemory(sizeof(CloudShadowUniformData), &m_UniformData, 0, 0);
+
+	VkSubmitInfo submitInfo;
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_ComputeCommandBuffer;
+
+	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+void CloudShadow::RenderImgui() {
+	CloudShadowUniformData oldData = m_UniformData;
+
+	ImGui::Begin("Cloud Shadow");
+	bool useInClouds = m_UniformData.m_UseInClouds != 0;
+	ImGui::Checkbox("Use In Clouds", &useInClouds);
+	m_UniformData.m_UseInClouds = useInClouds ? 1 : 0;
+	ImGui::SliderFloat("Terrain Strength", &m_UniformData.m_TerrainStrength, 0.0f, 1.0f);
+	if (m_Updated)
+		ImGui::Text("Last frame: updated");
+	else
+		ImGui::Text("Last frame: skipped, shifted by (%.4f, %.4f)", m_UniformData.m_WindShift.x, m_UniformData.m_WindShift.y);
+	ImGui::End();
+
+	if (oldData.m_UseInClouds != m_UniformData.m_UseInClouds || oldData.m_TerrainStrength != m_UniformData.m_TerrainStrength)
+		m_UniformBuffer.MapMemory(sizeof(CloudShadowUniformData), &m_UniformData, 0, 0);
+}
+
+VkDescriptorSet CloudShadow::GetSampleDescriptorSet() const {
+	return m_SampleDescriptor;
+}
+
+VkDescriptorSetLayout CloudShadow::GetSampleDescriptorLayout() const {
+	return m_SampleDescriptorLayout;
+}
+
+}
@@ -48,6 +48,12 @@ namespace en::vk
 		}
 	}
 
+	void CommandPool::Reset()
+	{
+		VkResult result = vkResetCommandPool(VulkanAPI::GetDevice(), m_Handle, 0);
+		ASSERT_VULKAN(result);
+	}
+
 	uint32_t CommandPool::GetBufferCount() const
 	{
 		return m_Buffers.size();
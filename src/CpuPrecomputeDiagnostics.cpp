@@ -0,0 +1,183 @@
+#include <engine/graphics/CpuPrecomputeDiagnostics.hpp>
+#include <engine/graphics/CpuAtmosphereFunctions.hpp>
+#include <engine/graphics/LutFormat.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <transmittance.h>
+
+using namespace en::cpu;
+
+namespace en {
+
+void BenchmarkTransmittanceIntegrators(const EnvConditions::Environment &environment, const AtmosphereResolution &resolution) {
+	typedef std::chrono::high_resolution_clock Clock;
+	EnvConditions::EnvironmentData env(environment);
+
+	// rays of all transmittance texels, parametrized like TransmittanceRow.
+	struct Ray {
+		float fromY, dirX, dirY, length;
+	};
+	std::vector<Ray> rays;
+	for (uint32_t x = 0; x != resolution.m_TransmittanceHeight; ++x) {
+		float height = std::clamp(TexToHeight(float(x)/(resolution.m_TransmittanceHeight-1), env.m_AtmosphereHeight), 0.3f, env.m_AtmosphereHeight-1);
+		for (uint32_t y = 0; y != resolution.m_TransmittanceView; ++y) {
+			Ray ray;
+			ray.fromY = height + env.m_PlanetRadius;
+			float cView = std::clamp(TexToView(float(y)/(resolution.m_TransmittanceView-1), height, env.m_PlanetRadius), -1.0f, 1.0f);
+			UnitVecFromCos(cView, ray.dirX, ray.dirY);
+			ray.length = AtmosphereEarthIntersect(0, ray.fromY, ray.dirX, ray.dirY, env.m_PlanetRadius, env.m_AtmosphereRadius);
+			// transmittance() returns 1 for those.
+			if (ray.length >= 1)
+				rays.push_back(ray);
+		}
+	}
+
+	const double ext[3][3] {
+		{env.m_MieSCoeff.x/0.9, env.m_MieSCoeff.y/0.9, env.m_MieSCoeff.z/0.9},
+		{env.m_RayleighSCoeff.x, env.m_RayleighSCoeff.y, env.m_RayleighSCoeff.z},
+		{env.m_OzoneExtinctionCoefficient.x, env.m_OzoneExtinctionCoefficient.y, env.m_OzoneExtinctionCoefficient.z}};
+	auto transmittance = [&ext](const double *depth, int c) {
+		return std::exp(-(depth[0]*ext[0][c] + depth[1]*ext[1][c] + depth[2]*ext[2][c]));
+	};
+
+	std::vector<std::array<double, 3>> reference(rays.size());
+	for (size_t i = 0; i != rays.size(); ++i) {
+		double depth[3];
+		OpticalDepth<double>(env, rays[i].fromY, rays[i].dirX, rays[i].dirY, rays[i].length, TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE, 4096, depth);
+		for (int c = 0; c != 3; ++c)
+			reference[i][c] = transmittance(depth, c);
+	}
+
+	Log::Info("Transmittance integrators, error against 4096 Gauss-Legendre segments over " + std::to_string(rays.size()) + " rays:");
+	auto run = [&](const char *name, int integrator, int steps, int samples) {
+		double maxError = 0;
+		double meanError = 0;
+		std::vector<std::array<float, 3>> depths(rays.size());
+
+		// evaluated in float like the shader.
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i != rays.size(); ++i)
+			OpticalDepth<float>(env, rays[i].fromY, rays[i].dirX, rays[i].dirY, rays[i].length, integrator, steps, depths[i].data());
+		float ns = std::chrono::duration<float, std::nano>(Clock::now() - start).count()/rays.size();
+
+		for (size_t i = 0; i != rays.size(); ++i) {
+			double depth[3] {depths[i][0], depths[i][1], depths[i][2]};
+			for (int c = 0; c != 3; ++c) {
+				double error = std::abs(transmittance(depth, c) - reference[i][c]);
+				maxError = std::max(maxError, error);
+				meanError += error;
+			}
+		}
+		meanError /= 3*rays.size();
+
+		std::string label = name;
+		if (integrator != TRANSMITTANCE_INTEGRATOR_ANALYTIC)
+			label += " " + std::to_string(steps) + " (" + std::to_string(samples) + " samples)";
+		Log::Info("\t" + label + ": max "
+			+ std::to_string(maxError) + ", mean " + std::to_string(meanError) + ", " + std::to_string(ns) + " ns/ray");
+	};
+
+	for (int steps : {10, 25, 50, 100, 200})
+		run("Trapezoid steps", TRANSMITTANCE_INTEGRATOR_TRAPEZOID, steps, steps+1);
+	for (int segments : {1, 2, 4, 8, 16})
+		run("Gauss-Legendre segments", TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE, segments, 3*segments);
+	run("Analytic (Chapman)", TRANSMITTANCE_INTEGRATOR_ANALYTIC, 0, 0);
+}
+
+void LogSphereIntersectionPrecision(const EnvConditions::Environment &environment) {
+	EnvConditions::EnvironmentData env(environment);
+	const uint32_t directions = 16384;
+
+	struct Error {
+		float m_Max = 0;
+		// hit on one side, miss on the other.
+		uint32_t m_Mismatches = 0;
+
+		void Add(double ref, float t) {
+			bool refHit = ref != std::numeric_limits<double>::infinity();
+			if (refHit != (t != infinity))
+				++m_Mismatches;
+			else if (refHit)
+				m_Max = std::max(m_Max, float(std::abs(ref - t)));
+		}
+		std::string ToString() const {
+			return std::to_string(m_Max) + " m (" + std::to_string(m_Mismatches) + " hit/miss mismatches)";
+		}
+	};
+
+	// ground to geostationary orbit, camera at (0, height, 0) like cam.pos.
+	for (float height : {1.0f, 100.0f, 1e3f, 1e4f, 0.9f*env.m_AtmosphereHeight, 2*env.m_AtmosphereHeight, 1e6f, 3.6e7f}) {
+		Error planetStable, planetNaive, atmosphereStable, atmosphereNaive;
+		for (uint32_t i = 0; i != directions; ++i) {
+			double angle = double(i)/(directions-1)*3.141592653589793;
+			float o[3] {0, height, 0};
+			float u[3] {float(std::sin(angle)), float(std::cos(angle)), 0};
+			// same (rounded) ray in double, only the error of the intersection itself is measured.
+			double od[3] {0, height, 0};
+			double ud[3] {u[0], u[1], 0};
+
+			planetStable.Add(SphereIntersect<double>(od, ud, env.m_PlanetRadius, env.m_PlanetRadius),
+				PlanetSphereIntersect(o, u, env.m_PlanetRadius, env.m_PlanetRadius));
+			planetNaive.Add(SphereIntersect<double>(od, ud, env.m_PlanetRadius, env.m_PlanetRadius),
+				SphereIntersect<float>(o, u, env.m_PlanetRadius, env.m_PlanetRadius));
+			// only used from outside of the atmosphere.
+			if (height > env.m_AtmosphereHeight) {
+				atmosphereStable.Add(SphereIntersect<double>(od, ud, env.m_PlanetRadius, env.m_AtmosphereRadius),
+					PlanetSphereIntersect(o, u, env.m_PlanetRadius, env.m_AtmosphereRadius));
+				atmosphereNaive.Add(SphereIntersect<double>(od, ud, env.m_PlanetRadius, env.m_AtmosphereRadius),
+					SphereIntersect<float>(o, u, env.m_PlanetRadius, env.m_AtmosphereRadius));
+			}
+		}
+
+		Log::Info("\tHeight " + std::to_string(height) + " m:");
+		Log::Info("\t\tPlanet: max " + planetStable.ToString() + ", naive float max " + planetNaive.ToString());
+		if (height > env.m_AtmosphereHeight)
+			Log::Info("\t\tAtmosphere: max " + atmosphereStable.ToString() + ", naive float max " + atmosphereNaive.ToString());
+	}
+}
+
+void LogFormatErrors(const CpuPrecomputer &precomputer) {
+	struct NamedLut {
+		const char *m_Name;
+		const std::vector<float> &m_Lut;
+		uint32_t m_Channels;
+	};
+	const NamedLut luts[3] {
+		{"Transmittance", precomputer.GetTransmittance(), 3},
+		{"Scattering", precomputer.GetScatteringSum(), 4},
+		{"Gathering", precomputer.GetGatheringSum(), 4}};
+	const LutFormat formats[5] {LutFormat::Rgba16Unorm, LutFormat::Rgba16Snorm, LutFormat::B10G11R11Ufloat, LutFormat::E5B9G9R9Ufloat, LutFormat::Rgba16Sfloat};
+
+	Log::Info("LUT format errors against full precision:");
+	for (const NamedLut &lut : luts)
+		for (LutFormat format : formats) {
+			const LutFormatInfo &info = GetLutFormatInfo(format);
+			if (info.m_Channels < lut.m_Channels)
+				continue;
+
+			size_t count = lut.m_Lut.size()/4;
+			std::vector<float> stored = DecodeLut(format, EncodeLut(format, lut.m_Lut.data(), count));
+			CpuPrecomputer::LutError error{0, 0};
+			for (size_t i = 0; i != count; ++i)
+				for (uint32_t c = 0; c != lut.m_Channels; ++c) {
+					float diff = std::abs(stored[4*i+c] - lut.m_Lut[4*i+c]);
+					error.m_Max = std::max(error.m_Max, diff);
+					error.m_Mean += diff;
+				}
+			error.m_Mean /= count*lut.m_Channels;
+
+			Log::Info(
+				"\t" + std::string(lut.m_Name) + " as " + info.m_Name + ": max " + std::to_string(error.m_Max) +
+				", mean " + std::to_string(error.m_Mean) +
+				(error.m_Max <= CPU_PRECOMPUTE_TOLERANCE ? "" : ", exceeds tolerance"));
+		}
+}
+
+}
@@ -0,0 +1,671 @@
+#include <engine/graphics/CpuPrecomputer.hpp>
+#include <engine/graphics/CpuAtmosphereFunctions.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include <transmittance.h>
+#include <scattering.h>
+#include <gathering.h>
+
+#define TRANSMITTANCE_TEXELS(res) (size_t(res.m_TransmittanceHeight)*res.m_TransmittanceView)
+#define SCATTERING_TEXELS(res) (size_t(res.m_ScatteringHeight)*res.m_ScatteringView*res.m_ScatteringSun)
+#define GATHERING_TEXELS(res) (size_t(res.m_GatheringHeight)*res.m_GatheringSun)
+
+using namespace en::cpu;
+
+// same constants as in functions.glsl, results have to match the shaders.
+static const int integrationSteps = TRANSMITTANCE_TRAPEZOID_STEPS;
+
+// value read back after imageStore into a unorm16 image.
+static float Quantize(float v) {
+	return std::round(std::clamp(v, 0.0f, 1.0f)*65535.0f)/65535.0f;
+}
+
+// texel coordinate for a [0,1] coordinate addressing the texel centers (see tex_address_shifted),
+// clamped to the edge like the samplers.
+static void TexelCoord(float u, uint32_t res, uint32_t &i0, uint32_t &i1, float &frac) {
+	// also catches NaN.
+	u = u > 0 ? std::min(u, 1.0f) : 0;
+	float x = u*(res - 1);
+	i0 = std::min(uint32_t(x), res - 1);
+	i1 = std::min(i0 + 1, res - 1);
+	frac = x - i0;
+}
+
+// linear filtered texture-lookup.
+static void Sample2D(const std::vector<float> &lut, uint32_t w, uint32_t h, float u, float v, float *out) {
+	uint32_t x0, x1, y0, y1;
+	float fx, fy;
+	TexelCoord(u, w, x0, x1, fx);
+	TexelCoord(v, h, y0, y1, fy);
+
+	const float *t00 = &lut[(y0*w + x0)*4];
+	const float *t10 = &lut[(y0*w + x1)*4];
+	const float *t01 = &lut[(y1*w + x0)*4];
+	const float *t11 = &lut[(y1*w + x1)*4];
+	for (int c = 0; c != 4; ++c) {
+		float a = t00[c] + (t10[c] - t00[c])*fx;
+		float b = t01[c] + (t11[c] - t01[c])*fx;
+		out[c] = a + (b - a)*fy;
+	}
+}
+
+static void Sample3D(const std::vector<float> &lut, uint32_t w, uint32_t h, uint32_t d, float u, float v, float s, float *out) {
+	uint32_t z0, z1;
+	float fz;
+	TexelCoord(s, d, z0, z1, fz);
+
+	// bilinear lookups in the two adjacent slices.
+	float a[4], b[4];
+	size_t slice = size_t(w)*h*4;
+	uint32_t x0, x1, y0, y1;
+	float fx, fy;
+	TexelCoord(u, w, x0, x1, fx);
+	TexelCoord(v, h, y0, y1, fy);
+	for (int i = 0; i != 2; ++i) {
+		const float *base = &lut[(i == 0 ? z0 : z1)*slice];
+		float *res = i == 0 ? a : b;
+		const float *t00 = base + (y0*w + x0)*4;
+		const float *t10 = base + (y0*w + x1)*4;
+		const float *t01 = base + (y1*w + x0)*4;
+		const float *t11 = base + (y1*w + x1)*4;
+		for (int c = 0; c != 4; ++c) {
+			float ab = t00[c] + (t10[c] - t00[c])*fx;
+			float cd = t01[c] + (t11[c] - t01[c])*fx;
+			res[c] = ab + (cd - ab)*fy;
+		}
+	}
+	for (int c = 0; c != 4; ++c)
+		out[c] = a[c] + (b[c] - a[c])*fz;
+}
+
+namespace en {
+
+CpuPrecomputer::CpuPrecomputer(const EnvConditions::Environment &env, const AtmosphereResolution &resolution, uint32_t threadCount) :
+	m_EnvData(env),
+	m_Resolution(resolution),
+	m_ThreadCount{threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())},
+	m_Transmittance(TRANSMITTANCE_TEXELS(resolution)*4, 0),
+	m_Scattering(SCATTERING_TEXELS(resolution)*4, 0),
+	m_ScatteringSum(SCATTERING_TEXELS(resolution)*4, 0),
+	m_Gathering(GATHERING_TEXELS(resolution)*4, 0),
+	m_GatheringSum(GATHERING_TEXELS(resolution)*4, 0),
+	m_Timings{0, 0, 0, 0, 0} { }
+
+void CpuPrecomputer::ParallelRows(uint32_t rows, const std::function<void(uint32_t)> &func) const {
+	// rows take very different amounts of time (view-rays at low heights are longer),
+	// so hand them out one by one instead of splitting evenly.
+	std::atomic<uint32_t> next{0};
+	auto worker = [&]() {
+		for (uint32_t x = next++; x < rows; x = next++)
+			func(x);
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < m_ThreadCount; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+void CpuPrecomputer::Run() {
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	};
+	m_Timings = {0, 0, 0, 0, 0};
+	Clock::time_point runStart = Clock::now();
+
+	// GatheringClear, the scattering sum is fully overwritten by single scattering.
+	std::fill(m_GatheringSum.begin(), m_GatheringSum.end(), 0.0f);
+
+	Clock::time_point start = Clock::now();
+	ParallelRows(m_Resolution.m_TransmittanceHeight, [this](uint32_t x) { TransmittanceRow(x); });
+	m_Timings.m_Transmittance += ms(start);
+
+	start = Clock::now();
+	ParallelRows(m_Resolution.m_ScatteringHeight, [this](uint32_t x) { SingleScatteringRow(x); });
+	m_Timings.m_SingleScattering += ms(start);
+
+	start = Clock::now();
+	ParallelRows(m_Resolution.m_GatheringHeight, [this](uint32_t x) { GatheringRow(x); });
+	m_Timings.m_Gathering += ms(start);
+
+	for (int i = 1; i != SCATTERING_ORDERS; ++i) {
+		start = Clock::now();
+		ParallelRows(m_Resolution.m_ScatteringHeight, [this](uint32_t x) { MultiScatteringRow(x); });
+		m_Timings.m_MultiScattering += ms(start);
+
+		start = Clock::now();
+		ParallelRows(m_Resolution.m_GatheringHeight, [this](uint32_t x) { GatheringRow(x); });
+		m_Timings.m_Gathering += ms(start);
+	}
+
+	m_Timings.m_Total = ms(runStart);
+}
+
+void CpuPrecomputer::TransmittanceRow(uint32_t x) {
+	const EnvConditions::EnvironmentData &env = m_EnvData;
+	const float extR[3] {env.m_RayleighSCoeff.x, env.m_RayleighSCoeff.y, env.m_RayleighSCoeff.z};
+	const float extM[3] {env.m_MieSCoeff.x/0.9f, env.m_MieSCoeff.y/0.9f, env.m_MieSCoeff.z/0.9f};
+	const float extO[3] {env.m_OzoneExtinctionCoefficient.x, env.m_OzoneExtinctionCoefficient.y, env.m_OzoneExtinctionCoefficient.z};
+
+	float texHeight = float(x)/(m_Resolution.m_TransmittanceHeight-1);
+	float height = std::clamp(TexToHeight(texHeight, env.m_AtmosphereHeight), 0.3f, env.m_AtmosphereHeight-1);
+	float fromY = height + env.m_PlanetRadius;
+
+	for (uint32_t y0 = 0; y0 < m_Resolution.m_TransmittanceView; y0 += CPU_PRECOMPUTE_LANES) {
+		float dirX[CPU_PRECOMPUTE_LANES], dirY[CPU_PRECOMPUTE_LANES], length[CPU_PRECOMPUTE_LANES];
+		float densMSum[CPU_PRECOMPUTE_LANES], densRSum[CPU_PRECOMPUTE_LANES], densOSum[CPU_PRECOMPUTE_LANES];
+
+		for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+			// lanes past the end compute the last texel again, they aren't stored.
+			uint32_t y = std::min(y0 + l, uint32_t(m_Resolution.m_TransmittanceView-1));
+			float cView = std::clamp(TexToView(float(y)/(m_Resolution.m_TransmittanceView-1), height, env.m_PlanetRadius), -1.0f, 1.0f);
+			UnitVecFromCos(cView, dirX[l], dirY[l]);
+
+			length[l] = AtmosphereEarthIntersect(0, fromY, dirX[l], dirY[l], env.m_PlanetRadius, env.m_AtmosphereRadius);
+			densMSum[l] = 0;
+			densRSum[l] = 0;
+			densOSum[l] = 0;
+		}
+
+#if TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_ANALYTIC
+		for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+			densMSum[l] = OpticalDepthAnalytic(fromY, dirY[l], length[l], env.m_PlanetRadius, env.m_MieScaleHeight);
+			densRSum[l] = OpticalDepthAnalytic(fromY, dirY[l], length[l], env.m_PlanetRadius, env.m_RayleighScaleHeight);
+			densOSum[l] = densRSum[l]*6e-7f;
+		}
+#elif TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE
+		for (int i = 0; i != TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS; ++i) {
+			for (int j = 0; j != 3; ++j) {
+				float node = i + 0.5f + 0.5f*float(gaussNodes[j]);
+				for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+					float segmentLength = length[l]/TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS;
+					float sx = segmentLength*node*dirX[l];
+					float sy = fromY + segmentLength*node*dirY[l];
+					float h = Height(sx, sy, env.m_PlanetRadius);
+					float weight = 0.5f*segmentLength*float(gaussWeights[j]);
+					densMSum[l] += DensityM(h, env.m_MieScaleHeight)*weight;
+					densRSum[l] += DensityR(h, env.m_RayleighScaleHeight)*weight;
+					densOSum[l] += DensityO(h, env.m_RayleighScaleHeight)*weight;
+				}
+			}
+		}
+#else
+		float stepLength[CPU_PRECOMPUTE_LANES];
+		float densMPrev[CPU_PRECOMPUTE_LANES], densRPrev[CPU_PRECOMPUTE_LANES], densOPrev[CPU_PRECOMPUTE_LANES];
+		float h0 = Height(0, fromY, env.m_PlanetRadius);
+		for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+			stepLength[l] = length[l]/integrationSteps;
+			densMPrev[l] = DensityM(h0, env.m_MieScaleHeight);
+			densRPrev[l] = DensityR(h0, env.m_RayleighScaleHeight);
+			densOPrev[l] = DensityO(h0, env.m_RayleighScaleHeight);
+		}
+
+		// first sample is from, last sample is to.
+		for (int i = 1; i <= integrationSteps; ++i) {
+			for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+				float sx = stepLength[l]*i*dirX[l];
+				float sy = fromY + stepLength[l]*i*dirY[l];
+				float h = Height(sx, sy, env.m_PlanetRadius);
+				float densM = DensityM(h, env.m_MieScaleHeight);
+				float densR = DensityR(h, env.m_RayleighScaleHeight);
+				float densO = DensityO(h, env.m_RayleighScaleHeight);
+
+				densMSum[l] += (densMPrev[l] + densM)/2.0f*stepLength[l];
+				densRSum[l] += (densRPrev[l] + densR)/2.0f*stepLength[l];
+				densOSum[l] += (densOPrev[l] + densO)/2.0f*stepLength[l];
+
+				densMPrev[l] = densM;
+				densRPrev[l] = densR;
+				densOPrev[l] = densO;
+			}
+		}
+#endif
+
+		uint32_t count = std::min(uint32_t(CPU_PRECOMPUTE_LANES), m_Resolution.m_TransmittanceView - y0);
+		for (uint32_t l = 0; l != count; ++l) {
+			float *texel = &m_Transmittance[((y0 + l)*m_Resolution.m_TransmittanceHeight + x)*4];
+			for (int c = 0; c != 3; ++c)
+				// no attenuation for same position.
+				texel[c] = length[l] < 1 ? 1 : Quantize(std::exp(-(densMSum[l]*extM[c] + densRSum[l]*extR[c] + densOSum[l]*extO[c])));
+			texel[3] = 0;
+		}
+	}
+}
+
+void CpuPrecomputer::SingleScatteringRow(uint32_t x) {
+	const EnvConditions::EnvironmentData &env = m_EnvData;
+	const float rPlanet = env.m_PlanetRadius;
+	const float scoeffR[3] {env.m_RayleighSCoeff.x, env.m_RayleighSCoeff.y, env.m_RayleighSCoeff.z};
+	const float extR[3] {scoeffR[0], scoeffR[1], scoeffR[2]};
+	const float extM[3] {env.m_MieSCoeff.x/0.9f, env.m_MieSCoeff.y/0.9f, env.m_MieSCoeff.z/0.9f};
+	const float extO[3] {env.m_OzoneExtinctionCoefficient.x, env.m_OzoneExtinctionCoefficient.y, env.m_OzoneExtinctionCoefficient.z};
+
+	auto fetchTransmittance = [&](float h, float cView, float *out) {
+		float texel[4];
+		Sample2D(m_Transmittance, m_Resolution.m_TransmittanceHeight, m_Resolution.m_TransmittanceView,
+			HeightToTex(h, env.m_AtmosphereHeight), ViewToTex(cView, h, rPlanet), texel);
+		std::copy(texel, texel+3, out);
+	};
+
+	float texHeight = float(x)/(m_Resolution.m_ScatteringHeight-1);
+	float height = std::clamp(TexToHeight(texHeight, env.m_AtmosphereHeight), 0.3f, env.m_AtmosphereHeight-1);
+	float paY = height + rPlanet;
+
+	float hA = Height(0, paY, rPlanet);
+	float densMA = DensityM(hA, env.m_MieScaleHeight);
+	float densRA = DensityR(hA, env.m_RayleighScaleHeight);
+	float densOA = DensityO(hA, env.m_RayleighScaleHeight);
+
+	for (uint32_t z = 0; z != m_Resolution.m_ScatteringSun; ++z) {
+		float cSun = std::clamp(TexToSun(float(z)/(m_Resolution.m_ScatteringSun-1)), -1.0f, 1.0f);
+		// -light_in.
+		float sunX, sunY;
+		UnitVecFromCos(cSun, sunX, sunY);
+
+		// inscattering at pa doesn't depend on the view.
+		float transmittanceA[3] {0, 0, 0};
+		if (ConcentricCircleIntersect(0, paY, sunX, sunY, rPlanet) == infinity)
+			fetchTransmittance(hA, sunY, transmittanceA);
+
+		for (uint32_t y0 = 0; y0 < m_Resolution.m_ScatteringView; y0 += CPU_PRECOMPUTE_LANES) {
+			float viewX[CPU_PRECOMPUTE_LANES], viewY[CPU_PRECOMPUTE_LANES], length[CPU_PRECOMPUTE_LANES];
+			int steps[CPU_PRECOMPUTE_LANES];
+			float densMPrev[CPU_PRECOMPUTE_LANES], densRPrev[CPU_PRECOMPUTE_LANES], densOPrev[CPU_PRECOMPUTE_LANES];
+			float densMSum[CPU_PRECOMPUTE_LANES], densRSum[CPU_PRECOMPUTE_LANES], densOSum[CPU_PRECOMPUTE_LANES];
+			float inscRPrev[3][CPU_PRECOMPUTE_LANES], inscMPrev[CPU_PRECOMPUTE_LANES];
+			float inscRSum[3][CPU_PRECOMPUTE_LANES], inscMSum[CPU_PRECOMPUTE_LANES];
+
+			int maxSteps = 0;
+			for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+				uint32_t y = std::min(y0 + l, uint32_t(m_Resolution.m_ScatteringView-1));
+				float cView = std::clamp(TexToView(float(y)/(m_Resolution.m_ScatteringView-1), height, rPlanet), -1.0f, 1.0f);
+				UnitVecFromCos(cView, viewX[l], viewY[l]);
+
+				length[l] = AtmosphereEarthIntersect(0, paY, viewX[l], viewY[l], rPlanet, env.m_AtmosphereRadius);
+				// no intersection with atmosphere, lane yields zero.
+				steps[l] = std::isfinite(length[l]) ? int(length[l]/SCATTERING_STEP_LENGTH) : 0;
+				maxSteps = std::max(maxSteps, steps[l]);
+
+				densMPrev[l] = densMA;
+				densRPrev[l] = densRA;
+				densOPrev[l] = densOA;
+				densMSum[l] = 0;
+				densRSum[l] = 0;
+				densOSum[l] = 0;
+				for (int c = 0; c != 3; ++c) {
+					inscRPrev[c][l] = densRA*transmittanceA[c];
+					inscRSum[c][l] = 0;
+				}
+				inscMPrev[l] = densMA*transmittanceA[0];
+				inscMSum[l] = 0;
+			}
+
+			for (int i = 1; i <= maxSteps; ++i) {
+				for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+					if (i > steps[l])
+						continue;
+					float px = i*SCATTERING_STEP_LENGTH*viewX[l];
+					float py = paY + i*SCATTERING_STEP_LENGTH*viewY[l];
+
+					float h = Height(px, py, rPlanet);
+					float densM = DensityM(h, env.m_MieScaleHeight);
+					float densR = DensityR(h, env.m_RayleighScaleHeight);
+					float densO = DensityO(h, env.m_RayleighScaleHeight);
+
+					densMSum[l] += (densMPrev[l] + densM)/2.0f*SCATTERING_STEP_LENGTH;
+					densRSum[l] += (densRPrev[l] + densR)/2.0f*SCATTERING_STEP_LENGTH;
+					densOSum[l] += (densOPrev[l] + densO)/2.0f*SCATTERING_STEP_LENGTH;
+
+					densMPrev[l] = densM;
+					densRPrev[l] = densR;
+					densOPrev[l] = densO;
+
+					// zero in earths shadow.
+					float transmittance[3] {0, 0, 0};
+					if (ConcentricCircleIntersect(px, py, sunX, sunY, rPlanet) == infinity) {
+						float tppc[3];
+						fetchTransmittance(h, (px*sunX + py*sunY)/std::sqrt(px*px + py*py), tppc);
+						for (int c = 0; c != 3; ++c)
+							transmittance[c] = std::exp(-(densMSum[l]*extM[c] + densRSum[l]*extR[c] + densOSum[l]*extO[c]))*tppc[c];
+					}
+
+					for (int c = 0; c != 3; ++c) {
+						float inscR = densR*transmittance[c];
+						inscRSum[c][l] += (inscRPrev[c][l] + inscR)/2.0f*SCATTERING_STEP_LENGTH;
+						inscRPrev[c][l] = inscR;
+					}
+					float inscM = densM*transmittance[0];
+					inscMSum[l] += (inscMPrev[l] + inscM)/2.0f*SCATTERING_STEP_LENGTH;
+					inscMPrev[l] = inscM;
+				}
+			}
+
+			uint32_t count = std::min(uint32_t(CPU_PRECOMPUTE_LANES), m_Resolution.m_ScatteringView - y0);
+			for (uint32_t l = 0; l != count; ++l) {
+				size_t index = (size_t(z*m_Resolution.m_ScatteringView + y0 + l)*m_Resolution.m_ScatteringHeight + x)*4;
+				float result[4] {0, 0, 0, 0};
+
+				if (std::isfinite(length[l])) {
+					// integrate from the last p (pa if there were no steps) to pb.
+					float pbx = length[l]*viewX[l];
+					float pby = paY + length[l]*viewY[l];
+					float px = steps[l]*SCATTERING_STEP_LENGTH*viewX[l];
+					float py = paY + steps[l]*SCATTERING_STEP_LENGTH*viewY[l];
+					float rest = std::sqrt((pbx-px)*(pbx-px) + (pby-py)*(pby-py));
+
+					float h = Height(pbx, pby, rPlanet);
+					float densM = DensityM(h, env.m_MieScaleHeight);
+					float densR = DensityR(h, env.m_RayleighScaleHeight);
+					float densO = DensityO(h, env.m_RayleighScaleHeight);
+
+					densMSum[l] += (densMPrev[l] + densM)/2.0f*rest;
+					densRSum[l] += (densRPrev[l] + densR)/2.0f*rest;
+					densOSum[l] += (densOPrev[l] + densO)/2.0f*rest;
+
+					float transmittance[3] {0, 0, 0};
+					if (ConcentricCircleIntersect(pbx, pby, sunX, sunY, rPlanet) == infinity) {
+						float tpbpc[3];
+						fetchTransmittance(h, (pbx*sunX + pby*sunY)/std::sqrt(pbx*pbx + pby*pby), tpbpc);
+						for (int c = 0; c != 3; ++c)
+							transmittance[c] = std::exp(-(densMSum[l]*extM[c] + densRSum[l]*extR[c] + densOSum[l]*extO[c]))*tpbpc[c];
+					}
+
+					for (int c = 0; c != 3; ++c) {
+						inscRSum[c][l] += (inscRPrev[c][l] + densR*transmittance[c])/2.0f*rest;
+						result[c] = inscRSum[c][l]*scoeffR[c]/(4.0f*pi);
+					}
+					inscMSum[l] += (inscMPrev[l] + densM*transmittance[0])/2.0f*rest;
+					result[3] = inscMSum[l]*env.m_MieSCoeff.x/(4.0f*pi);
+				}
+
+				for (int c = 0; c != 4; ++c) {
+					m_Scattering[index+c] = Quantize(result[c]);
+					m_ScatteringSum[index+c] = Quantize(result[c]);
+				}
+			}
+		}
+	}
+}
+
+void CpuPrecomputer::GatheringRow(uint32_t x) {
+	const EnvConditions::EnvironmentData &env = m_EnvData;
+
+	float texHeight = float(x)/(m_Resolution.m_GatheringHeight-1);
+	float height = std::clamp(TexToHeight(texHeight, env.m_AtmosphereHeight), 0.3f, env.m_AtmosphereHeight-1);
+	// gathering.comp maps the height with r_atmosphere, not atmosphere_height.
+	float scatteringHeight = HeightToTex(height, env.m_AtmosphereRadius);
+
+	// view-coordinates are the same for all sun-angles.
+	// Accumulate in float like the shader so the number of steps matches.
+	std::vector<float> scatteringViews;
+	for (float view = 0; view < pi; view += (pi/GATHERING_STEPS))
+		scatteringViews.push_back(ViewToTex(std::cos(view), height, env.m_PlanetRadius));
+
+	for (uint32_t y0 = 0; y0 < m_Resolution.m_GatheringSun; y0 += CPU_PRECOMPUTE_LANES) {
+		float scatteringSun[CPU_PRECOMPUTE_LANES];
+		float gathered[4][CPU_PRECOMPUTE_LANES];
+
+		for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+			uint32_t y = std::min(y0 + l, uint32_t(m_Resolution.m_GatheringSun-1));
+			scatteringSun[l] = SunToTex(TexToSun(float(y)/(m_Resolution.m_GatheringSun-1)));
+			for (int c = 0; c != 4; ++c)
+				gathered[c][l] = 0;
+		}
+
+		for (float scatteringView : scatteringViews) {
+			for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+				float texel[4];
+				Sample3D(m_Scattering, m_Resolution.m_ScatteringHeight, m_Resolution.m_ScatteringView, m_Resolution.m_ScatteringSun,
+					scatteringHeight, scatteringView, scatteringSun[l], texel);
+				for (int c = 0; c != 4; ++c)
+					gathered[c][l] += texel[c];
+			}
+		}
+
+		uint32_t count = std::min(uint32_t(CPU_PRECOMPUTE_LANES), m_Resolution.m_GatheringSun - y0);
+		for (uint32_t l = 0; l != count; ++l) {
+			size_t index = (size_t(y0 + l)*m_Resolution.m_GatheringHeight + x)*4;
+			for (int c = 0; c != 4; ++c) {
+				// only half of the 2*GATHERING_STEPS views were sampled, they are symmetric.
+				float value = gathered[c][l]*2*(4*pi/(2*GATHERING_STEPS));
+				m_Gathering[index+c] = Quantize(value);
+				m_GatheringSum[index+c] = Quantize(value + m_GatheringSum[index+c]);
+			}
+		}
+	}
+}
+
+void CpuPrecomputer::MultiScatteringRow(uint32_t x) {
+	const EnvConditions::EnvironmentData &env = m_EnvData;
+	const float rPlanet = env.m_PlanetRadius;
+	const float scoeffR[3] {env.m_RayleighSCoeff.x, env.m_RayleighSCoeff.y, env.m_RayleighSCoeff.z};
+	const float extR[3] {scoeffR[0], scoeffR[1], scoeffR[2]};
+	const float extM[3] {env.m_MieSCoeff.x/0.9f, env.m_MieSCoeff.y/0.9f, env.m_MieSCoeff.z/0.9f};
+	const float extO[3] {env.m_OzoneExtinctionCoefficient.x, env.m_OzoneExtinctionCoefficient.y, env.m_OzoneExtinctionCoefficient.z};
+
+	auto fetchGathering = [&](float h, float cSun, float *out) {
+		Sample2D(m_Gathering, m_Resolution.m_GatheringHeight, m_Resolution.m_GatheringSun,
+			HeightToTex(h, env.m_AtmosphereHeight), SunToTex(cSun), out);
+	};
+
+	float texHeight = float(x)/(m_Resolution.m_ScatteringHeight-1);
+	float height = std::clamp(TexToHeight(texHeight, env.m_AtmosphereHeight), 0.3f, env.m_AtmosphereHeight-1);
+	float paY = height + rPlanet;
+
+	float hA = Height(0, paY, rPlanet);
+	float densMA = DensityM(hA, env.m_MieScaleHeight);
+	float densRA = DensityR(hA, env.m_RayleighScaleHeight);
+	float densOA = DensityO(hA, env.m_RayleighScaleHeight);
+
+	for (uint32_t z = 0; z != m_Resolution.m_ScatteringSun; ++z) {
+		float cSun = TexToSun(float(z)/(m_Resolution.m_ScatteringSun-1));
+		// -light_in.
+		float sunX, sunY;
+		UnitVecFromCos(cSun, sunX, sunY);
+
+		float gatheringA[4];
+		fetchGathering(hA, sunY, gatheringA);
+
+		for (uint32_t y0 = 0; y0 < m_Resolution.m_ScatteringView; y0 += CPU_PRECOMPUTE_LANES) {
+			float viewX[CPU_PRECOMPUTE_LANES], viewY[CPU_PRECOMPUTE_LANES], length[CPU_PRECOMPUTE_LANES];
+			int steps[CPU_PRECOMPUTE_LANES];
+			float densMPrev[CPU_PRECOMPUTE_LANES], densRPrev[CPU_PRECOMPUTE_LANES], densOPrev[CPU_PRECOMPUTE_LANES];
+			float densMSum[CPU_PRECOMPUTE_LANES], densRSum[CPU_PRECOMPUTE_LANES], densOSum[CPU_PRECOMPUTE_LANES];
+			float inscPrev[4][CPU_PRECOMPUTE_LANES], inscSum[4][CPU_PRECOMPUTE_LANES];
+
+			int maxSteps = 0;
+			for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+				uint32_t y = std::min(y0 + l, uint32_t(m_Resolution.m_ScatteringView-1));
+				float cView = TexToView(float(y)/(m_Resolution.m_ScatteringView-1), height, rPlanet);
+				UnitVecFromCos(cView, viewX[l], viewY[l]);
+
+				length[l] = AtmosphereEarthIntersect(0, paY, viewX[l], viewY[l], rPlanet, env.m_AtmosphereRadius);
+				steps[l] = length[l] != infinity ? int(length[l]/SCATTERING_STEP_LENGTH) : 0;
+				maxSteps = std::max(maxSteps, steps[l]);
+
+				densMPrev[l] = densMA;
+				densRPrev[l] = densRA;
+				densOPrev[l] = densOA;
+				densMSum[l] = 0;
+				densRSum[l] = 0;
+				densOSum[l] = 0;
+				for (int c = 0; c != 3; ++c)
+					inscPrev[c][l] = gatheringA[c]*densRA;
+				inscPrev[3][l] = gatheringA[3]*densMA;
+				for (int c = 0; c != 4; ++c)
+					inscSum[c][l] = 0;
+			}
+
+			// inscattering at p, given the density-integral from pa to p.
+			auto inscattering = [&](uint32_t l, float px, float py, float densM, float densR, float *insc) {
+				float transmittance[3];
+				for (int c = 0; c != 3; ++c)
+					transmittance[c] = std::exp(-(densMSum[l]*extM[c] + densRSum[l]*extR[c] + densOSum[l]*extO[c]));
+				float gathering[4];
+				fetchGathering(Height(px, py, rPlanet), (px*sunX + py*sunY)/std::sqrt(px*px + py*py), gathering);
+				for (int c = 0; c != 3; ++c)
+					insc[c] = gathering[c]*densR*transmittance[c];
+				// use r for mie only.
+				insc[3] = gathering[3]*densM*transmittance[0];
+			};
+
+			for (int i = 1; i <= maxSteps; ++i) {
+				for (uint32_t l = 0; l != CPU_PRECOMPUTE_LANES; ++l) {
+					if (i > steps[l])
+						continue;
+					float px = i*SCATTERING_STEP_LENGTH*viewX[l];
+					float py = paY + i*SCATTERING_STEP_LENGTH*viewY[l];
+
+					float h = Height(px, py, rPlanet);
+					float densM = DensityM(h, env.m_MieScaleHeight);
+					float densR = DensityR(h, env.m_RayleighScaleHeight);
+					float densO = DensityO(h, env.m_RayleighScaleHeight);
+
+					densMSum[l] += (densMPrev[l] + densM)/2.0f*SCATTERING_STEP_LENGTH;
+					densRSum[l] += (densRPrev[l] + densR)/2.0f*SCATTERING_STEP_LENGTH;
+					densOSum[l] += (densOPrev[l] + densO)/2.0f*SCATTERING_STEP_LENGTH;
+
+					densMPrev[l] = densM;
+					densRPrev[l] = densR;
+					densOPrev[l] = densO;
+
+					float insc[4];
+					inscattering(l, px, py, densM, densR, insc);
+					for (int c = 0; c != 4; ++c) {
+						inscSum[c][l] += (inscPrev[c][l] + insc[c])/2.0f*SCATTERING_STEP_LENGTH;
+						inscPrev[c][l] = insc[c];
+					}
+				}
+			}
+
+			uint32_t count = std::min(uint32_t(CPU_PRECOMPUTE_LANES), m_Resolution.m_ScatteringView - y0);
+			for (uint32_t l = 0; l != count; ++l) {
+				size_t index = (size_t(z*m_Resolution.m_ScatteringView + y0 + l)*m_Resolution.m_ScatteringHeight + x)*4;
+				float result[4] {0, 0, 0, 0};
+
+				if (length[l] != infinity) {
+					float pbx = length[l]*viewX[l];
+					float pby = paY + length[l]*viewY[l];
+					float px = steps[l]*SCATTERING_STEP_LENGTH*viewX[l];
+					float py = paY + steps[l]*SCATTERING_STEP_LENGTH*viewY[l];
+					float rest = std::sqrt((pbx-px)*(pbx-px) + (pby-py)*(pby-py));
+
+					float h = Height(pbx, pby, rPlanet);
+					float densM = DensityM(h, env.m_MieScaleHeight);
+					float densR = DensityR(h, env.m_RayleighScaleHeight);
+					float densO = DensityO(h, env.m_RayleighScaleHeight);
+
+					densMSum[l] += (densMPrev[l] + densM)/2.0f*rest;
+					densRSum[l] += (densRPrev[l] + densR)/2.0f*rest;
+					densOSum[l] += (densOPrev[l] + densO)/2.0f*rest;
+
+					float insc[4];
+					inscattering(l, pbx, pby, densM, densR, insc);
+					for (int c = 0; c != 4; ++c)
+						inscSum[c][l] += (inscPrev[c][l] + insc[c])/2.0f*rest;
+
+					for (int c = 0; c != 3; ++c)
+						result[c] = inscSum[c][l]*scoeffR[c]/(4.0f*pi);
+					result[3] = inscSum[3][l]*env.m_MieSCoeff.x/(4.0f*pi);
+				}
+
+				for (int c = 0; c != 4; ++c) {
+					m_Scattering[index+c] = Quantize(result[c]);
+					m_ScatteringSum[index+c] = Quantize(result[c] + m_ScatteringSum[index+c]);
+				}
+			}
+		}
+	}
+}
+
+AtmosphereLuts CpuPrecomputer::GetLuts() const {
+	auto encode = [](const Lut &lut) {
+		return EncodeLut(AtmosphereLuts::m_Format, lut.data(), lut.size()/4);
+	};
+
+	AtmosphereLuts luts;
+	luts.m_Transmittance = encode(m_Transmittance);
+	luts.m_ScatteringSum = encode(m_ScatteringSum);
+	luts.m_GatheringSum = encode(m_GatheringSum);
+	return luts;
+}
+
+const CpuPrecomputer::Timings &CpuPrecomputer::GetTimings() const {
+	return m_Timings;
+}
+
+void CpuPrecomputer::LogBenchmark() const {
+	auto log = [](const std::string &stage, float ms, double texels) {
+		Log::Info("\t" + stage + ": " + std::to_string(ms) + " ms, " + std::to_string(texels/(ms*1000.0)) + " Mtexel/s");
+	};
+
+	Log::Info("CPU precompute with " + std::to_string(m_ThreadCount) + " threads, " + std::to_string(m_Timings.m_Total) + " ms total");
+	log("Transmittance", m_Timings.m_Transmittance, TRANSMITTANCE_TEXELS(m_Resolution));
+	log("SingleScattering", m_Timings.m_SingleScattering, SCATTERING_TEXELS(m_Resolution));
+	log("Gathering", m_Timings.m_Gathering, double(GATHERING_TEXELS(m_Resolution))*SCATTERING_ORDERS);
+	log("MultiScattering", m_Timings.m_MultiScattering, double(SCATTERING_TEXELS(m_Resolution))*(SCATTERING_ORDERS-1));
+}
+
+const std::vector<float> &CpuPrecomputer::GetTransmittance() const {
+	return m_Transmittance;
+}
+
+const std::vector<float> &CpuPrecomputer::GetScatteringSum() const {
+	return m_ScatteringSum;
+}
+
+const std::vector<float> &CpuPrecomputer::GetGatheringSum() const {
+	return m_GatheringSum;
+}
+
+std::array<CpuPrecomputer::LutError, 3> CpuPrecomputer::Compare(const AtmosphereLuts &a, const AtmosphereLuts &b) {
+	auto compare = [](const std::vector<char> &a, const std::vector<char> &b) {
+		if (a.size() != b.size() || a.empty())
+			return LutError{infinity, infinity};
+
+		LutError error{0, 0};
+		size_t count = a.size()/sizeof(uint16_t);
+		for (size_t i = 0; i != count; ++i) {
+			uint16_t valueA, valueB;
+			std::memcpy(&valueA, &a[i*sizeof(uint16_t)], sizeof(uint16_t));
+			std::memcpy(&valueB, &b[i*sizeof(uint16_t)], sizeof(uint16_t));
+			float diff = std::abs(float(valueA) - float(valueB))/65535.0f;
+			error.m_Max = std::max(error.m_Max, diff);
+			error.m_Mean += diff;
+		}
+		error.m_Mean /= count;
+		return error;
+	};
+
+	return {
+		compare(a.m_Transmittance, b.m_Transmittance),
+		compare(a.m_ScatteringSum, b.m_ScatteringSum),
+		compare(a.m_GatheringSum, b.m_GatheringSum)};
+}
+
+bool CpuPrecomputer::LogComparison(const AtmosphereLuts &cpu, const AtmosphereLuts &gpu) {
+	static const char *names[3] {"Transmittance", "Scattering", "Gathering"};
+
+	std::array<LutError, 3> errors = Compare(cpu, gpu);
+	bool withinTolerance = true;
+	for (int i = 0; i != 3; ++i) {
+		std::string msg = std::string(names[i]) + " CPU/GPU difference: max " + std::to_string(errors[i].m_Max) + ", mean " + std::to_string(errors[i].m_Mean);
+		if (errors[i].m_Max > CPU_PRECOMPUTE_TOLERANCE) {
+			Log::Warn(msg + ", exceeds tolerance of " + std::to_string(CPU_PRECOMPUTE_TOLERANCE));
+			withinTolerance = false;
+		} else
+			Log::Info(msg);
+	}
+	return withinTolerance;
+}
+
+}
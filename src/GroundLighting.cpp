@@ -1,15 +1,11 @@
+#include <algorithm>
 #include <cassert>
-#include <glm/ext/quaternion_transform.hpp>
-#include <glm/gtx/string_cast.hpp>
-#include <glm/gtx/transform.hpp>
 #include <math.h>
 #include <set>
 #include <vulkan/vulkan_core.h>
 #include "engine/graphics/GroundLighting.hpp"
 #include "engine/graphics/VulkanAPI.hpp"
-#include <iostream>
-#include <fstream>
-#include <numeric>
+#include <imgui.h>
 
 #include "ground_lighting.h"
 
@@ -20,19 +16,43 @@
 
 namespace en {
 
-GroundLighting::GroundLighting(Precomputer &precomp, Atmosphere &atm, Sun &sun) :
-	m_CommandPool(0, VulkanAPI::GetComputeQFI()),
+GroundLighting::GroundLighting(Precomputer &precomp, Atmosphere &atm, Sun &sun, GroundLightingOutput output) :
+	// the compute buffer is recorded again when the atmosphere descriptor sets change.
+	m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetComputeQFI()),
 	m_Precomp{precomp},
 	m_Atmosphere{atm},
-	m_Sun{sun} {
+	m_Sun{sun},
+	m_Output{output},
+	m_HasInputs{false},
+	m_SunThreshold{0.001},
+	m_Incremental{true},
+	m_NextFace{0},
+	m_StaleFaces{0},
+	m_LastFaces{0},
+	m_GLImage{VK_NULL_HANDLE},
+	m_GLImagesMemory{VK_NULL_HANDLE},
+	m_CubeImageView{VK_NULL_HANDLE},
+	m_ImageView{VK_NULL_HANDLE},
+	m_SHBuffer{nullptr},
+	m_LinearSampler{VK_NULL_HANDLE} {
 	
-	GenerateVectors();
-	m_Shader = vk::Shader("sky/ground_lighting.comp", false);
 	VkDevice device = VulkanAPI::GetDevice();
 	// Need command buffer for image transition in CreateComputeImages.
 	CreateCommandBuffers();
-	CreateComputeImages(device);
-	CreateDescriptors(device);
+	if (m_Output == GroundLightingOutput::Cubemap) {
+		m_Shader = vk::Shader("sky/ground_lighting.comp", false);
+		CreateComputeImages(device);
+		CreateDescriptors(device);
+	} else {
+		m_Shader = vk::Shader("sky/ground_lighting_sh.comp", false);
+		// written once per update in compute, read by every material fragment.
+		m_SHBuffer = new vk::Buffer(
+			sizeof(glm::vec4)*GRL_SH_COEFFICIENTS,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			{});
+		CreateSHDescriptors(device);
+	}
 	CreateComputePipeline(device);
 	RecordCommandBuffers();
 }
@@ -46,92 +66,23 @@ GroundLighting::~GroundLighting() {
 	vkDestroyImage(device, m_GLImage, nullptr);
 	vkDestroyImageView(device, m_CubeImageView, nullptr);
 	vkDestroyImageView(device, m_ImageView, nullptr);
+	if (m_SHBuffer != nullptr) {
+		m_SHBuffer->Destroy();
+		delete m_SHBuffer;
+	}
 
 	vkDestroySampler(device, m_LinearSampler, nullptr);
 	vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(device, m_ImageDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_TargetDescriptorLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, m_SampleDescriptorLayout, nullptr);
 
 	vkDestroyPipelineLayout(device, m_GLPipelineLayout, nullptr);
 	vkDestroyPipeline(device, m_GLPipeline, nullptr);
+	vkDestroyPipeline(device, m_GLBlendPipeline, nullptr);
 
 	m_Shader.Destroy();
 }
 
-std::ostream &operator<<(std::ostream &file, const std::vector<glm::vec3> &vecs) {
-	file << "{\n";
-	file << "\t\t" << glm::to_string(vecs[0]);
-	for (int i = 1; i != vecs.size(); ++i)
-		file << ",\n\t\t" << glm::to_string(vecs[i]);
-	file << "\n\t}";
-	return file;
-}
-
-// construct copy.
-std::ostream &operator<<(std::ostream &file, const std::vector<std::vector<glm::vec3>> &all_vecs) {
-	file << "const vec3 hemisphere_vecs[" << all_vecs.size() << "][" << all_vecs[0].size() << "] = {\n\t";
-	file << all_vecs[0];
-	for (int i = 1; i != all_vecs.size(); ++i)
-		file << ", " << all_vecs[i];
-	file << "\n};";
-	return file;
-}
-
-void GroundLighting::GenerateVectors() {
-	glm::vec3 vec(0,1,0);
-
-	// most steps are taken at the belly of the sphere, sin(90) = 1.
-	int max_hor_steps = 2*M_PI/GRL_VEC_HOR_DIST;
-
-	std::vector<std::vector<glm::vec3>> all_vecs(GRL_ZENITH_ANGLES+2);
-	all_vecs[0] = std::vector<glm::vec3>(max_hor_steps);
-	all_vecs[0][0] = glm::vec3(0,1,0);
-
-	std::vector<int> hor_counts(GRL_ZENITH_ANGLES+2);
-	hor_counts[0] = 1;
-
-	for (int i = 1; i != GRL_ZENITH_ANGLES+1; ++i) {
-		// don't sample vec3(0,-1,0) GRL_AZIMUTH_ANGLES-times.
-		float zenith_step = float(M_PI_2)/(GRL_ZENITH_ANGLES+1);
-		// azimuth has to complete one circle.
-		glm::mat3 zenith_rot = glm::mat3(glm::rotate(zenith_step, glm::vec3(1,0,0)));
-
-		vec = zenith_rot * vec;
-
-		// calculate azimuth-angle-step based on circumference of sphere at given zenith angle.
-		float zen_circ = sin(zenith_step*i)*2*M_PI;
-		int az_steps = int(zen_circ/GRL_VEC_HOR_DIST);
-		float az_step = float(2*M_PI)/az_steps;
-
-		hor_counts[i] = az_steps;
-		glm::mat3 azimuth_rot = glm::mat3(glm::rotate(az_step, glm::vec3(0,1,0)));
-
-		// default-inserted elements, some overriden subsequently, the rest don't matter.
-		std::vector<glm::vec3> vecs(max_hor_steps);
-		glm::vec3 az_vec = vec;
-		for (int j = 0; j != az_steps; ++j) {
-			az_vec = azimuth_rot * az_vec;
-			vecs[j] = az_vec;
-		}
-		all_vecs[i] = vecs;
-	}
-	all_vecs[GRL_ZENITH_ANGLES+1] = std::vector<glm::vec3>(max_hor_steps);
-	all_vecs[GRL_ZENITH_ANGLES+1][0] = glm::vec3(0,-1,0);
-	hor_counts[GRL_ZENITH_ANGLES+1] = 1;
-
-	std::ofstream vec_header;
-	vec_header.open("data/shader/generated/hemisphere_vecs.glsl");
-	vec_header << "const int hemisphere_hor_sizes[GRL_ZENITH_ANGLES+2] = {\n";
-	vec_header << "\t" << hor_counts[0];
-	for (int i = 1; i != GRL_ZENITH_ANGLES+2; ++i) {
-		vec_header << ",\n\t" << hor_counts[i];
-	}
-	vec_header << "\n};\n";
-	vec_header << "const int hemisphere_vec_count = " << std::accumulate(hor_counts.begin(), hor_counts.end(), 0) << ";\n";
-	vec_header << all_vecs;
-	vec_header.close();
-}
-
 void GroundLighting::CreateComputeImages(VkDevice device) {
 	std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()}; 
 	// vector for contiguous memory.
@@ -308,7 +259,7 @@ void GroundLighting::CreateDescriptors(VkDevice device) {
 	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_SampleDescriptorLayout));
 
 	layoutCreateInfo.pBindings = imageBindings;
-	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_ImageDescriptorLayout));
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_TargetDescriptorLayout));
 
 	VkSamplerCreateInfo sampler;
 	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -335,7 +286,7 @@ void GroundLighting::CreateDescriptors(VkDevice device) {
 	// each image has one sampler and one imageStoreDescriptor.
 	std::vector<VkDescriptorSetLayout> allocLayouts(2);
 	std::fill_n(allocLayouts.begin(), 1, m_SampleDescriptorLayout);
-	std::fill_n(allocLayouts.begin()+1, 1, m_ImageDescriptorLayout);
+	std::fill_n(allocLayouts.begin()+1, 1, m_TargetDescriptorLayout);
 
 	VkDescriptorSetAllocateInfo allocInfo {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -348,8 +299,8 @@ void GroundLighting::CreateDescriptors(VkDevice device) {
 	VkDescriptorSet allocTarget[2];
 	ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, allocTarget));
 
-	m_CubemapSampleDescriptor = allocTarget[0];
-	m_CubemapImageDescriptor = allocTarget[1];
+	m_SampleDescriptor = allocTarget[0];
+	m_TargetDescriptor = allocTarget[1];
 
 	std::vector<VkWriteDescriptorSet> writeDescSets(IMAGE_DESC_COUNT+SAMPLE_DESC_COUNT);
 	std::fill_n(writeDescSets.begin(), IMAGE_DESC_COUNT + SAMPLE_DESC_COUNT, VkWriteDescriptorSet{
@@ -370,26 +321,121 @@ void GroundLighting::CreateDescriptors(VkDevice device) {
 
 	texInfo[0].imageView = m_ImageView,
 	writeDescSets[0].pImageInfo = &texInfo[0];
-	writeDescSets[0].dstSet = m_CubemapImageDescriptor;
+	writeDescSets[0].dstSet = m_TargetDescriptor;
 	writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 
 	texInfo[1].imageView = m_CubeImageView,
 	writeDescSets[1].pImageInfo = &texInfo[1];
-	writeDescSets[1].dstSet = m_CubemapSampleDescriptor;
+	writeDescSets[1].dstSet = m_SampleDescriptor;
 	writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
 	vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
 }
 
+void GroundLighting::CreateSHDescriptors(VkDevice device) {
+	std::vector<VkDescriptorPoolSize> poolSizes {{
+			// read in fragment.
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1
+		}, {
+			// write in compute.
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1
+		}
+	};
+
+	VkDescriptorPoolCreateInfo descPoolCreateInfo;
+	descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolCreateInfo.pNext = nullptr;
+	descPoolCreateInfo.flags = 0;
+	descPoolCreateInfo.maxSets = poolSizes[0].descriptorCount + poolSizes[1].descriptorCount;
+	descPoolCreateInfo.poolSizeCount = poolSizes.size();
+	descPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+	ASSERT_VULKAN(vkCreateDescriptorPool(device, &descPoolCreateInfo, nullptr, &m_DescriptorPool));
+
+	VkDescriptorSetLayoutBinding binding {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = nullptr,
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo;
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = nullptr;
+	layoutCreateInfo.flags = 0;
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &binding;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_SampleDescriptorLayout));
+
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_TargetDescriptorLayout));
+
+	std::vector<VkDescriptorSetLayout> allocLayouts{m_SampleDescriptorLayout, m_TargetDescriptorLayout};
+	VkDescriptorSetAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = m_DescriptorPool,
+		.descriptorSetCount = static_cast<uint32_t>(allocLayouts.size()),
+		.pSetLayouts = allocLayouts.data()
+	};
+
+	VkDescriptorSet allocTarget[2];
+	ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, allocTarget));
+
+	m_SampleDescriptor = allocTarget[0];
+	m_TargetDescriptor = allocTarget[1];
+
+	// both sets view the same buffer.
+	VkDescriptorBufferInfo bufferInfo {
+		.buffer = m_SHBuffer->GetVulkanHandle(),
+		.offset = 0,
+		.range = m_SHBuffer->GetUsedSize()
+	};
+
+	std::vector<VkWriteDescriptorSet> writeDescSets(2, VkWriteDescriptorSet{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.pImageInfo = nullptr,
+		.pBufferInfo = &bufferInfo,
+		.pTexelBufferView = nullptr,
+	});
+
+	writeDescSets[0].dstSet = m_SampleDescriptor;
+	writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+	writeDescSets[1].dstSet = m_TargetDescriptor;
+	writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+}
+
 void GroundLighting::CreateCommandBuffers() {
-	// one buffer for compute, one for transitioning the image.
-	m_CommandPool.AllocateBuffers(1+1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	// the coefficients are always updated at once.
+	size_t faceBuffers = m_Output == GroundLightingOutput::Cubemap ? CUBE_FACES : 0;
+	// per sum target state one buffer for all faces and one per face, one for transitioning the image.
+	m_CommandPool.AllocateBuffers(SUM_TARGET_STATE_COUNT*(1+faceBuffers)+1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	std::vector tmp(m_CommandPool.GetBuffers());
-	m_ComputeCommandBuffer = tmp[0];
-	m_LayoutCommandBuffer = tmp[1];
+	std::copy_n(tmp.begin(), SUM_TARGET_STATE_COUNT, m_ComputeCommandBuffers.begin());
+	for (size_t state = 0; state != SUM_TARGET_STATE_COUNT; ++state)
+		std::copy_n(tmp.begin() + SUM_TARGET_STATE_COUNT + state*faceBuffers, faceBuffers, m_FaceCommandBuffers[state].begin());
+	m_LayoutCommandBuffer = tmp[SUM_TARGET_STATE_COUNT*(1+faceBuffers)];
 }
 
 void GroundLighting::CreateComputePipeline(VkDevice device) {
+	// first face of the dispatch.
+	VkPushConstantRange pcRange = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(uint32_t),
+	};
+
 	std::vector<VkDescriptorSetLayout> apLayouts(7);
 	apLayouts[GRL_SETS_SUN] = m_Sun.GetDescriptorSetLayout();
 	apLayouts[GRL_SETS_RATIO] = m_Precomp.GetRatioDescriptorSetLayout();
@@ -397,15 +443,16 @@ void GroundLighting::CreateComputePipeline(VkDevice device) {
 	apLayouts[GRL_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSetLayout(); 
 	apLayouts[GRL_SETS_SCATTERING_SAMPLER0] =  m_Atmosphere.GetScatteringSampleDescriptorLayout();
 	apLayouts[GRL_SETS_SCATTERING_SAMPLER1] = m_Atmosphere.GetScatteringSampleDescriptorLayout();
-	apLayouts[GRL_SETS_CUBEMAP_IMAGE] = m_ImageDescriptorLayout;
+	// GRL_SETS_SH_BUFFER in spherical harmonics mode.
+	apLayouts[GRL_SETS_CUBEMAP_IMAGE] = m_TargetDescriptorLayout;
 
 	VkPipelineLayoutCreateInfo apLayoutCreateInfo {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.pNext = nullptr,
 		.setLayoutCount = static_cast<uint32_t>(apLayouts.size()),
 		.pSetLayouts = apLayouts.data(),
-		.pushConstantRangeCount = 0,
-		.pPushConstantRanges = nullptr
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pcRange
 	};
 	ASSERT_VULKAN(vkCreatePipelineLayout(device, &apLayoutCreateInfo, nullptr, &m_GLPipelineLayout));
 
@@ -415,7 +462,10 @@ void GroundLighting::CreateComputePipeline(VkDevice device) {
 	compStageCreateInfo.flags = 0;
 	compStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	compStageCreateInfo.pName = "main";
-	compStageCreateInfo.pSpecializationInfo = nullptr;
+	std::vector<VkSpecializationMapEntry> specEntries = LutBlendSpecialization::GetSpecializationMapEntries();
+	LutBlendSpecialization specData{m_Atmosphere.GetResolution(), VK_FALSE};
+	VkSpecializationInfo specInfo = specData.GetSpecializationInfo(specEntries);
+	compStageCreateInfo.pSpecializationInfo = &specInfo;
 
 	VkComputePipelineCreateInfo pipeline;
 	pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -427,6 +477,10 @@ void GroundLighting::CreateComputePipeline(VkDevice device) {
 	pipeline.layout = m_GLPipelineLayout;
 
 	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_GLPipeline));
+
+	// same pipeline, but mixing both sum targets.
+	specData.m_Blend = VK_TRUE;
+	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_GLBlendPipeline));
 }
 
 void GroundLighting::RecordCommandBuffers() {
@@ -436,28 +490,90 @@ void GroundLighting::RecordCommandBuffers() {
 	beginInfo.flags = 0;
 	beginInfo.pInheritanceInfo = nullptr;
 
-	ASSERT_VULKAN(vkBeginCommandBuffer(m_ComputeCommandBuffer, &beginInfo));
-
-	vkCmdBindPipeline(m_ComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_GLPipeline);
-
-	std::vector<VkDescriptorSet> sets(7);
-	sets[GRL_SETS_SUN] = m_Sun.GetDescriptorSet();
-	sets[GRL_SETS_RATIO] = m_Precomp.GetRatioDescriptorSet();
-	sets[GRL_SETS_ENV0] = m_Precomp.GetEffectiveEnv(0).GetDescriptorSet(); 
-	sets[GRL_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSet(); 
-	sets[GRL_SETS_SCATTERING_SAMPLER0] =  m_Atmosphere.GetScatteringSampleDescriptorSet(0);
-	sets[GRL_SETS_SCATTERING_SAMPLER1] = m_Atmosphere.GetScatteringSampleDescriptorSet(1);
-	sets[GRL_SETS_CUBEMAP_IMAGE] = m_CubemapImageDescriptor;
-
-	vkCmdBindDescriptorSets(m_ComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_GLPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
-
-	// X*Y per layer.
-	vkCmdDispatch(m_ComputeCommandBuffer, GRL_X, GRL_Y, CUBE_FACES);
+	m_DescriptorGeneration = m_Atmosphere.GetDescriptorGeneration();
+	// faceCount faces starting at firstFace.
+	auto record = [&](VkCommandBuffer buf, size_t state, uint32_t firstFace, uint32_t faceCount) {
+		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
+
+		// outside of blends the visible sum target is bound as target 0.
+		size_t target0 = Precomputer::GetBoundSumTarget(state, 0);
+		size_t target1 = Precomputer::GetBoundSumTarget(state, 1);
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+			state == SUM_TARGET_STATE_BLEND ? m_GLBlendPipeline : m_GLPipeline);
+
+		std::vector<VkDescriptorSet> sets(7);
+		sets[GRL_SETS_SUN] = m_Sun.GetDescriptorSet();
+		sets[GRL_SETS_RATIO] = m_Precomp.GetRatioDescriptorSet();
+		sets[GRL_SETS_ENV0] = m_Precomp.GetEffectiveEnv(target0).GetDescriptorSet();
+		sets[GRL_SETS_ENV1] = m_Precomp.GetEffectiveEnv(target1).GetDescriptorSet();
+		sets[GRL_SETS_SCATTERING_SAMPLER0] = m_Atmosphere.GetScatteringSampleDescriptorSet(target0);
+		sets[GRL_SETS_SCATTERING_SAMPLER1] = m_Atmosphere.GetScatteringSampleDescriptorSet(target1);
+		sets[GRL_SETS_CUBEMAP_IMAGE] = m_TargetDescriptor;
+
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_GLPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+		if (m_Output == GroundLightingOutput::Cubemap) {
+			vkCmdPushConstants(buf, m_GLPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &firstFace);
+			// X*Y per layer.
+			vkCmdDispatch(buf, GRL_X, GRL_Y, faceCount);
+		} else
+			// a single workgroup sums up all coefficients.
+			vkCmdDispatch(buf, 1, 1, 1);
+
+		vkEndCommandBuffer(buf);
+	};
 
-	vkEndCommandBuffer(m_ComputeCommandBuffer);
+	for (size_t state = 0; state != SUM_TARGET_STATE_COUNT; ++state) {
+		record(m_ComputeCommandBuffers[state], state, 0, CUBE_FACES);
+		if (m_Output == GroundLightingOutput::Cubemap)
+			for (uint32_t face = 0; face != CUBE_FACES; ++face)
+				record(m_FaceCommandBuffers[state][face], state, face, 1);
+	}
 }
 
 void GroundLighting::Compute() {
+	const SunData &sun = m_Sun.GetData();
+	float ratio = m_Precomp.GetRatio();
+
+	// a blend step or new LUTs change every face.
+	bool changed = !m_HasInputs || ratio != m_LastRatio || sun.m_Color != m_LastSunColor;
+	// the atmosphere rewrites the descriptor sets of a sum target when (de)allocating it, while the device is idle.
+	if (m_DescriptorGeneration != m_Atmosphere.GetDescriptorGeneration()) {
+		RecordCommandBuffers();
+		changed = true;
+	}
+	// chord between the directions, close to the angle for small movements.
+	bool sunMoved = glm::distance(sun.m_SunDir, m_LastSunDir) > m_SunThreshold;
+
+	size_t state = m_Precomp.GetSumTargetState();
+	VkCommandBuffer buf;
+	// the coefficients are cheap enough to always update at once.
+	bool incremental = m_Incremental && m_Output == GroundLightingOutput::Cubemap;
+	if (changed || (sunMoved && !incremental)) {
+		buf = m_ComputeCommandBuffers[state];
+		m_StaleFaces = 0;
+		m_LastFaces = CUBE_FACES;
+
+		m_HasInputs = true;
+		m_LastSunDir = sun.m_SunDir;
+		m_LastSunColor = sun.m_Color;
+		m_LastRatio = ratio;
+	} else {
+		// the faces lag behind by at most CUBE_FACES frames while the sun keeps moving.
+		if (sunMoved) {
+			m_StaleFaces = CUBE_FACES;
+			m_LastSunDir = sun.m_SunDir;
+		}
+		// the cubemap is up to date, keep it.
+		if (m_StaleFaces == 0) {
+			m_LastFaces = 0;
+			return;
+		}
+		buf = m_FaceCommandBuffers[state][m_NextFace];
+		m_NextFace = (m_NextFace+1) % CUBE_FACES;
+		--m_StaleFaces;
+		m_LastFaces = 1;
+	}
+
 	VkSubmitInfo submitInfo;
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pNext = nullptr;
@@ -467,17 +583,38 @@ void GroundLighting::Compute() {
 	submitInfo.signalSemaphoreCount = 0;
 	submitInfo.pSignalSemaphores = nullptr;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_ComputeCommandBuffer;
+	submitInfo.pCommandBuffers = &buf;
 
 	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 }
 
+void GroundLighting::RenderImgui() {
+	ImGui::Begin("Ground lighting");
+	ImGui::DragFloat("SunThreshold", &m_SunThreshold, 0.0001, 0, 0.1, "%.4f");
+	if (m_Output == GroundLightingOutput::Cubemap) {
+		ImGui::Text("Output: cubemap");
+		ImGui::Checkbox("Incremental", &m_Incremental);
+	} else
+		ImGui::Text("Output: spherical harmonics");
+	if (m_LastFaces == 0)
+		ImGui::Text("Last frame: unchanged, skipped");
+	else if (m_Output == GroundLightingOutput::Cubemap)
+		ImGui::Text("Last frame: %u/%u faces updated", m_LastFaces, CUBE_FACES);
+	else
+		ImGui::Text("Last frame: updated");
+	ImGui::End();
+}
+
 VkDescriptorSet GroundLighting::GetSampleDescriptorSet() const {
-	return m_CubemapSampleDescriptor;
+	return m_SampleDescriptor;
 }
 
 VkDescriptorSetLayout GroundLighting::GetSampleDescriptorLayout() const {
 	return m_SampleDescriptorLayout;
 }
 
+GroundLightingOutput GroundLighting::GetOutput() const {
+	return m_Output;
+}
+
 } // namespace en
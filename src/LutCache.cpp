@@ -0,0 +1,183 @@
+#include <engine/graphics/LutCache.hpp>
+#include <engine/util/Log.hpp>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <scattering.h>
+#include <gathering.h>
+#include <transmittance.h>
+
+// "SKYLUT" + two bytes padding.
+static const char lutCacheMagic[8] = {'S', 'K', 'Y', 'L', 'U', 'T', 0, 0};
+
+namespace en {
+
+LutCache::LutCache(const std::string &directory, const AtmosphereResolution &resolution) :
+	m_Directory{directory},
+	m_Resolution{resolution} {
+	std::error_code error;
+	std::filesystem::create_directories(m_Directory, error);
+	if (error)
+		Log::Warn("Failed to create LUT cache directory " + m_Directory + ", LUTs will not be cached");
+}
+
+LutKey LutKey::Create(const EnvConditions::Environment &env, const AtmosphereResolution &resolution) {
+	// only 4 byte members, no padding, so it can be compared/hashed bytewise.
+	static_assert(sizeof(LutKey) == sizeof(uint32_t) + sizeof(LutKey::m_Constants) + sizeof(EnvConditions::Environment));
+	LutKey key{};
+	key.m_Version = LUT_CACHE_VERSION;
+	key.m_Constants[0] = resolution.m_TransmittanceHeight;
+	key.m_Constants[1] = resolution.m_TransmittanceView;
+	key.m_Constants[2] = TRANSMITTANCE_STEP_LENGTH;
+	key.m_Constants[3] = resolution.m_ScatteringHeight;
+	key.m_Constants[4] = resolution.m_ScatteringView;
+	key.m_Constants[5] = resolution.m_ScatteringSun;
+	key.m_Constants[6] = SCATTERING_STEP_LENGTH;
+	key.m_Constants[7] = SCATTERING_ORDERS;
+	key.m_Constants[8] = resolution.m_GatheringHeight << 16 | resolution.m_GatheringSun;
+	key.m_Constants[9] = GATHERING_STEPS;
+	key.m_Constants[10] = TRANSMITTANCE_INTEGRATOR;
+	key.m_Constants[11] =
+		TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_GAUSS_LEGENDRE ? TRANSMITTANCE_GAUSS_LEGENDRE_SEGMENTS :
+		TRANSMITTANCE_INTEGRATOR == TRANSMITTANCE_INTEGRATOR_TRAPEZOID ? TRANSMITTANCE_TRAPEZOID_STEPS : 0;
+	key.m_Env = env;
+	// only used by the phase functions while rendering, the LUTs don't depend on it (see Precomputer::InvalidatedStages).
+	key.m_Env.m_AsymmetryFactor = 0.0f;
+	return key;
+}
+
+bool LutKey::operator==(const LutKey &other) const {
+	return std::memcmp(this, &other, sizeof(LutKey)) == 0;
+}
+
+void WriteLutData(std::ostream &stream, const AtmosphereLuts &luts) {
+	for (const std::vector<char> *lut : {&luts.m_Transmittance, &luts.m_ScatteringSum, &luts.m_GatheringSum}) {
+		uint64_t size = lut->size();
+		stream.write(reinterpret_cast<const char *>(&size), sizeof(size));
+		stream.write(lut->data(), size);
+	}
+}
+
+// in bytes, in the order they are written.
+static std::array<uint64_t, 3> GetLutSizes(const AtmosphereResolution &resolution) {
+	uint64_t texelSize = GetLutFormatInfo(AtmosphereLuts::m_Format).m_TexelSize;
+	return {
+		texelSize * resolution.m_TransmittanceHeight * resolution.m_TransmittanceView,
+		texelSize * resolution.m_ScatteringHeight * resolution.m_ScatteringView * resolution.m_ScatteringSun,
+		texelSize * resolution.m_GatheringHeight * resolution.m_GatheringSun};
+}
+
+bool ReadLutData(std::istream &stream, const AtmosphereResolution &resolution, AtmosphereLuts &luts) {
+	std::array<uint64_t, 3> expectedSizes = GetLutSizes(resolution);
+	AtmosphereLuts loaded;
+	std::array<std::vector<char> *, 3> targets = {&loaded.m_Transmittance, &loaded.m_ScatteringSum, &loaded.m_GatheringSum};
+	for (size_t i = 0; i != targets.size(); ++i) {
+		uint64_t size;
+		stream.read(reinterpret_cast<char *>(&size), sizeof(size));
+		// the size comes from the file, don't allocate before it is known to be sane.
+		if (!stream || size != expectedSizes[i])
+			return false;
+		std::vector<char> *lut = targets[i];
+		lut->resize(size);
+		stream.read(lut->data(), size);
+	}
+	if (!stream)
+		return false;
+
+	luts = std::move(loaded);
+	return true;
+}
+
+bool SkipLutData(std::istream &stream) {
+	for (int i = 0; i != 3; ++i) {
+		uint64_t size;
+		stream.read(reinterpret_cast<char *>(&size), sizeof(size));
+		if (!stream)
+			return false;
+		stream.seekg(size, std::ios::cur);
+	}
+	return bool(stream);
+}
+
+std::string LutCache::GetPath(const LutKey &key) const {
+	// FNV-1a over the key.
+	uint64_t hash = 14695981039346656037ull;
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&key);
+	for (size_t i = 0; i != sizeof(LutKey); ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	std::stringstream name;
+	name << "lut_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+	return (std::filesystem::path(m_Directory) / name.str()).string();
+}
+
+bool LutCache::Contains(const EnvConditions::Environment &env) const {
+	LutKey key = LutKey::Create(env, m_Resolution);
+	std::ifstream file(GetPath(key), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	char magic[sizeof(lutCacheMagic)];
+	LutKey fileKey;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&fileKey), sizeof(fileKey));
+	return file
+		&& std::memcmp(magic, lutCacheMagic, sizeof(magic)) == 0
+		&& fileKey == key;
+}
+
+bool LutCache::Load(const EnvConditions::Environment &env, AtmosphereLuts &luts) const {
+	LutKey key = LutKey::Create(env, m_Resolution);
+	std::string path = GetPath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	char magic[sizeof(lutCacheMagic)];
+	LutKey fileKey;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&fileKey), sizeof(fileKey));
+	// hash collision or outdated file, will be overwritten by Store.
+	if (!file || std::memcmp(magic, lutCacheMagic, sizeof(magic)) != 0 || !(fileKey == key))
+		return false;
+
+	if (!ReadLutData(file, m_Resolution, luts)) {
+		Log::Warn("LUT cache file " + path + " is truncated or corrupt, ignoring it");
+		return false;
+	}
+	return true;
+}
+
+void LutCache::Store(const EnvConditions::Environment &env, const AtmosphereLuts &luts) const {
+	LutKey key = LutKey::Create(env, m_Resolution);
+	std::string path = GetPath(key);
+	// write to a temporary file first, a crash mid-write must not leave a truncated entry.
+	std::string tmpPath = path + ".tmp";
+	std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		Log::Warn("Failed to open LUT cache file " + tmpPath);
+		return;
+	}
+
+	file.write(lutCacheMagic, sizeof(lutCacheMagic));
+	file.write(reinterpret_cast<const char *>(&key), sizeof(key));
+	WriteLutData(file, luts);
+	file.close();
+	if (!file) {
+		Log::Warn("Failed to write LUT cache file " + tmpPath);
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error)
+		Log::Warn("Failed to move LUT cache file to " + path);
+}
+
+}
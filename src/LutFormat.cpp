@@ -0,0 +1,203 @@
+#include <engine/graphics/LutFormat.hpp>
+#include <engine/graphics/VulkanAPI.hpp>
+#include <engine/util/Log.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace en {
+
+// index is the LutFormat.
+static const LutFormatInfo lutFormatInfos[] {
+	{VK_FORMAT_R16G16B16A16_UNORM, "R16G16B16A16_UNORM", 8, 4, 0.5f/65535.0f},
+	{VK_FORMAT_R16G16B16A16_SNORM, "R16G16B16A16_SNORM", 8, 4, 0.5f/32767.0f},
+	// half a step of the 5 bit mantissa of blue in [0.5, 1).
+	{VK_FORMAT_B10G11R11_UFLOAT_PACK32, "B10G11R11_UFLOAT", 4, 3, 1.0f/128.0f},
+	// half a step of the 9 bit mantissa if the largest channel is in [1, 2), values close to 1 round up into it.
+	{VK_FORMAT_E5B9G9R9_UFLOAT_PACK32, "E5B9G9R9_UFLOAT", 4, 3, 1.0f/512.0f},
+	// half a step of the 10 bit mantissa in [0.5, 1).
+	{VK_FORMAT_R16G16B16A16_SFLOAT, "R16G16B16A16_SFLOAT", 8, 4, 1.0f/4096.0f}
+};
+
+const LutFormatInfo &GetLutFormatInfo(LutFormat format) {
+	return lutFormatInfos[static_cast<int>(format)];
+}
+
+// unsigned float with a 5 bit exponent (bias 15), as used by B10G11R11.
+static uint32_t PackUfloat(float v, int mantissaBits) {
+	// also catches NaN.
+	if (!(v > 0))
+		return 0;
+	int exponent;
+	float fraction = std::frexp(v, &exponent);
+	int biased = exponent - 1 + 15;
+	uint32_t bits;
+	if (biased <= 0)
+		// denormal, v = m * 2^-14 / 2^mantissaBits.
+		bits = uint32_t(std::round(std::ldexp(v, 14 + mantissaBits)));
+	else
+		// a mantissa rounded up to 2^mantissaBits carries into the exponent.
+		bits = (uint32_t(biased) << mantissaBits) + uint32_t(std::round(std::ldexp(fraction*2 - 1, mantissaBits)));
+	// largest finite value.
+	return std::min(bits, (30u << mantissaBits) | ((1u << mantissaBits) - 1));
+}
+
+static float UnpackUfloat(uint32_t bits, int mantissaBits) {
+	uint32_t exponent = bits >> mantissaBits;
+	uint32_t mantissa = bits & ((1u << mantissaBits) - 1);
+	if (exponent == 0)
+		return std::ldexp(float(mantissa), -14 - mantissaBits);
+	return std::ldexp(1 + std::ldexp(float(mantissa), -mantissaBits), int(exponent) - 15);
+}
+
+// half float, the magnitude is an unsigned float with a 10 bit mantissa.
+static uint16_t PackHalf(float v) {
+	return uint16_t((std::signbit(v) ? 0x8000u : 0u) | PackUfloat(std::abs(v), 10));
+}
+
+static float UnpackHalf(uint16_t bits) {
+	float v = UnpackUfloat(bits & 0x7fff, 10);
+	return bits & 0x8000 ? -v : v;
+}
+
+// shared exponent encoding from the Vulkan specification (N = 9, B = 15, Emax = 31).
+static uint32_t PackE5B9G9R9(const float *rgb) {
+	const int N = 9, B = 15;
+	const float sharedMax = float((1 << N) - 1)/(1 << N) * std::ldexp(1.0f, 31 - B);
+
+	float c[3];
+	for (int i = 0; i != 3; ++i)
+		c[i] = std::isnan(rgb[i]) ? 0 : std::clamp(rgb[i], 0.0f, sharedMax);
+	float maxC = std::max({c[0], c[1], c[2]});
+
+	int exponent = std::max(-B-1, maxC > 0 ? int(std::floor(std::log2(maxC))) : -B-1) + 1 + B;
+	if (std::floor(std::ldexp(maxC, -(exponent - B - N)) + 0.5f) == (1 << N))
+		++exponent;
+
+	uint32_t bits = uint32_t(exponent) << 27;
+	for (int i = 0; i != 3; ++i)
+		bits |= uint32_t(std::floor(std::ldexp(c[i], -(exponent - B - N)) + 0.5f)) << (9*i);
+	return bits;
+}
+
+static void UnpackE5B9G9R9(uint32_t bits, float *rgb) {
+	int exponent = int(bits >> 27);
+	for (int i = 0; i != 3; ++i)
+		rgb[i] = std::ldexp(float((bits >> (9*i)) & 0x1ff), exponent - 15 - 9);
+}
+
+std::vector<char> EncodeLut(LutFormat format, const float *texels, size_t count) {
+	const LutFormatInfo &info = GetLutFormatInfo(format);
+	std::vector<char> data(count*info.m_TexelSize);
+	for (size_t i = 0; i != count; ++i) {
+		const float *texel = texels + 4*i;
+		char *target = &data[i*info.m_TexelSize];
+		switch (format) {
+			case LutFormat::Rgba16Unorm:
+				for (int c = 0; c != 4; ++c) {
+					uint16_t value = uint16_t(std::round(std::clamp(texel[c], 0.0f, 1.0f)*65535.0f));
+					std::memcpy(target + c*sizeof(value), &value, sizeof(value));
+				}
+				break;
+			case LutFormat::Rgba16Snorm:
+				for (int c = 0; c != 4; ++c) {
+					int16_t value = int16_t(std::round(std::clamp(texel[c], -1.0f, 1.0f)*32767.0f));
+					std::memcpy(target + c*sizeof(value), &value, sizeof(value));
+				}
+				break;
+			case LutFormat::B10G11R11Ufloat: {
+				uint32_t bits = PackUfloat(texel[0], 6) | PackUfloat(texel[1], 6) << 11 | PackUfloat(texel[2], 5) << 22;
+				std::memcpy(target, &bits, sizeof(bits));
+				break;
+			}
+			case LutFormat::E5B9G9R9Ufloat: {
+				uint32_t bits = PackE5B9G9R9(texel);
+				std::memcpy(target, &bits, sizeof(bits));
+				break;
+			}
+			case LutFormat::Rgba16Sfloat:
+				for (int c = 0; c != 4; ++c) {
+					uint16_t value = PackHalf(texel[c]);
+					std::memcpy(target + c*sizeof(value), &value, sizeof(value));
+				}
+				break;
+		}
+	}
+	return data;
+}
+
+std::vector<float> DecodeLut(LutFormat format, const std::vector<char> &data) {
+	const LutFormatInfo &info = GetLutFormatInfo(format);
+	size_t count = data.size()/info.m_TexelSize;
+	std::vector<float> texels(4*count, 0.0f);
+	for (size_t i = 0; i != count; ++i) {
+		float *texel = &texels[4*i];
+		const char *source = &data[i*info.m_TexelSize];
+		switch (format) {
+			case LutFormat::Rgba16Unorm:
+				for (int c = 0; c != 4; ++c) {
+					uint16_t value;
+					std::memcpy(&value, source + c*sizeof(value), sizeof(value));
+					texel[c] = value/65535.0f;
+				}
+				break;
+			case LutFormat::Rgba16Snorm:
+				for (int c = 0; c != 4; ++c) {
+					int16_t value;
+					std::memcpy(&value, source + c*sizeof(value), sizeof(value));
+					// -32768 maps to -1 as well.
+					texel[c] = std::max(value/32767.0f, -1.0f);
+				}
+				break;
+			case LutFormat::B10G11R11Ufloat: {
+				uint32_t bits;
+				std::memcpy(&bits, source, sizeof(bits));
+				texel[0] = UnpackUfloat(bits & 0x7ff, 6);
+				texel[1] = UnpackUfloat(bits >> 11 & 0x7ff, 6);
+				texel[2] = UnpackUfloat(bits >> 22, 5);
+				break;
+			}
+			case LutFormat::E5B9G9R9Ufloat: {
+				uint32_t bits;
+				std::memcpy(&bits, source, sizeof(bits));
+				UnpackE5B9G9R9(bits, texel);
+				break;
+			}
+			case LutFormat::Rgba16Sfloat:
+				for (int c = 0; c != 4; ++c) {
+					uint16_t value;
+					std::memcpy(&value, source + c*sizeof(value), sizeof(value));
+					texel[c] = UnpackHalf(value);
+				}
+				break;
+		}
+	}
+	return texels;
+}
+
+std::vector<char> ConvertLut(LutFormat from, LutFormat to, const std::vector<char> &data) {
+	if (from == to)
+		return data;
+	std::vector<float> texels = DecodeLut(from, data);
+	return EncodeLut(to, texels.data(), texels.size()/4);
+}
+
+LutFormat SelectLutFormat(const std::vector<LutFormat> &candidates, const LutFormatRequirements &requirements, VkFormatFeatureFlags features) {
+	assert(!candidates.empty());
+	bool writeWithoutFormat = VulkanAPI::GetEnabledFeatures().shaderStorageImageWriteWithoutFormat == VK_TRUE;
+	for (size_t i = 0; i+1 < candidates.size() && writeWithoutFormat; ++i) {
+		const LutFormatInfo &info = GetLutFormatInfo(candidates[i]);
+		if (info.m_Channels >= requirements.m_Channels
+			&& info.m_MaxError <= requirements.m_MaxError
+			&& VulkanAPI::IsFormatSupported(info.m_VkFormat, VK_IMAGE_TILING_OPTIMAL, features))
+			return candidates[i];
+	}
+
+	LutFormat fallback = candidates.back();
+	if (!VulkanAPI::IsFormatSupported(GetLutFormatInfo(fallback).m_VkFormat, VK_IMAGE_TILING_OPTIMAL, features))
+		Log::Warn(std::string("LUT format ") + GetLutFormatInfo(fallback).m_Name + " lacks required features");
+	return fallback;
+}
+
+}
@@ -0,0 +1,113 @@
+#include <engine/graphics/LutPack.hpp>
+#include <engine/util/Log.hpp>
+#include <cstring>
+#include <fstream>
+
+static const char lutPackMagic[8] = {'S', 'K', 'Y', 'L', 'U', 'T', 'P', 'K'};
+// names are stored with fixed length, including the terminating zero.
+#define LUT_PACK_NAME_LENGTH 32
+
+namespace en {
+
+LutPack::LutPack(const AtmosphereResolution &resolution) : m_Resolution{resolution} { }
+
+std::string LutPack::GetDefaultPath(AtmosphereQuality quality) {
+	return std::string("data/lut_pack_") + AtmosphereResolution::GetQualityName(quality) + ".bin";
+}
+
+void LutPack::Add(const std::string &name, const EnvConditions::Environment &env, const AtmosphereLuts &luts) {
+	m_Entries.push_back({name.substr(0, LUT_PACK_NAME_LENGTH-1), LutKey::Create(env, m_Resolution), luts});
+}
+
+bool LutPack::Load(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	char magic[sizeof(lutPackMagic)];
+	uint32_t version;
+	uint32_t entryCount;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&version), sizeof(version));
+	file.read(reinterpret_cast<char *>(&entryCount), sizeof(entryCount));
+	if (!file || std::memcmp(magic, lutPackMagic, sizeof(magic)) != 0 || version != LUT_PACK_VERSION) {
+		Log::Warn(path + " is not a LUT pack of version " + std::to_string(LUT_PACK_VERSION));
+		return false;
+	}
+
+	std::vector<Entry> entries;
+	for (uint32_t i = 0; i != entryCount; ++i) {
+		char name[LUT_PACK_NAME_LENGTH];
+		Entry entry;
+		file.read(name, sizeof(name));
+		file.read(reinterpret_cast<char *>(&entry.m_Key), sizeof(entry.m_Key));
+		if (!file) {
+			Log::Warn("LUT pack " + path + " is truncated");
+			return false;
+		}
+		name[LUT_PACK_NAME_LENGTH-1] = '\0';
+		entry.m_Name = name;
+
+		// still usable if the environment matches, but computed with different constants or resolution.
+		if (!(entry.m_Key == LutKey::Create(entry.m_Key.m_Env, m_Resolution))) {
+			if (!SkipLutData(file)) {
+				Log::Warn("LUT pack " + path + " is truncated");
+				return false;
+			}
+			Log::Warn("Skipping outdated LUT pack entry " + entry.m_Name);
+			continue;
+		}
+		// the key matches, so the sizes must match the resolution.
+		if (!ReadLutData(file, m_Resolution, entry.m_Luts)) {
+			Log::Warn("LUT pack " + path + " is truncated or corrupt");
+			return false;
+		}
+		entries.push_back(std::move(entry));
+	}
+
+	m_Entries = std::move(entries);
+	Log::Info("Loaded " + std::to_string(m_Entries.size()) + " presets from LUT pack " + path);
+	return true;
+}
+
+bool LutPack::Save(const std::string &path) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		Log::Warn("Failed to open LUT pack " + path);
+		return false;
+	}
+
+	uint32_t version = LUT_PACK_VERSION;
+	uint32_t entryCount = m_Entries.size();
+	file.write(lutPackMagic, sizeof(lutPackMagic));
+	file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+	file.write(reinterpret_cast<const char *>(&entryCount), sizeof(entryCount));
+	for (const Entry &entry : m_Entries) {
+		char name[LUT_PACK_NAME_LENGTH] = {};
+		std::strncpy(name, entry.m_Name.c_str(), LUT_PACK_NAME_LENGTH-1);
+		file.write(name, sizeof(name));
+		file.write(reinterpret_cast<const char *>(&entry.m_Key), sizeof(entry.m_Key));
+		WriteLutData(file, entry.m_Luts);
+	}
+	file.close();
+
+	if (!file) {
+		Log::Warn("Failed to write LUT pack " + path);
+		return false;
+	}
+	return true;
+}
+
+const AtmosphereLuts *LutPack::Find(const EnvConditions::Environment &env) const {
+	LutKey key = LutKey::Create(env, m_Resolution);
+	for (const Entry &entry : m_Entries)
+		if (entry.m_Key == key)
+			return &entry.m_Luts;
+	return nullptr;
+}
+
+const std::vector<LutPack::Entry> &LutPack::GetEntries() const {
+	return m_Entries;
+}
+
+}
@@ -1,8 +1,10 @@
 #include "engine/graphics/EnvConditions.hpp"
 #include <cstdio>
 #include <engine/graphics/Precomputer.hpp>
+#include <engine/graphics/CpuPrecomputer.hpp>
 #include <imgui.h>
 #include <iterator>
+#include <algorithm>
 #include <vulkan/vulkan_core.h>
 
 #include <scattering.h>
@@ -10,76 +12,201 @@
 
 namespace en {
 
-Precomputer::PrecomputeTask::PrecomputeTask(Instantiater *instantiater, uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter *currentBuffer, VkDescriptorSet env) :
-	m_Instantiater{instantiater},
+// images are indexed by AtmosphereImage, the sum images additionally by sum target.
+#define PRECOMPUTE_IMAGE_COUNT 5
+// timestamps per half of the query pool, batches with more nodes are not measured.
+#define PRECOMPUTE_QUERIES_PER_BATCH 64
+
+const char *precomputeStageNames[PRECOMPUTE_STAGE_COUNT] = {
+	"GatheringClear",
+	"Transmittance",
+	"SingleScattering",
+	"Gathering",
+	"MultiScattering"
+};
+
+#define STAGE_BIT(stage) (1u << uint32_t(PrecomputeStage::stage))
+
+// stages that directly read a parameter, see Precomputer::InvalidatedStages for the ones depending on them.
+// The AsymmetryFactor is only used for the phase functions, which are evaluated while rendering.
+const PrecomputeStageFlags heightStages =
+	STAGE_BIT(Transmittance) | STAGE_BIT(SingleScattering) | STAGE_BIT(Gathering) | STAGE_BIT(MultiScattering);
+const PrecomputeStageFlags extinctionStages = STAGE_BIT(Transmittance) | STAGE_BIT(SingleScattering) | STAGE_BIT(MultiScattering);
+const PrecomputeStageFlags phaseStages = 0;
+
+// stages that read the results of a stage.
+const PrecomputeStageFlags downstreamStages[PRECOMPUTE_STAGE_COUNT] = {
+	// GatheringClear.
+	STAGE_BIT(Gathering),
+	// Transmittance.
+	STAGE_BIT(SingleScattering) | STAGE_BIT(Gathering) | STAGE_BIT(MultiScattering),
+	// SingleScattering.
+	STAGE_BIT(Gathering),
+	// Gathering: the sum has to start from zero again.
+	STAGE_BIT(GatheringClear) | STAGE_BIT(MultiScattering),
+	// MultiScattering.
+	STAGE_BIT(Gathering)
+};
+
+Precomputer::PrecomputeNode::PrecomputeNode(PrecomputeStage stage, uint32_t offset, uint32_t count, uint32_t sumTarget, VkDescriptorSet env) :
+	m_Index{0},
+	m_PipelineStage{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT},
+	m_Stage{stage},
 	m_Offset{offset},
 	m_Count{count},
 	m_SumTarget{sumTarget},
-	m_CurrentBuffer{currentBuffer},
-	m_EnvDescSet{env} { }
+	m_EnvDescSet{env} {
+
+	switch (stage) {
+		case PrecomputeStage::GatheringClear:
+			m_Accesses = {{AtmosphereImage::GatheringSum, true}};
+			m_PipelineStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			break;
+		case PrecomputeStage::Transmittance:
+			m_Accesses = {{AtmosphereImage::Transmittance, true}};
+			break;
+		case PrecomputeStage::SingleScattering:
+			m_Accesses = {
+				{AtmosphereImage::Transmittance, false},
+				{AtmosphereImage::Scattering, true},
+				{AtmosphereImage::ScatteringSum, true} };
+			break;
+		case PrecomputeStage::Gathering:
+			m_Accesses = {
+				{AtmosphereImage::Transmittance, false},
+				{AtmosphereImage::Scattering, false},
+				{AtmosphereImage::Gathering, true},
+				{AtmosphereImage::GatheringSum, true} };
+			break;
+		case PrecomputeStage::MultiScattering:
+			m_Accesses = {
+				{AtmosphereImage::Transmittance, false},
+				{AtmosphereImage::Gathering, false},
+				{AtmosphereImage::Scattering, true},
+				{AtmosphereImage::ScatteringSum, true} };
+			break;
+	}
+}
 
-InstantiaterResult Precomputer::PrecomputeTask::Instantiate() {
-	return (*m_Instantiater)(m_Offset, m_Count, m_SumTarget, *m_CurrentBuffer, m_EnvDescSet);
+void Precomputer::PrecomputeNode::Record(Atmosphere &atmosphere, VkCommandBuffer buf) const {
+	switch (m_Stage) {
+		case PrecomputeStage::GatheringClear:
+			atmosphere.RecordGatheringSumClear(buf, m_SumTarget);
+			break;
+		case PrecomputeStage::Transmittance:
+			atmosphere.RecordTransmittance(buf, m_SumTarget, m_EnvDescSet);
+			break;
+		case PrecomputeStage::SingleScattering:
+			atmosphere.RecordSingleScattering(buf, m_Offset, m_Count, m_SumTarget, m_EnvDescSet);
+			break;
+		case PrecomputeStage::Gathering:
+			atmosphere.RecordGathering(buf, m_Offset, m_Count, m_SumTarget, m_EnvDescSet);
+			break;
+		case PrecomputeStage::MultiScattering:
+			atmosphere.RecordMultiScattering(buf, m_Offset, m_Count, m_SumTarget, m_EnvDescSet);
+			break;
+	}
 }
 
-bool Precomputer::PrecomputeTask::Combine(Precomputer::PrecomputeTask &subsequent) {
-	if (subsequent.m_Instantiater == m_Instantiater &&
+bool Precomputer::PrecomputeNode::Combine(const Precomputer::PrecomputeNode &subsequent) {
+	if (subsequent.m_Stage == m_Stage &&
 		m_Offset + m_Count == subsequent.m_Offset) {
 			m_Count += subsequent.m_Count;
+			// disjoint rows of one stage never depend on each other, so no dependency on this node is added.
+			m_Dependencies.insert(m_Dependencies.end(), subsequent.m_Dependencies.begin(), subsequent.m_Dependencies.end());
 			return true;
 		}
 
-	// couldn't combine this and the subsequent task into one.
+	// couldn't combine this and the subsequent node into one.
 	return false;
 }
 
-void Precomputer::_init(size_t sumTarget)
+PrecomputeStageFlags Precomputer::InvalidatedStages(const EnvConditions::Environment &old, const EnvConditions::Environment &current) {
+	PrecomputeStageFlags stages = 0;
+	if (old.m_PlanetRadius != current.m_PlanetRadius ||
+		old.m_AtmosphereHeight != current.m_AtmosphereHeight)
+		stages |= heightStages;
+	if (old.m_OzoneExtinctionCoefficient != current.m_OzoneExtinctionCoefficient ||
+		old.m_RefractiveIndexAir != current.m_RefractiveIndexAir ||
+		old.m_AirDensityAtSeaLevel != current.m_AirDensityAtSeaLevel ||
+		old.m_MieScatteringCoefficient != current.m_MieScatteringCoefficient ||
+		old.m_RayleighScaleHeight != current.m_RayleighScaleHeight ||
+		old.m_MieScaleHeight != current.m_MieScaleHeight)
+		stages |= extinctionStages;
+	if (old.m_AsymmetryFactor != current.m_AsymmetryFactor)
+		stages |= phaseStages;
+
+	// propagate until nothing changes anymore.
+	PrecomputeStageFlags previous;
+	do {
+		previous = stages;
+		for (size_t i = 0; i != PRECOMPUTE_STAGE_COUNT; ++i)
+			if (stages & (1u << i))
+				stages |= downstreamStages[i];
+	} while (stages != previous);
+
+	return stages;
+}
+
+void Precomputer::Start(const EnvConditions::Environment &env, uint32_t sumTarget)
 {
-	// This is an upper limit for the number of buffers/steps, very well possible that fewer are actually needed.
-	// Each step gets its own command buffer, so we need stepsPerScatteringOrder for each scattering order.
-	// Allocate an additional SCATTERING_ORDERS Buffers for Gathering and one buffer for transmittance.
-	m_MaxSteps = SCATTERING_ORDERS*(m_StepsPerScatteringOrder+1)+1;
-
-	// unique would be enough, but it has to be passed to a std::function,
-	// which is copyable and therefore cannot deal with an unique_ptr.
-	auto commandPool = std::make_shared<vk::CommandPool>(0, VulkanAPI::GetComputeQFI());
-	commandPool->AllocateBuffers(m_MaxSteps, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-
-	// snapshot current settings so they cannot be changed while precomputing.
-	auto envConds = std::make_shared<EnvConditions>(m_Env.GetEnvironment());
-
-	// order of cleanup in ~Precomputer doesn't matter.
-	// Will be called either after precomputation is done or in this instances destructor.
-	auto cleanupIter = m_CleanupTasks.insert(m_CleanupTasks.begin(),
-		[commandPool, envConds]() {
-			commandPool->FreeBuffers();
-			commandPool->Destroy();
-			// envConds goes out of scope here (will not be optimized away as per standard),
-			// so its' destructor is called.
-		} );
-
-	std::vector<VkCommandBuffer> buffers = commandPool->GetBuffers();
-	std::vector<VkCommandBuffer>::iterator currentBuffer = buffers.begin();
-
-	CreateFrameTasks(CreateTasks(m_StepsPerScatteringOrder, sumTarget, currentBuffer, envConds->GetDescriptorSet()), m_StepsPerFrame, cleanupIter, envConds, sumTarget);
-	m_CurrentFrameTask = m_FrameTasks.begin();
-	m_AllTasksRun = false;
-}
-
-InstantiaterResult runBufferFunction(VkCommandBuffer buf) {
-	return [buf]() {
-		VkSubmitInfo submitInfo;
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pNext = nullptr;
-		submitInfo.waitSemaphoreCount = 0;
-		submitInfo.pWaitDstStageMask = nullptr;
-		submitInfo.signalSemaphoreCount = 0;
-		submitInfo.pSignalSemaphores = nullptr;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &buf;
-
-		ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-	};
+	m_Atmosphere.AllocateScratch();
+	AllocateSumTarget(sumTarget);
+	m_Active = std::make_unique<Precomputation>();
+
+	// snapshot settings so they cannot be changed while precomputing.
+	m_Active->m_Env = std::make_unique<EnvConditions>(env);
+	m_Active->m_Environment = env;
+	m_Active->m_SumTarget = sumTarget;
+
+	// adaptive scheduling decides per frame how many rows to take, so split into single rows.
+	if (m_Adaptive)
+		m_Active->m_Nodes = CreateNodes(
+			m_Atmosphere.GetResolution().m_ScatteringHeight,
+			m_Atmosphere.GetResolution().m_GatheringHeight,
+			sumTarget,
+			m_Active->m_Env->GetDescriptorSet());
+	else
+		// gathering doesn't need to be split up.
+		m_Active->m_Nodes = CreateNodes(m_StepsPerScatteringOrder, 1, sumTarget, m_Active->m_Env->GetDescriptorSet());
+	ResolveDependencies(m_Active->m_Nodes);
+	m_Active->m_NextNode = 0;
+	m_Active->m_NextBuffer = 0;
+
+	// This is an upper limit for the number of buffers/batches, very well possible that fewer are actually needed.
+	m_Active->m_CommandPool = AcquireCommandPool(m_Active->m_Nodes.size());
+}
+
+void Precomputer::Retire(std::unique_ptr<Precomputation> precomputation)
+{
+	// nodes are submitted in order, the last one is the last to complete.
+	uint64_t value = precomputation->m_NodeValues.empty() ? 0 : precomputation->m_NodeValues.back();
+	m_Retired.push_back({
+		std::move(precomputation->m_CommandPool),
+		std::move(precomputation->m_Env),
+		value });
+}
+
+std::unique_ptr<vk::CommandPool> Precomputer::AcquireCommandPool(uint32_t bufferCount)
+{
+	for (auto it = m_Retired.begin(); it != m_Retired.end(); ++it) {
+		if (!IsComplete(it->m_Value))
+			continue;
+
+		// the env snapshot is destroyed with the entry, it isn't used by the GPU anymore.
+		std::unique_ptr<vk::CommandPool> commandPool = std::move(it->m_CommandPool);
+		m_Retired.erase(it);
+
+		commandPool->Reset();
+		if (commandPool->GetBufferCount() < bufferCount)
+			commandPool->AllocateBuffers(bufferCount - commandPool->GetBufferCount(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		return commandPool;
+	}
+
+	// all retired pools are still in flight (or there are none yet).
+	auto commandPool = std::make_unique<vk::CommandPool>(0, VulkanAPI::GetComputeQFI());
+	commandPool->AllocateBuffers(bufferCount, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	return commandPool;
 }
 
 Precomputer::Precomputer(
@@ -87,154 +214,481 @@ Precomputer::Precomputer(
 	EnvConditions &env,
 	uint32_t stepsPerScatteringOrder,
 	uint32_t stepsPerFrame,
-	uint32_t blendFrames) :
+	uint32_t blendFrames,
+	LutCache *cache,
+	const LutPack *pack) :
+	m_Atmosphere{atmosphere},
 	m_Env{env},
-	// will be overriden in _init, but easier this way.
+	m_Cache{cache},
+	m_Pack{pack},
+	// will be overriden once the first precomputation is done, but easier this way.
 	m_EffectiveSkyEnv{m_Env, m_Env},
 	m_StepsPerScatteringOrder{stepsPerScatteringOrder},
-	m_MaxSteps{SCATTERING_ORDERS*(stepsPerScatteringOrder+1)},
+	m_MaxSteps{SCATTERING_ORDERS*(stepsPerScatteringOrder+1)+1},
 	m_StepsPerFrame{stepsPerFrame == UINT32_MAX ? m_MaxSteps : stepsPerFrame},
+	m_Adaptive{true},
+	m_FrameBudget{2.0f},
+	m_LastBatchCost{0},
+	m_QueryHalf{0},
 	m_SumImageRatio{0},
 	// write into buffer 0 first, blend from 1 to it after precomputing (maybe in one step?).
 	m_SumTarget{0},
+	m_EnqueuedEnv{env.GetEnvironment()},
 	m_BlendFrames{blendFrames},
+	m_SubmittedValue{0},
 	m_SumImageRatioUBO(
 		sizeof(m_SumImageRatio),
 		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		{}) {
-	
-	m_SingleScatteringInstantiater =
-		[&atmosphere = atmosphere]
-		(uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter &currentBuffer, VkDescriptorSet env) {
-
-			atmosphere.RecordSingleScatteringCommandBuffer(*currentBuffer, offset, count, sumTarget, env);
-			// advance currentBuffer!! Next Instantiation shouldn't use the same buffer.
-			return runBufferFunction(*(currentBuffer++));
-		};
-	m_MultiScatteringInstantiater =
-		[&atmosphere = atmosphere]
-		(uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter &currentBuffer, VkDescriptorSet env) {
-
-			atmosphere.RecordMultiScatteringCommandBuffer(*currentBuffer, offset, count, sumTarget, env);
-			return runBufferFunction(*(currentBuffer++));
-		};
-	m_GatheringInstantiater = 
-		[&atmosphere = atmosphere]
-		(uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter &currentBuffer, VkDescriptorSet env) {
-
-			atmosphere.RecordGatheringCommandBuffer(*currentBuffer, offset, count, sumTarget, env);
-			return runBufferFunction(*(currentBuffer++));
-		};
-	m_TransmittanceInstantiater = 
-		[&atmosphere = atmosphere]
-		// offset and count are not really necessary, but it's easier to just ignore them than incorporating
-		// the difference properly via a class-hierarchy for the Instantiaters+PrecomputeTasks.
-		(uint32_t offset, uint32_t count, uint32_t sumTarget, BufIter &currentBuffer, VkDescriptorSet env) {
-
-			atmosphere.RecordTransmittanceCommandBuffer(*currentBuffer, sumTarget, env);
-			return runBufferFunction(*(currentBuffer++));
-		};
-
-	_init(m_SumTarget);
-	// pass initial value for blend, will use texture 1 (all zero) and then blend to
-	// texture 0 after it has been filled by the first precomputation.
-	CreateDescriptor(1);
+
+	m_StageCost.fill(-1);
+
+	CreateTimeline();
+	CreateQueryPool();
+	if (!LoadCached(m_EnqueuedEnv, m_SumTarget)) {
+		// there are no LUTs to show in the meantime (texture 1 isn't allocated and aliases texture 0),
+		// so the first precomputation is submitted at once and waited for before the first frame.
+		Start(m_EnqueuedEnv, m_SumTarget);
+		while (m_Active->m_NextNode != m_Active->m_Nodes.size())
+			SubmitNext(*m_Active);
+		WaitForSubmitted();
+
+		m_EffectiveSkyEnv[m_SumTarget].SetEnvironment(m_Active->m_Environment);
+		StoreCached(*m_Active);
+		Retire(std::move(m_Active));
+	}
+
+	// texture 0 is filled, no need to blend.
+	CreateDescriptor(0);
+}
+
+bool Precomputer::LoadCached(const EnvConditions::Environment &env, uint32_t sumTarget) {
+	// WriteLuts waits for everything previously submitted on the queue, so cancelled batches
+	// are done writing sumTarget.
+	const AtmosphereLuts *baked = m_Pack != nullptr ? m_Pack->Find(env) : nullptr;
+	AtmosphereLuts luts;
+	if (baked == nullptr) {
+		if (m_Cache == nullptr || !m_Cache->Load(env, luts))
+			return false;
+		baked = &luts;
+	}
+	AllocateSumTarget(sumTarget);
+	m_Atmosphere.WriteLuts(sumTarget, *baked);
+
+	m_EffectiveSkyEnv[sumTarget].SetEnvironment(env);
+	return true;
+}
+
+void Precomputer::StoreCached(const Precomputation &precomputation) {
+	const EnvConditions::Environment &env = precomputation.m_Env->GetEnvironment();
+	if (m_Cache == nullptr || m_Cache->Contains(env) || (m_Pack != nullptr && m_Pack->Find(env) != nullptr))
+		return;
+
+	// stalls the queue, but only once per new environment.
+	m_Cache->Store(env, m_Atmosphere.ReadLuts(precomputation.m_SumTarget));
+}
+
+bool Precomputer::Begin(const EnvConditions::Environment &env, uint32_t sumTarget) {
+	if (LoadCached(env, sumTarget)) {
+		CreateBlendTasks();
+		return true;
+	}
+	Start(env, sumTarget);
+	return false;
 }
 
 Precomputer::~Precomputer() {
 	VkDevice device = VulkanAPI::GetDevice();
+
+	// buffers may still be in flight.
+	WaitForSubmitted();
+
 	vkDestroyDescriptorSetLayout(device, m_RatioDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
-	for (CleanupTask cleanupTask : m_CleanupTasks)
-		cleanupTask();
+	if (m_Active)
+		m_Active->m_CommandPool->Destroy();
+	for (RetiredPrecomputation &retired : m_Retired)
+		retired.m_CommandPool->Destroy();
 	m_SumImageRatioUBO.Destroy();
+	if (m_QueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, m_QueryPool, nullptr);
+	vkDestroySemaphore(device, m_Timeline, nullptr);
 }
 
-std::deque<Precomputer::PrecomputeTask> Precomputer::CreateTasks(
-	uint32_t stepsPerScatteringOrder,
+void Precomputer::CreateTimeline() {
+	VkSemaphoreTypeCreateInfo typeInfo;
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.pNext = nullptr;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo createInfo;
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	createInfo.pNext = &typeInfo;
+	createInfo.flags = 0;
+
+	ASSERT_VULKAN(vkCreateSemaphore(VulkanAPI::GetDevice(), &createInfo, nullptr, &m_Timeline));
+}
+
+void Precomputer::CreateQueryPool() {
+	const VkPhysicalDeviceLimits &limits = VulkanAPI::GetPhysicalDeviceProperties().limits;
+
+	// without timestamps there is nothing to adapt to, fall back to the fixed step counts.
+	if (!limits.timestampComputeAndGraphics) {
+		Log::Warn("Timestamps not supported, using fixed precompute steps");
+		m_QueryPool = VK_NULL_HANDLE;
+		m_Adaptive = false;
+		return;
+	}
+	m_TimestampPeriod = limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo createInfo;
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.pNext = nullptr;
+	createInfo.flags = 0;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = 2*PRECOMPUTE_QUERIES_PER_BATCH;
+	createInfo.pipelineStatistics = 0;
+
+	ASSERT_VULKAN(vkCreateQueryPool(VulkanAPI::GetDevice(), &createInfo, nullptr, &m_QueryPool));
+}
+
+std::vector<Precomputer::PrecomputeNode> Precomputer::CreateNodes(
+	uint32_t scatteringSteps,
+	uint32_t gatheringSteps,
 	uint32_t sumTarget,
-	BufIter &currentBuffer,
 	VkDescriptorSet envDescSet) {
 
-	// count for each step for one scattering order.
-	std::vector<uint32_t> counts(stepsPerScatteringOrder);
+	// offset and count for each step of a stage with the given height resolution.
+	auto split = [](uint32_t resolution, uint32_t steps) {
+		std::vector<std::pair<uint32_t, uint32_t>> slices;
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i != steps; ++i) {
+			// distribute leftover rows onto the first steps.
+			uint32_t count = resolution/steps + (i < resolution%steps ? 1 : 0);
+			slices.push_back({offset, count});
+			offset += count;
+		}
+		return slices;
+	};
+	std::vector<std::pair<uint32_t, uint32_t>> scatteringSlices = split(m_Atmosphere.GetResolution().m_ScatteringHeight, scatteringSteps);
+	std::vector<std::pair<uint32_t, uint32_t>> gatheringSlices = split(m_Atmosphere.GetResolution().m_GatheringHeight, gatheringSteps);
 
-	std::fill_n(counts.begin(), stepsPerScatteringOrder, SCATTERING_RESOLUTION_HEIGHT/stepsPerScatteringOrder);
-	// distribute leftover steps.
-	for (int i = 0; i != SCATTERING_RESOLUTION_HEIGHT%stepsPerScatteringOrder; ++i)
-		counts[i]++;
+	std::vector<PrecomputeNode> nodes;
 
-	// offset for each step for one scattering order.
-	std::vector<uint32_t> offsets(stepsPerScatteringOrder);
-	offsets[0] = 0;
-	for (int i = 1; i != stepsPerScatteringOrder; ++i)
-		offsets[i] = offsets[i-1] + counts[i-1];
+	// clear and transmittance are very fast so there's no need to split them up.
+	nodes.emplace_back(PrecomputeStage::GatheringClear, 0, 0, sumTarget, envDescSet);
+	nodes.emplace_back(PrecomputeStage::Transmittance, 0, 0, sumTarget, envDescSet);
 
+	for (auto [offset, count] : scatteringSlices)
+		nodes.emplace_back(PrecomputeStage::SingleScattering, offset, count, sumTarget, envDescSet);
+	for (auto [offset, count] : gatheringSlices)
+		nodes.emplace_back(PrecomputeStage::Gathering, offset, count, sumTarget, envDescSet);
 
-	std::deque<PrecomputeTask> tasks;
+	for (int i = 1; i != SCATTERING_ORDERS; ++i) {
+		for (auto [offset, count] : scatteringSlices)
+			nodes.emplace_back(PrecomputeStage::MultiScattering, offset, count, sumTarget, envDescSet);
+		for (auto [offset, count] : gatheringSlices)
+			nodes.emplace_back(PrecomputeStage::Gathering, offset, count, sumTarget, envDescSet);
+	}
 
-	// don't need offset or count, transmittance is very fast so there's no need to split it up.
-	tasks.emplace_back(&m_TransmittanceInstantiater, 0,0, sumTarget, &currentBuffer, envDescSet);
+	for (size_t i = 0; i != nodes.size(); ++i)
+		nodes[i].m_Index = i;
+	m_MaxSteps = nodes.size();
 
-	for (int i = 0; i != stepsPerScatteringOrder; ++i)
-		tasks.emplace_back(&m_SingleScatteringInstantiater, offsets[i], counts[i], sumTarget, &currentBuffer, envDescSet);
-	// gathering doesn't need to be split up either.
-	tasks.emplace_back(&m_GatheringInstantiater, 0, GATHERING_RESOLUTION_HEIGHT, sumTarget, &currentBuffer, envDescSet);
+	return nodes;
+}
 
-	for (int i = 1; i != SCATTERING_ORDERS; ++i) {
-		for (int j = 0; j != stepsPerScatteringOrder; ++j)
-			tasks.emplace_back(&m_MultiScatteringInstantiater, offsets[j], counts[j], sumTarget, &currentBuffer, envDescSet);
-		tasks.emplace_back(&m_GatheringInstantiater, 0, GATHERING_RESOLUTION_HEIGHT, sumTarget, &currentBuffer, envDescSet);
+void Precomputer::ResolveDependencies(std::vector<PrecomputeNode> &nodes) {
+	// current writers, readers since they started writing and readers before them, per image.
+	// Nodes of one stage write disjoint rows, several of them can be writers at the same time.
+	std::vector<std::vector<size_t>> writers(PRECOMPUTE_IMAGE_COUNT);
+	std::vector<std::vector<size_t>> readers(PRECOMPUTE_IMAGE_COUNT);
+	std::vector<std::vector<size_t>> priorReaders(PRECOMPUTE_IMAGE_COUNT);
+
+	auto independent = [&nodes](size_t a, size_t b) {
+		return nodes[a].m_Stage == nodes[b].m_Stage &&
+			(nodes[a].m_Offset + nodes[a].m_Count <= nodes[b].m_Offset ||
+			 nodes[b].m_Offset + nodes[b].m_Count <= nodes[a].m_Offset);
+	};
+
+	// node order is a valid topological order.
+	for (size_t i = 0; i != nodes.size(); ++i) {
+		std::vector<size_t> &deps = nodes[i].m_Dependencies;
+		for (const ImageAccess &access : nodes[i].m_Accesses) {
+			size_t img = size_t(access.image);
+			if (!access.write) {
+				// read-after-write.
+				deps.insert(deps.end(), writers[img].begin(), writers[img].end());
+				readers[img].push_back(i);
+				continue;
+			}
+
+			bool sibling = !writers[img].empty() && std::all_of(writers[img].begin(), writers[img].end(),
+				[&](size_t writer) { return independent(writer, i); });
+			if (sibling) {
+				// write-after-read, same as the other writers.
+				deps.insert(deps.end(), priorReaders[img].begin(), priorReaders[img].end());
+				deps.insert(deps.end(), readers[img].begin(), readers[img].end());
+				writers[img].push_back(i);
+			} else {
+				// write-after-write and write-after-read.
+				deps.insert(deps.end(), writers[img].begin(), writers[img].end());
+				deps.insert(deps.end(), readers[img].begin(), readers[img].end());
+				priorReaders[img] = std::move(readers[img]);
+				readers[img].clear();
+				writers[img] = {i};
+			}
+		}
+		std::sort(deps.begin(), deps.end());
+		deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
 	}
+}
 
-	return tasks;
+float Precomputer::EstimateCost(const PrecomputeNode &node) const {
+	float cost = m_StageCost[size_t(node.m_Stage)];
+	// unknown stages get the whole budget, so they are measured on their own first.
+	if (cost < 0)
+		return m_FrameBudget;
+	return cost * std::max(node.m_Count, 1u);
 }
 
-void Precomputer::CreateFrameTasks(
-	std::deque<Precomputer::PrecomputeTask> tasks,
-	uint32_t stepsPerFrame,
-	std::list<CleanupTask>::iterator cleanupIter,
-	std::shared_ptr<EnvConditions> env,
-	uint32_t sumTarget) {
-
-	// As long as there are tasks, remove stepsPerFrame many and append them to the tasks for one frame.
-	// TODO: optimize by not popping, but simply increasing a iterator until it reaches the end.
-	while (!tasks.empty()) {
-		std::vector<InstantiaterResult> tasksForFrame;
-		// pop first into currentTask.
-		PrecomputeTask currentTask = tasks.front();
-		tasks.pop_front();
-		for (int i = 1; i != stepsPerFrame && !tasks.empty(); ++i) {
-			if (!currentTask.Combine(tasks.front())) {
-				tasksForFrame.push_back(currentTask.Instantiate());
-				currentTask = tasks.front();
+void Precomputer::SubmitNext(Precomputation &precomputation) {
+	std::vector<PrecomputeNode> group;
+	size_t first = precomputation.m_NextNode;
+	uint32_t taken = 0;
+	float predicted = 0;
+	while (precomputation.m_NextNode != precomputation.m_Nodes.size()) {
+		const PrecomputeNode &node = precomputation.m_Nodes[precomputation.m_NextNode];
+		if (m_Adaptive) {
+			float cost = EstimateCost(node);
+			// always make progress, even if a single node exceeds the budget.
+			if (taken != 0 && predicted + cost > m_FrameBudget)
+				break;
+			predicted += cost;
+		} else if (taken == m_StepsPerFrame)
+			break;
+
+		// either combine with the last node or append.
+		if (group.empty() || !group.back().Combine(node))
+			group.push_back(node);
+		++taken;
+		++precomputation.m_NextNode;
+	}
+	m_LastBatchCost = predicted;
+
+	// the scratch images are shared with the previous precomputation, the first batch has to wait for it.
+	uint64_t waitValue = first == 0 ? m_SubmittedValue : 0;
+	// dependencies in this batch are handled by barriers, only wait for the latest batch we actually depend on.
+	for (const PrecomputeNode &node : group)
+		for (size_t dep : node.m_Dependencies)
+			if (dep < first)
+				waitValue = std::max(waitValue, precomputation.m_NodeValues[dep]);
+
+	// only measure if the half isn't still waiting to be read back.
+	uint32_t firstQuery = m_QueryHalf*PRECOMPUTE_QUERIES_PER_BATCH;
+	bool measure = m_QueryPool != VK_NULL_HANDLE &&
+		group.size()+1 <= PRECOMPUTE_QUERIES_PER_BATCH &&
+		std::none_of(m_Measurements.begin(), m_Measurements.end(),
+			[firstQuery](const Measurement &m) { return m.m_FirstQuery == firstQuery; });
+
+	uint64_t signalValue = m_SubmittedValue+1;
+	VkCommandBuffer buf = precomputation.m_CommandPool->GetBuffer(precomputation.m_NextBuffer++);
+	RecordGroup(buf, group, measure ? int64_t(firstQuery) : -1);
+	Submit(buf, waitValue, signalValue);
+	precomputation.m_NodeValues.resize(precomputation.m_NextNode, signalValue);
+
+	if (measure) {
+		Measurement measurement;
+		measurement.m_Value = signalValue;
+		measurement.m_FirstQuery = firstQuery;
+		for (const PrecomputeNode &node : group)
+			measurement.m_Nodes.push_back({node.m_Stage, node.m_Count});
+		m_Measurements.push_back(measurement);
+		m_QueryHalf ^= 1;
+	}
+}
+
+void Precomputer::RecordGroup(VkCommandBuffer buf, const std::vector<PrecomputeNode> &group, int64_t firstQuery) {
+	VkCommandBufferBeginInfo beginInfo;
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
+
+	// one timestamp before the first node and one after each node.
+	if (firstQuery >= 0) {
+		vkCmdResetQueryPool(buf, m_QueryPool, firstQuery, group.size()+1);
+		vkCmdWriteTimestamp(buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, firstQuery);
+	}
+
+	// nodes recorded since the last barrier, and what they touched.
+	size_t barrierIndex = group.front().m_Index;
+	VkPipelineStageFlags pendingStages = 0;
+	std::vector<bool> pendingWrite(PRECOMPUTE_IMAGE_COUNT, false);
+	std::vector<bool> pendingRead(PRECOMPUTE_IMAGE_COUNT, false);
+
+	for (size_t i = 0; i != group.size(); ++i) {
+		const PrecomputeNode &node = group[i];
+
+		// dependencies in previous batches are covered by the timeline semaphore.
+		bool needsBarrier = false;
+		for (size_t dep : node.m_Dependencies)
+			needsBarrier |= dep >= barrierIndex;
+
+		if (needsBarrier) {
+			std::vector<VkImageMemoryBarrier> barriers;
+			for (size_t img = 0; img != PRECOMPUTE_IMAGE_COUNT; ++img) {
+				if (!pendingWrite[img] && !pendingRead[img])
+					continue;
+
+				VkAccessFlags srcAccess = 0;
+				if (pendingWrite[img])
+					srcAccess = pendingStages & VK_PIPELINE_STAGE_TRANSFER_BIT ?
+						VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT :
+						VK_ACCESS_SHADER_WRITE_BIT;
+
+				barriers.push_back(VkImageMemoryBarrier {
+					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+					.pNext = nullptr,
+					.srcAccessMask = srcAccess,
+					.dstAccessMask = node.m_PipelineStage == VK_PIPELINE_STAGE_TRANSFER_BIT ?
+						VK_ACCESS_TRANSFER_WRITE_BIT :
+						VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+					.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.image = m_Atmosphere.GetImage(AtmosphereImage(img), node.m_SumTarget),
+					.subresourceRange = {
+						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+						.baseMipLevel = 0,
+						.levelCount = 1,
+						.baseArrayLayer = 0,
+						.layerCount = 1
+					}
+				});
+				pendingWrite[img] = false;
+				pendingRead[img] = false;
 			}
-			// in both cases tasks is included in tasksForFrame:
-			// either it was combined with currentTask or it is now currentTask
-			tasks.pop_front();
+			vkCmdPipelineBarrier(buf, pendingStages, node.m_PipelineStage, 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+			barrierIndex = node.m_Index;
+			pendingStages = 0;
+		}
+
+		node.Record(m_Atmosphere, buf);
+		if (firstQuery >= 0)
+			vkCmdWriteTimestamp(buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, firstQuery+i+1);
+
+		pendingStages |= node.m_PipelineStage;
+		for (const ImageAccess &access : node.m_Accesses) {
+			if (access.write)
+				pendingWrite[size_t(access.image)] = true;
+			else
+				pendingRead[size_t(access.image)] = true;
 		}
-		tasksForFrame.push_back(currentTask.Instantiate());
-		m_FrameTasks.push_back(tasksForFrame);
 	}
 
-	m_FrameTasks.push_back({
-		// update environment used by sky before blending starts.
-		[env = env->GetEnvironment(), envConds = &m_EffectiveSkyEnv[sumTarget]]
-		() {
-			envConds->SetEnvironment(env);
-		},
-
-		// perform cleanup for the tasks just performed.
-		// (erase to prevent re-releasing resources).
-		[cleanupIter, cleanupTasks = &m_CleanupTasks]
-		() {
-			(*cleanupIter)();
-			cleanupTasks->erase(cleanupIter);
+	ASSERT_VULKAN(vkEndCommandBuffer(buf));
+}
+
+void Precomputer::Submit(VkCommandBuffer buf, uint64_t waitValue, uint64_t signalValue) {
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo;
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.waitSemaphoreValueCount = waitValue == 0 ? 0 : 1;
+	timelineInfo.pWaitSemaphoreValues = &waitValue;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo;
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	// nothing to wait for in the very first batch.
+	submitInfo.waitSemaphoreCount = waitValue == 0 ? 0 : 1;
+	submitInfo.pWaitSemaphores = &m_Timeline;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_Timeline;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &buf;
+
+	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+	m_SubmittedValue = signalValue;
+}
+
+void Precomputer::ReadMeasurements() {
+	while (!m_Measurements.empty() && IsComplete(m_Measurements.front().m_Value)) {
+		const Measurement &measurement = m_Measurements.front();
+
+		std::vector<uint64_t> timestamps(measurement.m_Nodes.size()+1);
+		VkResult result = vkGetQueryPoolResults(
+			VulkanAPI::GetDevice(),
+			m_QueryPool,
+			measurement.m_FirstQuery,
+			timestamps.size(),
+			timestamps.size()*sizeof(uint64_t),
+			timestamps.data(),
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+
+		if (result == VK_SUCCESS) {
+			for (size_t i = 0; i != measurement.m_Nodes.size(); ++i) {
+				auto [stage, count] = measurement.m_Nodes[i];
+				// ns -> ms, per row.
+				float ms = (timestamps[i+1]-timestamps[i]) * m_TimestampPeriod / 1e6f;
+				float perRow = ms / std::max(count, 1u);
+
+				float &cost = m_StageCost[size_t(stage)];
+				// smooth out noise, but follow changes within a few batches.
+				cost = cost < 0 ? perRow : 0.8f*cost + 0.2f*perRow;
+			}
 		}
-	});
+		m_Measurements.pop_front();
+	}
+}
+
+bool Precomputer::IsComplete(uint64_t value) const {
+	uint64_t current;
+	ASSERT_VULKAN(vkGetSemaphoreCounterValue(VulkanAPI::GetDevice(), m_Timeline, &current));
+	return current >= value;
+}
+
+void Precomputer::WaitForSubmitted() const {
+	VkSemaphoreWaitInfo waitInfo;
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.pNext = nullptr;
+	waitInfo.flags = 0;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_Timeline;
+	waitInfo.pValues = &m_SubmittedValue;
+	ASSERT_VULKAN(vkWaitSemaphores(VulkanAPI::GetDevice(), &waitInfo, UINT64_MAX));
+}
+
+void Precomputer::AllocateSumTarget(uint32_t sumTarget) {
+	if (m_Atmosphere.IsSumTargetAllocated(sumTarget))
+		return;
+	// the descriptor sets of sumTarget alias the other target, batches still in flight may use them.
+	WaitForSubmitted();
+	m_Atmosphere.AllocateSumTarget(sumTarget);
+}
+
+void Precomputer::ReleaseSumTarget(uint32_t sumTarget) {
+	if (!m_Atmosphere.IsSumTargetAllocated(sumTarget))
+		return;
+	// only batches may still use the images, the previous frame is waited for.
+	WaitForSubmitted();
+	m_Atmosphere.ReleaseSumTarget(sumTarget);
+}
 
+void Precomputer::CreateBlendTasks() {
 	// append functions for blending.
 	int start, end, diff;
 	if (m_SumTarget == 0) {
@@ -252,41 +706,139 @@ void Precomputer::CreateFrameTasks(
 	}
 	for (int i = start; i != end; i = i + diff) {
 		float ratio = i/float(m_BlendFrames);
-		m_FrameTasks.push_back({
-			[ratio, &ubo = m_SumImageRatioUBO]
+		m_FrameTasks.push_back(
+			[ratio, this]
 			(){
-				ubo.MapMemory(sizeof(ratio), &ratio, 0, 0);
-
-				return nullptr;
-			}
-		});
+				SetRatio(ratio);
+			});
 	}
 }
 
+void Precomputer::CompareWithCpu() {
+	CpuPrecomputer cpuPrecomputer(m_EffectiveSkyEnv[m_SumTarget].GetEnvironment(), m_Atmosphere.GetResolution());
+	cpuPrecomputer.Run();
+	cpuPrecomputer.LogBenchmark();
+	CpuPrecomputer::LogComparison(cpuPrecomputer.GetLuts(), m_Atmosphere.ReadLuts(m_SumTarget));
+}
+
 void Precomputer::Frame() {
-	if (m_FrameTasks.begin() == m_FrameTasks.end())
+	if (m_QueryPool != VK_NULL_HANDLE)
+		ReadMeasurements();
+
+	if (m_Pending) {
+		if (m_Active) {
+			// latest wins: stop the active precomputation at this step boundary.
+			// Its target isn't visible yet, so the new one can write into it as well.
+			uint32_t sumTarget = m_Active->m_SumTarget;
+			Retire(std::move(m_Active));
+			Begin(*m_Pending, sumTarget);
+			m_Pending.reset();
+		} else if (m_FrameTasks.empty()) {
+			// 1->0, 0->1.
+			m_SumTarget ^= 1;
+			Begin(*m_Pending, m_SumTarget);
+			m_Pending.reset();
+		}
+		// otherwise wait until blending is done, both targets are visible while blending.
+	}
+
+	if (m_Active) {
+		if (m_Active->m_NextNode != m_Active->m_Nodes.size())
+			SubmitNext(*m_Active);
+		// don't start blending before the results are there.
+		else if (IsComplete(m_Active->m_NodeValues.back())) {
+			// update environment used by sky before blending starts.
+			m_EffectiveSkyEnv[m_Active->m_SumTarget].SetEnvironment(m_Active->m_Environment);
+			StoreCached(*m_Active);
+			Retire(std::move(m_Active));
+			CreateBlendTasks();
+		}
 		return;
-	// we have at least one task group, run and remove it.
-	for (InstantiaterResult task : m_FrameTasks.front()) {
-		task();
 	}
+	// done or cancelled (and replaced by cached LUTs), cancelled batches may still use the scratch images.
+	if (m_Atmosphere.IsScratchAllocated()) {
+		WaitForSubmitted();
+		m_Atmosphere.ReleaseScratch();
+	}
+
+	if (m_FrameTasks.empty())
+		return;
+	// we have at least one task, run and remove it.
+	m_FrameTasks.front()();
 	m_FrameTasks.pop_front();
+
+	// blend is done, only m_SumTarget is visible. Keep the other one if it is about to be written again.
+	if (m_FrameTasks.empty() && !m_Pending)
+		ReleaseSumTarget(m_SumTarget^1);
 }
 
 void Precomputer::Enqueue() {
-	// 1->0, 0->1.
-	m_SumTarget ^= 1;
-	_init(m_SumTarget);
-} 
+	EnvConditions::Environment env = m_Env.GetEnvironment();
+	PrecomputeStageFlags stages = InvalidatedStages(m_EnqueuedEnv, env);
+	m_EnqueuedEnv = env;
+
+	// every parameter read by a stage is also read by transmittance, so everything
+	// downstream of it has to be recomputed into the other target.
+	if (stages != 0) {
+		// replaces a request that wasn't started yet.
+		m_Pending = env;
+		return;
+	}
+
+	// LUTs of the latest request stay valid, only parameters used while rendering changed.
+	if (m_Pending)
+		m_Pending = env;
+	else if (m_Active)
+		m_Active->m_Environment = env;
+	else
+		// run after the blend steps already queued.
+		m_FrameTasks.push_back(
+			[env, envConds = &m_EffectiveSkyEnv[m_SumTarget]]
+			() {
+				envConds->SetEnvironment(env);
+			});
+}
 
 void Precomputer::RenderImgui() {
 	ImGui::Begin("Precompute");
-	ImGui::SliderInt("StepsPerScatteringOrder", (int *)&m_StepsPerScatteringOrder, 1, SCATTERING_RESOLUTION_HEIGHT);
-	ImGui::SliderInt("StepsPerFrame", (int *)&m_StepsPerFrame, 1, SCATTERING_ORDERS*(m_StepsPerScatteringOrder+1));
+	// only used if not adaptive.
+	ImGui::SliderInt("StepsPerScatteringOrder", (int *)&m_StepsPerScatteringOrder, 1, m_Atmosphere.GetResolution().m_ScatteringHeight);
+	ImGui::SliderInt("StepsPerFrame", (int *)&m_StepsPerFrame, 1, SCATTERING_ORDERS*(m_StepsPerScatteringOrder+1)+2);
 	ImGui::DragInt("BlendFrames", (int *) &m_BlendFrames);
 
+	if (m_QueryPool != VK_NULL_HANDLE) {
+		ImGui::Checkbox("Adaptive", &m_Adaptive);
+		ImGui::SliderFloat("FrameBudget (ms)", &m_FrameBudget, 0.1f, 16.0f);
+		ImGui::Text("Last batch (predicted): %.3f ms", m_LastBatchCost);
+		for (size_t i = 0; i != PRECOMPUTE_STAGE_COUNT; ++i) {
+			if (m_StageCost[i] < 0)
+				ImGui::Text("%s: not measured", precomputeStageNames[i]);
+			else
+				ImGui::Text("%s: %.4f ms/row", precomputeStageNames[i], m_StageCost[i]);
+		}
+	}
+
+	ImGui::Text("LUT memory: %.2f MiB", m_Atmosphere.GetAllocatedSize() / float(1 << 20));
+	if (m_Active)
+		ImGui::Text("Precomputing: %zu/%zu nodes submitted%s", m_Active->m_NextNode, m_Active->m_Nodes.size(), m_Pending ? ", newer request pending" : "");
+	else if (m_Pending)
+		ImGui::Text("Request pending, waiting for blend");
+
 	if (ImGui::Button("Enqueue"))
 		Enqueue();
+	if (m_Pack != nullptr)
+		for (const LutPack::Entry &entry : m_Pack->GetEntries())
+			// baked, switches without precomputing.
+			if (ImGui::Button(("Preset: " + entry.m_Name).c_str())) {
+				// the key doesn't hold the phase function, keep the current one.
+				EnvConditions::Environment env = entry.m_Key.m_Env;
+				env.m_AsymmetryFactor = m_Env.GetEnvironment().m_AsymmetryFactor;
+				m_Env.SetEnvironment(env);
+				Enqueue();
+			}
+	// only while the LUTs of m_SumTarget are done and fully visible.
+	if (!m_Active && m_FrameTasks.empty() && ImGui::Button("Compare with CPU"))
+		CompareWithCpu();
 	ImGui::End();
 }
 
@@ -357,7 +909,29 @@ void Precomputer::CreateDescriptor(float initial_value) {
 
 	vkUpdateDescriptorSets(device, 1, &writeDescSet, 0, nullptr);
 
-	m_SumImageRatioUBO.MapMemory(sizeof(initial_value), &initial_value, 0, 0);
+	SetRatio(initial_value);
+}
+
+void Precomputer::SetRatio(float ratio) {
+	m_SumImageRatio = ratio;
+	m_SumImageRatioUBO.MapMemory(sizeof(ratio), &ratio, 0, 0);
+}
+
+float Precomputer::GetRatio() const {
+	return m_SumImageRatio;
+}
+
+size_t Precomputer::GetSumTargetState() const {
+	// the blend tasks end exactly on 0 or 1.
+	if (m_SumImageRatio == 0)
+		return 0;
+	if (m_SumImageRatio == 1)
+		return 1;
+	return SUM_TARGET_STATE_BLEND;
+}
+
+size_t Precomputer::GetBoundSumTarget(size_t state, size_t slot) {
+	return state == SUM_TARGET_STATE_BLEND ? slot : state;
 }
 
 VkDescriptorSet Precomputer::GetRatioDescriptorSet() const { return m_RatioDescriptorSet; }
@@ -5,6 +5,8 @@
 
 const std::string compilerPath = "glslc";
 const std::string shaderDirPath = "data/shader/";
+// build output (hemisphere_vecs.glsl), defined by CMakeLists.txt.
+const std::string generatedDirPath = SHADER_GENERATED_DIR;
 
 namespace en::vk
 {
@@ -14,11 +16,18 @@ namespace en::vk
 		Create(code);
 	}
 
-	Shader::Shader(const std::string& fileName, bool compiled)
+	Shader::Shader(const std::string& fileName, bool compiled, const std::vector<std::string>& defines)
 	{
 		std::string fullFilePath = shaderDirPath + fileName;
 
-		std::string outputFileName = fullFilePath + ".spv";
+		std::string defineArgs;
+		std::string outputFileName = fullFilePath;
+		for (const std::string& define : defines)
+		{
+			defineArgs += " -D" + define;
+			outputFileName += "." + define;
+		}
+		outputFileName += ".spv";
 
 		if (!compiled)
 		{
@@ -28,7 +37,8 @@ namespace en::vk
 			                      " -I shared_include" +
 			                      // shaderDirPath includes '/'.
 			                      " -I " + shaderDirPath + "include" +
-			                      " -O -I " + shaderDirPath + "generated";
+			                      " -O -I \"" + generatedDirPath + "\"" +
+			                      defineArgs;
 			Log::Info("Shader Compile Command: " + command);
 
 			// Compile
@@ -5,14 +5,17 @@
 
 namespace en
 {
-	SimpleModelRenderer::SimpleModelRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const GroundLighting &gl, size_t max_concurrent) :
+	SimpleModelRenderer::SimpleModelRenderer(uint32_t width, uint32_t height, const Camera* camera, const Sun* sun, const GroundLighting &gl, const CloudShadow &cloudShadow, size_t max_concurrent) :
 		m_FrameWidth(width),
 		m_FrameHeight(height),
 		m_Camera(camera),
 		m_Sun(sun),
 		m_GroundLighting(gl),
+		m_CloudShadow(cloudShadow),
 		m_VertShader("simple_material/simple_material.vert", false),
-		m_FragShader("simple_material/simple_material.frag", false),
+		// samples the cubemap or evaluates the coefficients.
+		m_FragShader(gl.GetOutput() == GroundLightingOutput::Cubemap ?
+			"simple_material/simple_material.frag" : "simple_material/simple_material_sh.frag", false),
 		m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetGraphicsQFI()),
 		m_MaxConcurrent{max_concurrent},
 		m_Pipeline{VK_NULL_HANDLE} {
@@ -167,7 +170,7 @@ namespace en
 			// Render Model Instances
 			VkDeviceSize offsets[] = { 0 };
 			// TODO: one camera-set per concurrent frame.
-			std::vector<VkDescriptorSet> descSets = { 0, m_Camera->GetDescriptorSet(), 0, m_Sun->GetDescriptorSet(), m_GroundLighting.GetSampleDescriptorSet() };
+			std::vector<VkDescriptorSet> descSets = { 0, m_Camera->GetDescriptorSet(), 0, m_Sun->GetDescriptorSet(), m_GroundLighting.GetSampleDescriptorSet(), m_CloudShadow.GetSampleDescriptorSet() };
 			for (const ModelInstance* modelInstance : m_ModelInstances)
 			{
 				const Model* model = modelInstance->GetModel();
@@ -209,7 +212,8 @@ namespace en
 			Camera::GetDescriptorSetLayout(),
 			Material::GetDescriptorSetLayout(),
 			m_Sun->GetDescriptorSetLayout(),
-			m_GroundLighting.GetSampleDescriptorLayout()
+			m_GroundLighting.GetSampleDescriptorLayout(),
+			m_CloudShadow.GetSampleDescriptorLayout()
 		};
 
 		VkPipelineLayoutCreateInfo layoutCreateInfo;
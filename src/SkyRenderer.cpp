@@ -19,7 +19,8 @@ namespace en
 		vk::Swapchain &swapchain,
 		Atmosphere &atmosphere,
 		Precomputer &precomp,
-		AerialPerspective &aerial ) :
+		AerialPerspective &aerial,
+		SkyView &skyView ) :
 
 		m_FrameWidth(width),
 		m_FrameHeight(height),
@@ -31,8 +32,10 @@ namespace en
 		m_Atmosphere(atmosphere),
 		m_Precomp(precomp),
 		m_Aerial{aerial},
+		m_SkyView{skyView},
 		m_MaxConcurrent{max_concurrent},
-		m_GraphicsPipeline{VK_NULL_HANDLE}
+		m_GraphicsPipeline{VK_NULL_HANDLE},
+		m_BlendGraphicsPipeline{VK_NULL_HANDLE}
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 
@@ -48,6 +51,7 @@ namespace en
 
 		vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
 		vkDestroyPipeline(device, m_GraphicsPipeline, nullptr);
+		vkDestroyPipeline(device, m_BlendGraphicsPipeline, nullptr);
 
 		m_VertShader.Destroy();
 		m_FragShader.Destroy();
@@ -62,11 +66,10 @@ namespace en
 	void SkyRenderer::CreatePipelineLayout(VkDevice device)
 	{
 		std::vector<VkDescriptorSetLayout> descSetLayouts;
-		descSetLayouts.resize(9);
+		descSetLayouts.resize(8);
 		descSetLayouts[SKY_SETS_CAM] = Camera::GetDescriptorSetLayout();
 		descSetLayouts[SKY_SETS_SUN] = m_Sun.GetDescriptorSetLayout();
-		descSetLayouts[SKY_SETS_SCTEXTURE0] = m_Atmosphere.GetScatteringSampleDescriptorLayout();
-		descSetLayouts[SKY_SETS_SCTEXTURE1] = m_Atmosphere.GetScatteringSampleDescriptorLayout();
+		descSetLayouts[SKY_SETS_SKY_VIEW] = m_SkyView.GetSampleDescriptorLayout();
 		descSetLayouts[SKY_SETS_RATIO] = m_Precomp.GetRatioDescriptorSetLayout();
 		descSetLayouts[SKY_SETS_ENV0] = m_Precomp.GetEffectiveEnv(0).GetDescriptorSetLayout();
 		descSetLayouts[SKY_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSetLayout();
@@ -113,6 +116,7 @@ namespace en
 	{
 		VkDevice device = VulkanAPI::GetDevice();
 		vkDestroyPipeline(device, m_GraphicsPipeline, nullptr);
+		vkDestroyPipeline(device, m_BlendGraphicsPipeline, nullptr);
 
 		// Shader stage
 		VkPipelineShaderStageCreateInfo vertStageCreateInfo;
@@ -131,7 +135,10 @@ namespace en
 		fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragStageCreateInfo.module = m_FragShader.GetVulkanModule();
 		fragStageCreateInfo.pName = "main";
-		fragStageCreateInfo.pSpecializationInfo = nullptr;
+		std::vector<VkSpecializationMapEntry> fragSpecEntries = LutBlendSpecialization::GetSpecializationMapEntries();
+		LutBlendSpecialization fragSpecData{m_Atmosphere.GetResolution(), VK_FALSE};
+		VkSpecializationInfo fragSpecInfo = fragSpecData.GetSpecializationInfo(fragSpecEntries);
+		fragStageCreateInfo.pSpecializationInfo = &fragSpecInfo;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertStageCreateInfo, fragStageCreateInfo };
 
@@ -277,6 +284,11 @@ namespace en
 
 		VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_GraphicsPipeline);
 		ASSERT_VULKAN(result);
+
+		// same pipeline, but mixing both sum targets.
+		fragSpecData.m_Blend = VK_TRUE;
+		result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_BlendGraphicsPipeline);
+		ASSERT_VULKAN(result);
 	}
 
 	void SkyRenderer::CreateCommandBuffers()
@@ -288,18 +300,21 @@ namespace en
 
 	void SkyRenderer::RecordFrameCommandBuffer(VkCommandBuffer buf, size_t frame_indx)
 	{
-		// Bind pipeline
-		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
-		std::vector<VkDescriptorSet> sets(9);
+		// Bind pipeline, outside of blends the visible sum target is bound as target 0.
+		size_t state = m_Precomp.GetSumTargetState();
+		size_t target0 = Precomputer::GetBoundSumTarget(state, 0);
+		size_t target1 = Precomputer::GetBoundSumTarget(state, 1);
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			state == SUM_TARGET_STATE_BLEND ? m_BlendGraphicsPipeline : m_GraphicsPipeline);
+		std::vector<VkDescriptorSet> sets(8);
 		sets[SKY_SETS_CAM] = m_Camera->GetDescriptorSet();
 		sets[SKY_SETS_SUN] = m_Sun.GetDescriptorSet();
-		sets[SKY_SETS_SCTEXTURE0] = m_Atmosphere.GetScatteringSampleDescriptorSet(0);
-		sets[SKY_SETS_SCTEXTURE1] = m_Atmosphere.GetScatteringSampleDescriptorSet(1);
+		sets[SKY_SETS_SKY_VIEW] = m_SkyView.GetSampleDescriptor();
 		sets[SKY_SETS_RATIO] = m_Precomp.GetRatioDescriptorSet();
-		sets[SKY_SETS_ENV0] = m_Precomp.GetEffectiveEnv(0).GetDescriptorSet();
-		sets[SKY_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSet();
-		sets[SKY_SETS_TRANSMITTANCE0] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(0);
-		sets[SKY_SETS_TRANSMITTANCE1] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(1);
+		sets[SKY_SETS_ENV0] = m_Precomp.GetEffectiveEnv(target0).GetDescriptorSet();
+		sets[SKY_SETS_ENV1] = m_Precomp.GetEffectiveEnv(target1).GetDescriptorSet();
+		sets[SKY_SETS_TRANSMITTANCE0] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(target0);
+		sets[SKY_SETS_TRANSMITTANCE1] = m_Atmosphere.GetTransmittanceSampleDescriptorSet(target1);
 
 		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
 
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <set>
+#include <vulkan/vulkan_core.h>
+#include "engine/graphics/SkyView.hpp"
+#include "engine/graphics/VulkanAPI.hpp"
+#include "engine/util/Log.hpp"
+
+#include "sky_view.h"
+
+namespace en {
+
+SkyView::SkyView(Camera &cam, Precomputer &precomp, Atmosphere &atm, Sun &sun) :
+	// the compute buffers are recorded again when the atmosphere descriptor sets change.
+	m_CommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, VulkanAPI::GetComputeQFI()),
+	m_Shader("sky/sky_view.comp", false),
+	m_Cam{cam},
+	m_Precomp{precomp},
+	m_Atmosphere{atm},
+	m_Sun{sun} {
+
+	VkDevice device = VulkanAPI::GetDevice();
+	// Need command buffer for image transition in CreateComputeImage.
+	CreateCommandBuffers();
+	CreateComputeImage(device);
+	CreateDescriptors(device);
+	CreateComputePipeline(device);
+	RecordCommandBuffers();
+}
+
+SkyView::~SkyView() {
+	VkDevice device = VulkanAPI::GetDevice();
+
+	m_CommandPool.Destroy();
+
+	vkFreeMemory(device, m_ImageMemory, nullptr);
+	vkDestroyImage(device, m_Image, nullptr);
+	vkDestroyImageView(device, m_ImageView, nullptr);
+
+	vkDestroySampler(device, m_LinearSampler, nullptr);
+	vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_ImageDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_SampleDescriptorLayout, nullptr);
+
+	vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
+	vkDestroyPipeline(device, m_Pipeline, nullptr);
+	vkDestroyPipeline(device, m_BlendPipeline, nullptr);
+
+	m_Shader.Destroy();
+}
+
+void SkyView::CreateComputeImage(VkDevice device) {
+	std::set<uint32_t> queues = {VulkanAPI::GetComputeQFI(), VulkanAPI::GetGraphicsQFI()};
+	// vector for contiguous memory.
+	std::vector<uint32_t> qvec{queues.begin(), queues.end()};
+
+	// sampled in atmosphere.frag, written in sky_view.comp.
+	// radiance may exceed one, so the error in [0, 1] is no criterion, all candidates are floats.
+	m_ImageFormat = SelectLutFormat(
+		{LutFormat::E5B9G9R9Ufloat, LutFormat::B10G11R11Ufloat, LutFormat::Rgba16Sfloat},
+		{3, std::numeric_limits<float>::infinity()},
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+	Log::Info(std::string("Sky-view format ") + GetLutFormatInfo(m_ImageFormat).m_Name);
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = m_Atmosphere.GetResolution().m_SkyViewX;
+	imageInfo.extent.height = m_Atmosphere.GetResolution().m_SkyViewY;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = GetLutFormatInfo(m_ImageFormat).m_VkFormat;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	// will only be accessed by one queue at a time (for now).
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = qvec.size();
+	imageInfo.pQueueFamilyIndices = qvec.data();
+
+	ASSERT_VULKAN(vkCreateImage(device, &imageInfo, nullptr, &m_Image));
+
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, m_Image, &memReqs);
+
+	VkMemoryAllocateInfo memAllocInfo;
+	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.pNext = nullptr;
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = VulkanAPI::FindMemoryType(
+								   memReqs.memoryTypeBits,
+								   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	ASSERT_VULKAN(vkAllocateMemory(device, &memAllocInfo, nullptr, &m_ImageMemory));
+	ASSERT_VULKAN(vkBindImageMemory(device, m_Image, m_ImageMemory, 0));
+
+	VkImageViewCreateInfo imageViewCreateInfo;
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.pNext = nullptr;
+	imageViewCreateInfo.image = m_Image;
+	imageViewCreateInfo.flags = 0;
+	imageViewCreateInfo.format = imageInfo.format;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.levelCount = 1;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+	imageViewCreateInfo.subresourceRange.layerCount = 1;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	ASSERT_VULKAN(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_ImageView));
+
+	VkImageMemoryBarrier imageMemoryBarrier;
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.pNext = nullptr;
+	imageMemoryBarrier.image = m_Image;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_NONE_KHR;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+
+	VkCommandBufferBeginInfo beginInfo {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.pInheritanceInfo = nullptr
+	};
+
+	ASSERT_VULKAN(vkBeginCommandBuffer(m_LayoutCommandBuffer, &beginInfo));
+
+	vkCmdPipelineBarrier(
+		m_LayoutCommandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &imageMemoryBarrier);
+
+	ASSERT_VULKAN(vkEndCommandBuffer(m_LayoutCommandBuffer));
+
+	VkSubmitInfo submitInfo;
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_LayoutCommandBuffer;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+
+	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+	// wait for completion.
+	ASSERT_VULKAN(vkQueueWaitIdle(VulkanAPI::GetComputeQueue()));
+}
+
+void SkyView::CreateDescriptors(VkDevice device) {
+	std::vector<VkDescriptorPoolSize> poolSizes {{
+			// read from texture in fragment.
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1
+		}, {
+			// write to texture in compute.
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1
+		}
+	};
+
+	VkDescriptorPoolCreateInfo descPoolCreateInfo;
+	descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolCreateInfo.pNext = nullptr;
+	descPoolCreateInfo.flags = 0;
+	descPoolCreateInfo.maxSets = 2;
+	descPoolCreateInfo.poolSizeCount = poolSizes.size();
+	descPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+	ASSERT_VULKAN(vkCreateDescriptorPool(device, &descPoolCreateInfo, nullptr, &m_DescriptorPool));
+
+	VkDescriptorSetLayoutBinding sampleBinding {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		// sample in fragment.
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = nullptr,
+	};
+
+	VkDescriptorSetLayoutBinding imageBinding {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		// write in compute.
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr,
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo;
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = nullptr;
+	layoutCreateInfo.flags = 0;
+	layoutCreateInfo.bindingCount = 1;
+
+	layoutCreateInfo.pBindings = &sampleBinding;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_SampleDescriptorLayout));
+
+	layoutCreateInfo.pBindings = &imageBinding;
+	ASSERT_VULKAN(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_ImageDescriptorLayout));
+
+	VkSamplerCreateInfo sampler;
+	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler.pNext = nullptr;
+	sampler.magFilter = VK_FILTER_LINEAR;
+	sampler.minFilter = VK_FILTER_LINEAR;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	// longitude wraps around, latitude ends at the poles.
+	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.mipLodBias = 0.0f;
+	sampler.anisotropyEnable = VK_FALSE;
+	sampler.maxAnisotropy = 1.0f;
+	sampler.compareEnable = VK_FALSE;
+	sampler.compareOp = VK_COMPARE_OP_NEVER;
+	sampler.minLod = 0.0f;
+	sampler.maxLod = 1;
+	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+	sampler.unnormalizedCoordinates = VK_FALSE;
+	sampler.flags = 0;
+	ASSERT_VULKAN(vkCreateSampler(device, &sampler, nullptr, &m_LinearSampler));
+
+	std::vector<VkDescriptorSetLayout> allocLayouts = {m_SampleDescriptorLayout, m_ImageDescriptorLayout};
+
+	VkDescriptorSetAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = m_DescriptorPool,
+		.descriptorSetCount = static_cast<uint32_t>(allocLayouts.size()),
+		.pSetLayouts = allocLayouts.data()
+	};
+
+	VkDescriptorSet allocTarget[2];
+	ASSERT_VULKAN(vkAllocateDescriptorSets(device, &allocInfo, allocTarget));
+
+	m_SampleDescriptor = allocTarget[0];
+	m_ImageDescriptor = allocTarget[1];
+
+	VkDescriptorImageInfo texInfo {
+		.sampler = m_LinearSampler,
+		.imageView = m_ImageView,
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+	};
+
+	std::vector<VkWriteDescriptorSet> writeDescSets(2, VkWriteDescriptorSet{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.pImageInfo = &texInfo,
+		.pBufferInfo = nullptr,
+		.pTexelBufferView = nullptr
+	});
+
+	writeDescSets[0].dstSet = m_SampleDescriptor;
+	writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	writeDescSets[1].dstSet = m_ImageDescriptor;
+	writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+	vkUpdateDescriptorSets(device, writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+}
+
+void SkyView::CreateCommandBuffers() {
+	// one buffer for compute per sum target state, one for transitioning the image.
+	m_CommandPool.AllocateBuffers(SUM_TARGET_STATE_COUNT+1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	std::vector tmp(m_CommandPool.GetBuffers());
+	std::copy_n(tmp.begin(), SUM_TARGET_STATE_COUNT, m_ComputeCommandBuffers.begin());
+	m_LayoutCommandBuffer = tmp[SUM_TARGET_STATE_COUNT];
+}
+
+void SkyView::CreateComputePipeline(VkDevice device) {
+	std::vector<VkDescriptorSetLayout> layouts(8);
+	layouts[SV_SETS_IMAGE] = m_ImageDescriptorLayout;
+	layouts[SV_SETS_CAM] = m_Cam.GetDescriptorSetLayout();
+	layouts[SV_SETS_SUN] = m_Sun.GetDescriptorSetLayout();
+	layouts[SV_SETS_RATIO] = m_Precomp.GetRatioDescriptorSetLayout();
+	layouts[SV_SETS_ENV0] = m_Precomp.GetEffectiveEnv(0).GetDescriptorSetLayout();
+	layouts[SV_SETS_ENV1] = m_Precomp.GetEffectiveEnv(1).GetDescriptorSetLayout();
+	layouts[SV_SETS_SCATTERING_SAMPLER0] = m_Atmosphere.GetScatteringSampleDescriptorLayout();
+	layouts[SV_SETS_SCATTERING_SAMPLER1] = m_Atmosphere.GetScatteringSampleDescriptorLayout();
+
+	VkPipelineLayoutCreateInfo layoutCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.setLayoutCount = static_cast<uint32_t>(layouts.size()),
+		.pSetLayouts = layouts.data(),
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+	ASSERT_VULKAN(vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &m_PipelineLayout));
+
+	VkPipelineShaderStageCreateInfo compStageCreateInfo;
+	compStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compStageCreateInfo.pNext = nullptr;
+	compStageCreateInfo.flags = 0;
+	compStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compStageCreateInfo.pName = "main";
+	std::vector<VkSpecializationMapEntry> specEntries = LutBlendSpecialization::GetSpecializationMapEntries();
+	LutBlendSpecialization specData{m_Atmosphere.GetResolution(), VK_FALSE};
+	VkSpecializationInfo specInfo = specData.GetSpecializationInfo(specEntries);
+	compStageCreateInfo.pSpecializationInfo = &specInfo;
+
+	VkComputePipelineCreateInfo pipeline;
+	pipeline.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline.pNext = nullptr;
+	pipeline.flags = 0;
+	pipeline.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline.stage = compStageCreateInfo;
+	pipeline.stage.module = m_Shader.GetVulkanModule();
+	pipeline.layout = m_PipelineLayout;
+
+	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_Pipeline));
+
+	// same pipeline, but mixing both sum targets.
+	specData.m_Blend = VK_TRUE;
+	ASSERT_VULKAN(vkCreateComputePipelines(device, nullptr, 1, &pipeline, nullptr, &m_BlendPipeline));
+}
+
+void SkyView::RecordCommandBuffers() {
+	VkCommandBufferBeginInfo beginInfo;
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	const AtmosphereResolution &resolution = m_Atmosphere.GetResolution();
+
+	m_DescriptorGeneration = m_Atmosphere.GetDescriptorGeneration();
+	for (size_t state = 0; state != SUM_TARGET_STATE_COUNT; ++state) {
+		VkCommandBuffer buf = m_ComputeCommandBuffers[state];
+		ASSERT_VULKAN(vkBeginCommandBuffer(buf, &beginInfo));
+
+		// outside of blends the visible sum target is bound as target 0.
+		size_t target0 = Precomputer::GetBoundSumTarget(state, 0);
+		size_t target1 = Precomputer::GetBoundSumTarget(state, 1);
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+			state == SUM_TARGET_STATE_BLEND ? m_BlendPipeline : m_Pipeline);
+
+		std::vector<VkDescriptorSet> sets(8);
+		sets[SV_SETS_IMAGE] = m_ImageDescriptor;
+		sets[SV_SETS_CAM] = m_Cam.GetDescriptorSet();
+		sets[SV_SETS_SUN] = m_Sun.GetDescriptorSet();
+		sets[SV_SETS_RATIO] = m_Precomp.GetRatioDescriptorSet();
+		sets[SV_SETS_ENV0] = m_Precomp.GetEffectiveEnv(target0).GetDescriptorSet();
+		sets[SV_SETS_ENV1] = m_Precomp.GetEffectiveEnv(target1).GetDescriptorSet();
+		sets[SV_SETS_SCATTERING_SAMPLER0] = m_Atmosphere.GetScatteringSampleDescriptorSet(target0);
+		sets[SV_SETS_SCATTERING_SAMPLER1] = m_Atmosphere.GetScatteringSampleDescriptorSet(target1);
+
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+
+		// one invocation per texel.
+		vkCmdDispatch(buf,
+			(resolution.m_SkyViewX + SKY_VIEW_GROUP_SIZE-1)/SKY_VIEW_GROUP_SIZE,
+			(resolution.m_SkyViewY + SKY_VIEW_GROUP_SIZE-1)/SKY_VIEW_GROUP_SIZE,
+			1);
+
+		vkEndCommandBuffer(buf);
+	}
+}
+
+void SkyView::Compute() {
+	// the atmosphere rewrites the descriptor sets of a sum target when (de)allocating it, while the device is idle.
+	if (m_DescriptorGeneration != m_Atmosphere.GetDescriptorGeneration())
+		RecordCommandBuffers();
+
+	VkSubmitInfo submitInfo;
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_ComputeCommandBuffers[m_Precomp.GetSumTargetState()];
+
+	ASSERT_VULKAN(vkQueueSubmit(VulkanAPI::GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+VkDescriptorSet SkyView::GetSampleDescriptor() const {
+	return m_SampleDescriptor;
+}
+
+VkDescriptorSetLayout SkyView::GetSampleDescriptorLayout() const {
+	return m_SampleDescriptorLayout;
+}
+
+}
@@ -139,6 +139,10 @@ namespace en {
 		return m_SunData.m_Zenith;
 	}
 
+	const SunData &Sun::GetData() const {
+		return m_SunData;
+	}
+
 	VkDescriptorSetLayout Sun::GetDescriptorSetLayout() const {
 		return m_DescriptorSetLayout;
 	}
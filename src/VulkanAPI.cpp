@@ -23,6 +23,7 @@ namespace en
 	VkPresentModeKHR VulkanAPI::m_PresentMode;
 
 	PhysicalDeviceInfo VulkanAPI::m_PhysicalDeviceInfo;
+	VkPhysicalDeviceFeatures VulkanAPI::m_EnabledFeatures;
 	uint32_t VulkanAPI::m_GraphicsQFI;
 	uint32_t VulkanAPI::m_ComputeQFI;
 	uint32_t VulkanAPI::m_PresentQFI;
@@ -134,6 +135,16 @@ namespace en
 		return m_PhysicalDeviceInfo.vulkanHandle;
 	}
 
+	const VkPhysicalDeviceProperties& VulkanAPI::GetPhysicalDeviceProperties()
+	{
+		return m_PhysicalDeviceInfo.properties;
+	}
+
+	const VkPhysicalDeviceFeatures& VulkanAPI::GetEnabledFeatures()
+	{
+		return m_EnabledFeatures;
+	}
+
 	uint32_t VulkanAPI::GetGraphicsQFI()
 	{
 		return m_GraphicsQFI;
@@ -410,11 +421,22 @@ namespace en
 		// enable float64 for sky-vertex shader.
 		VkPhysicalDeviceFeatures features {};
 		features.shaderFloat64 = VK_TRUE;
+		// LUTs in packed formats are written without format qualifier (see LutFormat).
+		features.shaderStorageImageWriteWithoutFormat = m_PhysicalDeviceInfo.features.shaderStorageImageWriteWithoutFormat;
+		// sample statistics of the cloud shaders (see CloudRenderer).
+		features.fragmentStoresAndAtomics = m_PhysicalDeviceInfo.features.fragmentStoresAndAtomics;
+		m_EnabledFeatures = features;
+
+		// timeline semaphores track completion of the precomputation.
+		VkPhysicalDeviceVulkan12Features features12 {};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.pNext = nullptr;
+		features12.timelineSemaphore = VK_TRUE;
 
 		// Create
 		VkDeviceCreateInfo createInfo;
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		createInfo.pNext = nullptr;
+		createInfo.pNext = &features12;
 		createInfo.flags = 0;
 		createInfo.queueCreateInfoCount = 1;
 		createInfo.pQueueCreateInfos = &queueCreateInfo;
@@ -14,7 +14,7 @@ namespace en
 		uniformBufferBinding.binding = 0;
 		uniformBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		uniformBufferBinding.descriptorCount = 1;
-		uniformBufferBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		uniformBufferBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 		uniformBufferBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutCreateInfo layoutCI;
@@ -122,4 +122,9 @@ namespace en
 	{
 		return m_DescriptorSet;
 	}
+
+	const glm::vec2& Wind::GetOffset() const
+	{
+		return m_UniformData.offset;
+	}
 }
@@ -7,6 +7,7 @@
 #define _USE_MATH_DEFINES
 
 #include "engine/graphics/renderer/SkyRenderer.hpp"
+#include "engine/graphics/SkyView.hpp"
 #include <engine/graphics/VulkanAPI.hpp>
 #include <engine/util/Log.hpp>
 #include <engine/graphics/Window.hpp>
@@ -20,32 +21,25 @@
 #include <imgui.h>
 #include <vulkan/vulkan_core.h>
 #include <cmath>
+#include <string>
+#include <vector>
 #include <engine/graphics/EnvConditions.hpp>
 #include <engine/graphics/Precomputer.hpp>
+#include <engine/graphics/LutCache.hpp>
+#include <engine/graphics/LutPack.hpp>
+#include <engine/graphics/AtmospherePresets.hpp>
+#include <engine/graphics/CpuPrecomputer.hpp>
+#include <engine/graphics/CpuPrecomputeDiagnostics.hpp>
 #include <engine/graphics/renderer/SubpassRenderer.hpp>
 #include <engine/graphics/Subpass.hpp>
 #include <engine/graphics/renderer/CloudRenderer.hpp>
+#include <engine/graphics/CloudShadow.hpp>
 #include <engine/util/Input.hpp>
 #include <engine/util/Time.hpp>
 #include <engine/objects/CloudData.hpp>
 #include <engine/objects/Terrain.hpp>
 #include <engine/objects/Wind.hpp>
 
-en::EnvConditions::Environment earthConditions {
-	// data from https://www.iup.uni-bremen.de/gruppen/molspec/downloads/serdyuchenkogorshelev5digits.dat.
-	// 650, 510, 475nm at 243K (-30C, eyeballed average temperature for height of most ozone).
-	// *10^-4 for cm^2 -> m^2.
-	.m_OzoneExtinctionCoefficient = glm::vec3(2.43181E-25, 1.151113e-25, 4.47939e-26),
-	.m_PlanetRadius = 6371000,
-	.m_AtmosphereHeight = 80000,
-	.m_RefractiveIndexAir = 1.0003,
-	.m_AirDensityAtSeaLevel = static_cast<float>(2.545*pow(10, 25)),
-	.m_MieScatteringCoefficient = 0.000002,
-	.m_AsymmetryFactor = 0.73,
-	.m_RayleighScaleHeight = 8000,
-	.m_MieScaleHeight = 1200
-};
-
 en::CloudRenderer* cloudRenderer;
 
 std::vector<VkSemaphore> precomp_aerial_semaphores;
@@ -116,6 +110,60 @@ int main(int argc, char** argv)
 {
     en::Log::Info("Starting SkyRenderer");
 
+	// "--quality low|medium|high" and "--ambient cubemap|sh" may appear anywhere, the remaining arguments select the mode.
+	std::vector<std::string> args;
+	en::AtmosphereQuality quality = en::AtmosphereQuality::Medium;
+	en::GroundLightingOutput ambient = en::GroundLightingOutput::Cubemap;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--quality" && i+1 < argc) {
+			if (!en::AtmosphereResolution::ParseQuality(argv[++i], quality))
+				en::Log::Warn(std::string("Unknown quality ") + argv[i] + ", using medium");
+			continue;
+		}
+		if (std::string(argv[i]) == "--ambient" && i+1 < argc) {
+			std::string output = argv[++i];
+			if (output == "sh")
+				ambient = en::GroundLightingOutput::SphericalHarmonics;
+			else if (output != "cubemap")
+				en::Log::Warn("Unknown ambient " + output + ", using cubemap");
+			continue;
+		}
+		args.push_back(argv[i]);
+	}
+	const std::vector<en::AtmospherePreset> &atmospherePresets = en::GetAtmospherePresets();
+	const en::EnvConditions::Environment &earthConditions = atmospherePresets[0].m_Env;
+	en::AtmosphereResolution resolution = en::AtmosphereResolution::FromQuality(quality);
+	std::string qualityName = en::AtmosphereResolution::GetQualityName(quality);
+	en::Log::Info("Atmosphere quality " + qualityName);
+
+	// headless: compute the LUTs of the default environment on the CPU and store them in the cache.
+	if (!args.empty() && args[0] == "--cpu-precompute") {
+		en::CpuPrecomputer cpuPrecomputer(earthConditions, resolution);
+		cpuPrecomputer.Run();
+		cpuPrecomputer.LogBenchmark();
+		en::LogFormatErrors(cpuPrecomputer);
+		en::LutCache("data/lut_cache", resolution).Store(earthConditions, cpuPrecomputer.GetLuts());
+		return 0;
+	}
+
+	// compare transmittance integrators (TRANSMITTANCE_INTEGRATOR) for all presets.
+	if (!args.empty() && args[0] == "--transmittance-benchmark") {
+		for (const en::AtmospherePreset &preset : atmospherePresets) {
+			en::Log::Info(preset.m_Name + ":");
+			en::BenchmarkTransmittanceIntegrators(preset.m_Env, resolution);
+		}
+		return 0;
+	}
+
+	// error of the float ray/sphere intersections of the sky shaders for all presets.
+	if (!args.empty() && args[0] == "--intersection-precision") {
+		for (const en::AtmospherePreset &preset : atmospherePresets) {
+			en::Log::Info(preset.m_Name + ":");
+			en::LogSphereIntersectionPrecision(preset.m_Env);
+		}
+		return 0;
+	}
+
 	// Engine
     en::Window::Init(800, 600, "SkyRenderer");
     en::VulkanAPI::Init("SkyRenderer");
@@ -142,20 +190,28 @@ int main(int argc, char** argv)
 
 	// TODO: clean up all of this, precomp should own atmosphere and env.
 	en::EnvConditions earthEnv(earthConditions);
-	en::Atmosphere atmosphere(earthEnv.GetDescriptorSetLayout());
+	en::Atmosphere atmosphere(earthEnv.GetDescriptorSetLayout(), quality);
 	//en::DirLight dirLight(glm::vec3(0.4f, -0.2f, -0.4f));
 
 	//modelRenderer = new en::SimpleModelRenderer(width, height, &camera);
-	en::Precomputer precomp(atmosphere, earthEnv, 1, 1, 1);
+	en::LutCache lutCache("data/lut_cache", resolution);
+	// optional, without it presets are precomputed (or cached) like any other environment.
+	en::LutPack lutPack(resolution);
+	lutPack.Load(en::LutPack::GetDefaultPath(quality));
+	en::Precomputer precomp(atmosphere, earthEnv, 1, 1, 1, &lutCache, &lutPack);
 
 	en::CloudData cloudData;
-	auto cloudRenderer = std::make_shared<en::CloudRenderer>(width, height, &camera, &sun, &wind, &cloudData, &atmosphere, &precomp);
+	// transmittance toward the sun, sampled by the clouds and the terrain.
+	en::CloudShadow cloudShadow(sun, wind, cloudData);
+	auto cloudRenderer = std::make_shared<en::CloudRenderer>(width, height, &camera, &sun, &wind, &cloudData, &cloudShadow, &atmosphere, &precomp);
 
-	en::GroundLighting gl(precomp, atmosphere, sun);
+	en::GroundLighting gl(precomp, atmosphere, sun, ambient);
 
 	en::AerialPerspective aerial(camera, precomp, atmosphere, sun);
 
-	auto modelRenderer = std::make_shared<en::SimpleModelRenderer>(width, height, &camera, &sun, gl, swapchain.GetImageCount());
+	en::SkyView skyView(camera, precomp, atmosphere, sun);
+
+	auto modelRenderer = std::make_shared<en::SimpleModelRenderer>(width, height, &camera, &sun, gl, cloudShadow, swapchain.GetImageCount());
 	auto postProcess = std::make_shared<en::PostprocessingSubpass>(width, height);
 
 	auto skyRenderer = std::make_shared<en::SkyRenderer>(
@@ -167,7 +223,8 @@ int main(int argc, char** argv)
 		swapchain,
 		atmosphere,
 		precomp,
-		aerial );
+		aerial,
+		skyView );
 
 	auto aerialPerspectiveRenderer = std::make_shared<en::AerialPerspectiveRenderer>(
 		swapchain.GetImageCount(), 
@@ -190,6 +247,16 @@ int main(int argc, char** argv)
 		postProcess,
 		imguiRenderer
 	}), std::vector<VkSubpassDependency>({
+		{
+			// SkyRenderer (subpass 1) samples the sky-view LUT (calculated in compute shader).
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 1,
+			.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.dependencyFlags = 0
+		},
 		{
 			// AerialPerspectiveRenderer (subpass 3) needs to wait for aerialPerspective-
 			// data (calculated in compute shader, consumed in fragment shader).
@@ -352,6 +419,7 @@ int main(int argc, char** argv)
 		imguiRenderer->StartFrame();
 
 		cloudData.RenderImGui();
+		cloudShadow.RenderImgui();
 		//dirLight.RenderImGui();
 		camera.RenderImgui();
 		earthEnv.RenderImgui();
@@ -359,6 +427,9 @@ int main(int argc, char** argv)
 		ImGui::DragFloat("dragon_z", &dragon_dist, 100000, -1000000, 10000000000, "%g", ImGuiSliderFlags_Logarithmic);
 		ImGui::DragFloat("dragon_scale", &dragon_scale, 100000, 0, 10000000000, "%g", ImGuiSliderFlags_Logarithmic);
 		precomp.RenderImgui();
+		aerial.RenderImgui();
+		gl.RenderImgui();
+		cloudRenderer->RenderImgui();
 
 		imguiRenderer->EndFrame(graphicsQueue, imageIndx);
 
@@ -390,6 +461,12 @@ int main(int argc, char** argv)
 		// * renders into an completely offscreen image, which will only be accessed in later frames.
 		// * increases the ratio, eg. uploads data to the GPU.
 		aerial.Compute(nullptr, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, nullptr);
+		// sky background, sampled by the sky renderer.
+		skyView.Compute();
+		// only if the sun, the wind or the clouds changed, read by the clouds and the models.
+		cloudShadow.Compute();
+		// low-resolution clouds, if enabled, composited in the cloud subpass.
+		cloudRenderer->Render(graphicsQueue);
 
 		// wait with fragment shader-evaluation, we'll need new aerial-precomputation.
 		// TODO: wait in specific subpass only??
@@ -442,6 +519,8 @@ int main(int argc, char** argv)
 	precomp.~Precomputer();
 	gl.~GroundLighting();
 	aerial.~AerialPerspective();
+	skyView.~SkyView();
+	cloudShadow.~CloudShadow();
 
 	(*postProcess).~PostprocessingSubpass();
 	spr.~SubpassRenderer();
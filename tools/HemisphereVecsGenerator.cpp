@@ -0,0 +1,38 @@
+#include <cstdio>
+
+#include "engine/graphics/HemisphereVecs.hpp"
+
+// writes the compile-time hemisphere vectors as glsl, run by the build (see CMakeLists.txt).
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::fprintf(stderr, "usage: %s <hemisphere_vecs.glsl>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *file = std::fopen(argv[1], "w");
+	if (file == nullptr) {
+		std::fprintf(stderr, "Failed to open %s\n", argv[1]);
+		return 1;
+	}
+
+	const en::hemisphere::Vecs &vecs = en::hemisphere::vecs;
+	std::fprintf(file, "const int hemisphere_hor_sizes[GRL_ZENITH_ANGLES+2] = {\n");
+	for (int i = 0; i != en::hemisphere::RING_COUNT; ++i)
+		std::fprintf(file, i == 0 ? "\t%d" : ",\n\t%d", vecs.m_HorSizes[i]);
+	std::fprintf(file, "\n};\n");
+	std::fprintf(file, "const int hemisphere_vec_count = %d;\n", en::hemisphere::VecCount());
+
+	std::fprintf(file, "const vec3 hemisphere_vecs[%d][%d] = {\n\t",
+		en::hemisphere::RING_COUNT, en::hemisphere::MAX_HOR_STEPS);
+	for (int i = 0; i != en::hemisphere::RING_COUNT; ++i) {
+		std::fprintf(file, i == 0 ? "{\n" : ", {\n");
+		for (int j = 0; j != en::hemisphere::MAX_HOR_STEPS; ++j) {
+			const std::array<float, 3> &dir = vecs.m_Dirs[i][j];
+			std::fprintf(file, j == 0 ? "\t\tvec3(%f, %f, %f)" : ",\n\t\tvec3(%f, %f, %f)", dir[0], dir[1], dir[2]);
+		}
+		std::fprintf(file, "\n\t}");
+	}
+	std::fprintf(file, "\n};");
+
+	return std::fclose(file) == 0 ? 0 : 1;
+}
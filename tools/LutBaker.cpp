@@ -0,0 +1,41 @@
+#include <string>
+
+#include "engine/graphics/AtmospherePresets.hpp"
+#include "engine/graphics/CpuPrecomputer.hpp"
+#include "engine/graphics/LutPack.hpp"
+#include "engine/util/Log.hpp"
+
+// bakes all atmosphere presets on the CPU into the LUT pack the renderer loads at startup.
+// Needs no window or device, run from the repository root like the renderer.
+int main(int argc, char** argv) {
+	en::AtmosphereQuality quality = en::AtmosphereQuality::Medium;
+	std::string path;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--quality" && i+1 < argc) {
+			if (!en::AtmosphereResolution::ParseQuality(argv[++i], quality)) {
+				en::Log::Warn(std::string("Unknown quality ") + argv[i]);
+				return 1;
+			}
+		} else if (path.empty())
+			path = argv[i];
+		else {
+			en::Log::Warn(std::string("usage: ") + argv[0] + " [--quality low|medium|high] [<pack>]");
+			return 1;
+		}
+	}
+	if (path.empty())
+		path = en::LutPack::GetDefaultPath(quality);
+
+	en::AtmosphereResolution resolution = en::AtmosphereResolution::FromQuality(quality);
+	en::Log::Info(std::string("Baking LUT pack of quality ") + en::AtmosphereResolution::GetQualityName(quality));
+
+	en::LutPack pack(resolution);
+	for (const en::AtmospherePreset &preset : en::GetAtmospherePresets()) {
+		en::Log::Info("Baking preset " + preset.m_Name);
+		en::CpuPrecomputer cpuPrecomputer(preset.m_Env, resolution);
+		cpuPrecomputer.Run();
+		cpuPrecomputer.LogBenchmark();
+		pack.Add(preset.m_Name, preset.m_Env, cpuPrecomputer.GetLuts());
+	}
+	return pack.Save(path) ? 0 : 1;
+}